@@ -0,0 +1,189 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures slirc::util::component_map operations per second for lookup-heavy
+// and insert-heavy workloads with 1 to 8 components of mixed sizes: an int,
+// a pointer, a std::string and a 64 byte struct, repeated with distinct tag
+// types.
+//
+//  - lookup: at<T>() on every stored component, then find<T>() for a type
+//    that is not stored, as event handlers and routed handler lookups do.
+//  - insert: emplace every component, then clear(), as events do over their
+//    lifetime when recycled through the event pool.
+//  - replace: emplace every component over an existing object of its type,
+//    then erase() every other one.
+//
+// For comparison, runs the same workloads on the previous layout of an
+// unordered_map<type_index, any>.
+
+#include <any>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+
+#include "../include/slirc/util/component_map.hpp"
+
+namespace {
+	using bench_clock = std::chrono::steady_clock;
+
+	template<std::size_t Tag> struct small_component { int value; };
+	template<std::size_t Tag> struct pointer_component { const void *value; };
+	template<std::size_t Tag> struct string_component { std::string value; };
+	template<std::size_t Tag> struct large_component { std::array<std::size_t, 8> value; };
+
+	struct missing_component {};
+
+	// component i of the workload
+	template<std::size_t I>
+	using component = std::conditional_t<I % 4 == 0, small_component<I>,
+		std::conditional_t<I % 4 == 1, pointer_component<I>,
+		std::conditional_t<I % 4 == 2, string_component<I>, large_component<I>>>>;
+
+	template<std::size_t I>
+	std::size_t value_of(const component<I> &c) {
+		if constexpr (I % 4 == 0) { return c.value; }
+		else if constexpr (I % 4 == 1) { return reinterpret_cast<std::size_t>(c.value); }
+		else if constexpr (I % 4 == 2) { return c.value.size(); }
+		else { return c.value[0]; }
+	}
+
+	// the previous component_map layout
+	struct any_map {
+		template<typename T>
+		T &at() {
+			return std::any_cast<T&>(content.at(typeid(T)));
+		}
+
+		template<typename T>
+		T *find() {
+			const auto it = content.find(typeid(T));
+			return (it != content.end()) ? std::any_cast<T>(&it->second) : nullptr;
+		}
+
+		template<typename T, typename... Args>
+		T &emplace(Args&&... args) {
+			return content[typeid(T)].emplace<T>(std::forward<Args>(args)...);
+		}
+
+		template<typename T>
+		bool erase() {
+			return content.erase(typeid(T)) != 0;
+		}
+
+		void clear() {
+			content.clear();
+		}
+
+		std::unordered_map<std::type_index, std::any> content;
+	};
+
+	template<typename Map, std::size_t... I>
+	void emplace_all(Map &map, std::index_sequence<I...>) {
+		(map.template emplace<component<I>>(component<I>{}), ...);
+	}
+
+	template<typename Map, std::size_t... I>
+	std::size_t lookup_all(Map &map, std::index_sequence<I...>) {
+		return (value_of<I>(map.template at<component<I>>()) + ... + (map.template find<missing_component>() ? 1 : 0));
+	}
+
+	template<typename Map, std::size_t... I>
+	void erase_odd(Map &map, std::index_sequence<I...>) {
+		((I % 2 == 1 && map.template erase<component<I>>()), ...);
+	}
+
+	template<std::size_t Components, typename Map>
+	bench_clock::duration lookup_loops(std::size_t loops, std::size_t &checksum) {
+		using indices = std::make_index_sequence<Components>;
+		Map map;
+		emplace_all(map, indices{});
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != loops; ++i) {
+			checksum += lookup_all(map, indices{});
+		}
+		return bench_clock::now() - start;
+	}
+
+	template<std::size_t Components, typename Map>
+	bench_clock::duration insert_loops(std::size_t loops, std::size_t &checksum) {
+		using indices = std::make_index_sequence<Components>;
+		Map map;
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != loops; ++i) {
+			emplace_all(map, indices{});
+			checksum += value_of<0>(map.template at<component<0>>());
+			map.clear();
+		}
+		return bench_clock::now() - start;
+	}
+
+	template<std::size_t Components, typename Map>
+	bench_clock::duration replace_loops(std::size_t loops, std::size_t &checksum) {
+		using indices = std::make_index_sequence<Components>;
+		Map map;
+		emplace_all(map, indices{});
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != loops; ++i) {
+			emplace_all(map, indices{});
+			erase_odd(map, indices{});
+			checksum += value_of<0>(map.template at<component<0>>());
+		}
+		return bench_clock::now() - start;
+	}
+
+	void report(const char *name, std::size_t components, std::size_t loops, bench_clock::duration elapsed) {
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+		std::cout
+			<< name << ", " << components << " components: "
+			<< static_cast<std::size_t>(loops * components / seconds) << " ops/s\n";
+	}
+
+	template<std::size_t Components>
+	void run(std::size_t loops, std::size_t &checksum) {
+		using slirc::util::component_map;
+		report("component_map lookup", Components, loops, lookup_loops<Components, component_map>(loops, checksum));
+		report("any_map lookup", Components, loops, lookup_loops<Components, any_map>(loops, checksum));
+		report("component_map insert", Components, loops, insert_loops<Components, component_map>(loops, checksum));
+		report("any_map insert", Components, loops, insert_loops<Components, any_map>(loops, checksum));
+		report("component_map replace", Components, loops, replace_loops<Components, component_map>(loops, checksum));
+		report("any_map replace", Components, loops, replace_loops<Components, any_map>(loops, checksum));
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t loops = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+
+	std::size_t checksum = 0;
+	run<1>(loops, checksum);
+	run<2>(loops, checksum);
+	run<4>(loops, checksum);
+	run<8>(loops, checksum);
+	run<12>(loops, checksum);
+	return (checksum == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
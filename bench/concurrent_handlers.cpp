@@ -0,0 +1,223 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures emits per second with 2, 8 and 32 event handlers connected by
+// connect_concurrent(), emitted from one and from four threads at once. The
+// event handlers read the events data through the const event they are given.
+//
+// Also counts the heap allocations done while emitting once some warm up emits
+// set up the dispatch pool and its recycled runs, which are expected to be
+// zero, and checks that an exception thrown by one of the event handlers is
+// rethrown by emit_event() after all of them ran, and that async_wait_for()
+// passes on only one of the events emitted by four threads at once. The
+// benchmark fails if any of this is not the case.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/network.hpp"
+
+namespace {
+	std::atomic<std::size_t> allocations(0);
+}
+
+void *operator new(std::size_t size) {
+	++allocations;
+	if (void * const memory = std::malloc(size ? size : 1)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		emitted
+	};
+
+	struct payload {
+		std::size_t value;
+	};
+
+	using bench_clock = std::chrono::steady_clock;
+
+	constexpr std::size_t warm_up_emits = 1000;
+
+	void report(const char *name, std::size_t handlers, std::size_t emits, bench_clock::duration elapsed) {
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+		std::cout
+			<< name << ", " << handlers << " handlers: "
+			<< static_cast<std::size_t>(emits / seconds) << " emits/s\n";
+	}
+
+	void connect_handlers(slirc::irc &context, std::size_t handlers, std::atomic<std::size_t> &calls) {
+		for(std::size_t i = 0; i != handlers; ++i) {
+			context.connect_concurrent(bench_events::emitted, [&calls](const slirc::event &ev) {
+				calls += ev.data.at<payload>().value;
+			});
+		}
+	}
+
+	bench_clock::duration single_emitter(std::size_t handlers, std::size_t emits, std::atomic<std::size_t> &calls, std::size_t &emit_allocations) {
+		slirc::irc context;
+		connect_handlers(context, handlers, calls);
+
+		const auto ev = context.make_event(bench_events::emitted);
+		ev->data.insert(payload{ 1 });
+		for(std::size_t i = 0; i != warm_up_emits; ++i) {
+			context.emit_event(*ev);
+		}
+
+		const std::size_t allocations_before = allocations;
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != emits; ++i) {
+			context.emit_event(*ev);
+		}
+		const auto elapsed = bench_clock::now() - start;
+		emit_allocations = allocations - allocations_before;
+		return elapsed;
+	}
+
+	bench_clock::duration four_emitters(std::size_t handlers, std::size_t emits, std::atomic<std::size_t> &calls) {
+		slirc::irc context;
+		connect_handlers(context, handlers, calls);
+
+		std::vector<std::thread> emitters;
+		const auto start = bench_clock::now();
+		for(int i = 0; i != 4; ++i) {
+			emitters.emplace_back([&context, emits] {
+				const auto ev = context.make_event(bench_events::emitted);
+				ev->data.insert(payload{ 1 });
+				for(std::size_t i = 0; i != emits / 4; ++i) {
+					context.emit_event(*ev);
+				}
+			});
+		}
+		for(auto &emitter: emitters) {
+			emitter.join();
+		}
+		return bench_clock::now() - start;
+	}
+
+	bool rethrows(std::size_t handlers) {
+		slirc::irc context;
+		std::atomic<std::size_t> calls(0);
+		connect_handlers(context, handlers, calls);
+		context.connect_concurrent(bench_events::emitted, [](const slirc::event &) {
+			throw std::runtime_error("concurrent handler failed");
+		});
+
+		const auto ev = context.make_event(bench_events::emitted);
+		ev->data.insert(payload{ 1 });
+		try {
+			context.emit_event(*ev);
+		}
+		catch(const std::runtime_error &) {
+			return calls == handlers;
+		}
+		return false;
+	}
+
+	bool waits_once(std::size_t rounds) {
+		slirc::irc context;
+		boost::asio::io_service io_service;
+		slirc::use_external_io_service(io_service);
+
+		std::size_t calls = 0;
+		bool once = true;
+		for(std::size_t round = 0; once && round != rounds; ++round) {
+			context.async_wait_for(bench_events::emitted, [&calls](std::shared_ptr<slirc::event>) {
+				++calls;
+			});
+
+			std::atomic<bool> start(false);
+			std::vector<std::thread> emitters;
+			for(int i = 0; i != 4; ++i) {
+				emitters.emplace_back([&context, &start] {
+					const auto ev = context.make_event(bench_events::emitted);
+					ev->data.insert(payload{ 1 });
+					while(!start) {
+						std::this_thread::yield();
+					}
+					context.emit_event(*ev);
+				});
+			}
+			start = true;
+			for(auto &emitter: emitters) {
+				emitter.join();
+			}
+
+			io_service.run();
+			io_service.reset();
+			once = calls == round + 1;
+		}
+		slirc::use_internal_io_service();
+		return once;
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t handler_calls = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 4000000;
+
+	bool allocation_free = true;
+	bool correct = true;
+	for(std::size_t handlers: { 2, 8, 32 }) {
+		const std::size_t emits = handler_calls / handlers;
+
+		std::atomic<std::size_t> calls(0);
+		std::size_t emit_allocations;
+		report("single emitter", handlers, emits, single_emitter(handlers, emits, calls, emit_allocations));
+		std::cout << "single emitter, " << handlers << " handlers: " << emit_allocations << " allocations in " << emits << " emits\n";
+		allocation_free = allocation_free && emit_allocations == 0;
+		correct = correct && calls == (emits + warm_up_emits) * handlers;
+
+		calls = 0;
+		report("four emitters", handlers, emits, four_emitters(handlers, emits, calls));
+		correct = correct && calls == emits / 4 * 4 * handlers;
+
+		correct = correct && rethrows(handlers);
+	}
+	correct = correct && waits_once(1000);
+	if (!correct) {
+		std::cout << "concurrent event handlers missed calls, lost an exception or waited more than once\n";
+	}
+	return (correct && allocation_free) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
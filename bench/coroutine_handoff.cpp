@@ -0,0 +1,120 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Compares the cost of handing events between two IRC contexts using
+// coroutines resumed on an io_service to the classic setup of one thread per
+// context blocking in fetch_event().
+//
+// Both variants play ping pong: Every round trip posts one event to each
+// context and waits for it to be fetched.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include <boost/asio/io_service.hpp>
+
+#include "../include/slirc/coroutine.hpp"
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/network.hpp"
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		ping,
+		pong
+	};
+
+	using bench_clock = std::chrono::steady_clock;
+
+	void report(const char *name, std::size_t round_trips, bench_clock::duration elapsed) {
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		std::cout
+			<< name << ": "
+			<< round_trips << " round trips in "
+			<< ns / 1000000 << " ms, "
+			<< static_cast<double>(ns) / round_trips << " ns per round trip\n";
+	}
+
+	bench_clock::duration condition_variable_handoff(std::size_t round_trips) {
+		slirc::irc ping_context;
+		slirc::irc pong_context;
+
+		const auto start = bench_clock::now();
+		std::thread ponger([&]{
+			for(std::size_t i = 0; i != round_trips; ++i) {
+				ping_context.fetch_event();
+				pong_context.make_event(bench_events::pong)->post_back();
+			}
+		});
+		for(std::size_t i = 0; i != round_trips; ++i) {
+			ping_context.make_event(bench_events::ping)->post_back();
+			pong_context.fetch_event();
+		}
+		ponger.join();
+		return bench_clock::now() - start;
+	}
+
+	slirc::detached_coroutine ponger(slirc::irc &ping_context, slirc::irc &pong_context, std::size_t round_trips) {
+		for(std::size_t i = 0; i != round_trips; ++i) {
+			co_await slirc::next_event(ping_context);
+			pong_context.make_event(bench_events::pong)->post_back();
+		}
+	}
+
+	slirc::detached_coroutine pinger(slirc::irc &ping_context, slirc::irc &pong_context, std::size_t round_trips, boost::asio::io_service &io_service) {
+		for(std::size_t i = 0; i != round_trips; ++i) {
+			ping_context.make_event(bench_events::ping)->post_back();
+			co_await slirc::next_event(pong_context);
+		}
+		io_service.stop();
+	}
+
+	bench_clock::duration coroutine_handoff(std::size_t round_trips) {
+		boost::asio::io_service io_service;
+		boost::asio::io_service::work work(io_service);
+		slirc::use_external_io_service(io_service);
+
+		slirc::irc ping_context;
+		slirc::irc pong_context;
+
+		const auto start = bench_clock::now();
+		ponger(ping_context, pong_context, round_trips);
+		pinger(ping_context, pong_context, round_trips, io_service);
+		io_service.run();
+		const auto elapsed = bench_clock::now() - start;
+
+		slirc::use_internal_io_service();
+		return elapsed;
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t round_trips = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 100000;
+
+	report("condition_variable", round_trips, condition_variable_handoff(round_trips));
+	report("coroutine", round_trips, coroutine_handoff(round_trips));
+	return 0;
+}
@@ -0,0 +1,144 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures emits per second with 1, 10 and 100 event handlers connected to the
+// emitted event id, using the IRC contexts copy-on-write handler table and, for
+// comparison, the previous dispatch through a mutex protected map of
+// boost::signals2 signals.
+//
+// Also counts the heap allocations done while emitting through the handler
+// table, which are expected to be zero once the event handlers are connected.
+// The benchmark fails if they are not. As libslirc has no test suite, this is
+// how that guarantee is verified; run it after changing the emit path.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+#include <boost/signals2.hpp>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	std::atomic<std::size_t> allocations(0);
+}
+
+void *operator new(std::size_t size) {
+	++allocations;
+	if (void * const memory = std::malloc(size ? size : 1)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		emitted,
+		other
+	};
+
+	using bench_clock = std::chrono::steady_clock;
+
+	void report(const char *name, std::size_t handlers, std::size_t emits, bench_clock::duration elapsed) {
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+		std::cout
+			<< name << ", " << handlers << " handlers: "
+			<< static_cast<std::size_t>(emits / seconds) << " emits/s\n";
+	}
+
+	bench_clock::duration handler_table(std::size_t handlers, std::size_t emits, std::size_t &calls, std::size_t &emit_allocations) {
+		slirc::irc context;
+		for(std::size_t i = 0; i != handlers; ++i) {
+			context.connect(bench_events::emitted, [&calls](slirc::event &) { ++calls; });
+			context.connect(bench_events::other, [&calls](slirc::event &) { ++calls; });
+		}
+
+		const auto ev = context.make_event(bench_events::emitted);
+		const std::size_t allocations_before = allocations;
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != emits; ++i) {
+			context.emit_event(*ev);
+		}
+		const auto elapsed = bench_clock::now() - start;
+		emit_allocations = allocations - allocations_before;
+		return elapsed;
+	}
+
+	bench_clock::duration signals2(std::size_t handlers, std::size_t emits, std::size_t &calls) {
+		using signal_type = boost::signals2::signal<void(slirc::event &)>;
+		std::mutex signals_mutex;
+		std::unordered_map<slirc::event_id, signal_type, slirc::event_id::hash> signals;
+
+		const auto callback = [&calls](const boost::signals2::connection &connection, slirc::event &ev) {
+			ev.data.insert(connection);
+			++calls;
+			ev.data.erase<boost::signals2::connection>();
+		};
+		for(std::size_t i = 0; i != handlers; ++i) {
+			signals[bench_events::emitted].connect_extended(callback);
+			signals[bench_events::other].connect_extended(callback);
+		}
+
+		slirc::irc context;
+		const auto ev = context.make_event(bench_events::emitted);
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != emits; ++i) {
+			signal_type *signal;
+			{ std::lock_guard<std::mutex> lock(signals_mutex);
+				signal = &signals[ev->current_id];
+			}
+			(*signal)(*ev);
+		}
+		return bench_clock::now() - start;
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t handler_calls = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+
+	std::size_t calls = 0;
+	bool allocation_free = true;
+	for(std::size_t handlers: { 1, 10, 100 }) {
+		const std::size_t emits = handler_calls / handlers;
+		std::size_t emit_allocations;
+		report("handler table", handlers, emits, handler_table(handlers, emits, calls, emit_allocations));
+		std::cout << "handler table, " << handlers << " handlers: " << emit_allocations << " allocations in " << emits << " emits\n";
+		allocation_free = allocation_free && emit_allocations == 0;
+		report("signals2", handlers, emits, signals2(handlers, emits, calls));
+	}
+	return (calls == 0 || !allocation_free) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Compares looking up per event id data the way the IRC context did before
+// event ids were interned (hashing the enum type and value into an
+// unordered_map) to indexing a flat vector with event_id::index().
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "../include/slirc/event_id.hpp"
+
+namespace {
+	enum class first_events: slirc::event_id::enum_type {};
+	enum class second_events: slirc::event_id::enum_type {};
+	enum class third_events: slirc::event_id::enum_type {};
+	enum class fourth_events: slirc::event_id::enum_type {};
+
+	constexpr slirc::event_id::enum_type values_per_enum = 100;
+
+	using bench_clock = std::chrono::steady_clock;
+
+	// the hash event_id used before interning
+	struct legacy_hash {
+		std::size_t operator()(const slirc::event_id &value) const {
+			return
+				std::hash<std::type_index>{}(std::get<0>(value))
+				^ std::hash<unsigned>{}(std::get<1>(value));
+		}
+	};
+
+	struct legacy_equal {
+		bool operator()(const slirc::event_id &lhs, const slirc::event_id &rhs) const {
+			return
+				static_cast<const std::tuple<std::type_index, unsigned> &>(lhs)
+				== static_cast<const std::tuple<std::type_index, unsigned> &>(rhs);
+		}
+	};
+
+	template<typename Enum>
+	void add_ids(std::vector<slirc::event_id> &ids) {
+		for(slirc::event_id::enum_type value = 0; value != values_per_enum; ++value) {
+			ids.emplace_back(static_cast<Enum>(value));
+		}
+	}
+
+	void report(const char *name, std::size_t lookups, bench_clock::duration elapsed) {
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		std::cout << name << ": " << static_cast<double>(ns) / lookups << " ns per lookup\n";
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t lookups = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+
+	std::vector<slirc::event_id> ids;
+	add_ids<first_events>(ids);
+	add_ids<second_events>(ids);
+	add_ids<third_events>(ids);
+	add_ids<fourth_events>(ids);
+
+	std::unordered_map<slirc::event_id, std::size_t, legacy_hash, legacy_equal> legacy_table;
+	std::vector<std::size_t> dense_table(slirc::event_id::registered_count());
+	for(std::size_t i = 0; i != ids.size(); ++i) {
+		legacy_table[ids[i]] = i;
+		dense_table[ids[i].index()] = i;
+	}
+
+	std::vector<slirc::event_id> sequence;
+	sequence.reserve(4096);
+	std::mt19937 random;
+	std::uniform_int_distribution<std::size_t> pick(0, ids.size() - 1);
+	for(std::size_t i = 0; i != 4096; ++i) {
+		sequence.push_back(ids[pick(random)]);
+	}
+
+	std::cout << ids.size() << " registered event ids\n";
+	std::size_t checksum = 0;
+
+	auto start = bench_clock::now();
+	for(std::size_t i = 0; i != lookups; ++i) {
+		checksum += legacy_table.find(sequence[i % sequence.size()])->second;
+	}
+	report("unordered_map, type_index hash", lookups, bench_clock::now() - start);
+
+	start = bench_clock::now();
+	for(std::size_t i = 0; i != lookups; ++i) {
+		checksum -= dense_table[sequence[i % sequence.size()].index()];
+	}
+	report("vector, dense index", lookups, bench_clock::now() - start);
+
+	return checksum != 0;
+}
@@ -0,0 +1,219 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures emit loops per second of an event whose id queue is refilled with
+// 1 to 4 event ids before each event::emit(), once appending them with
+// event::push_back() and once prepending them with event::push_front() from
+// within an event handler, as modules do when translating events.
+//
+// For comparison, runs the same queue operations without dispatching on the
+// event id queue and on the previous layout of two vectors and a skip count,
+// which was normalized on every iteration of the emit loop.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		first,
+		second,
+		third,
+		fourth
+	};
+
+	using bench_clock = std::chrono::steady_clock;
+
+	// the previous event id queue: front pushes are collected reversed in
+	// next_id_queue and merged into id_queue before reading it
+	struct vector_id_queue {
+		using id_vector = std::vector<slirc::event_id>;
+
+		void normalize() {
+			using reverse_iterator = std::reverse_iterator<id_vector::iterator>;
+			if (skipped < next_id_queue.size()) {
+				const auto old_size = id_queue.size();
+				const auto required_additional_space = next_id_queue.size() - skipped;
+				id_queue.resize(old_size + required_additional_space);
+				std::copy(
+					reverse_iterator(id_queue.begin() + old_size),
+					reverse_iterator(id_queue.begin() + skipped),
+					reverse_iterator(id_queue.end())
+				);
+				std::copy(
+					next_id_queue.begin(),
+					next_id_queue.end(),
+					reverse_iterator(id_queue.begin() + skipped + required_additional_space)
+				);
+				skipped = 0;
+			}
+			else {
+				std::copy(
+					next_id_queue.begin(),
+					next_id_queue.end(),
+					reverse_iterator(id_queue.begin() + skipped)
+				);
+				skipped -= next_id_queue.size();
+			}
+			next_id_queue.clear();
+		}
+
+		void push_back(const slirc::event_id &id) {
+			if (id_queue.size() == id_queue.capacity() && skipped != 0) {
+				id_queue.erase(std::copy(id_queue.begin() + skipped, id_queue.end(), id_queue.begin()), id_queue.end());
+				skipped = 0;
+			}
+			id_queue.push_back(id);
+		}
+
+		void push_front(const slirc::event_id &id) {
+			next_id_queue.push_back(id);
+		}
+
+		bool pop_front(slirc::event_id &id) {
+			normalize();
+			if (skipped == id_queue.size()) {
+				return false;
+			}
+			id = id_queue[skipped++];
+			return true;
+		}
+
+		id_vector next_id_queue;
+		id_vector id_queue;
+		id_vector::size_type skipped = 0;
+	};
+
+	struct ring_id_queue {
+		void push_back(const slirc::event_id &id) {
+			ids.push_back(id);
+		}
+
+		void push_front(const slirc::event_id &id) {
+			ids.push_front(id);
+		}
+
+		bool pop_front(slirc::event_id &id) {
+			if (ids.empty()) {
+				return false;
+			}
+			id = ids.front();
+			ids.pop_front();
+			return true;
+		}
+
+		slirc::event::underlying_type ids;
+	};
+
+	template<typename Queue>
+	bench_clock::duration queue_loops(std::size_t ids, std::size_t loops, bool front, std::size_t &popped) {
+		const slirc::event_id queued[] = { bench_events::first, bench_events::second, bench_events::third, bench_events::fourth };
+		Queue queue;
+		slirc::event_id id = queued[0];
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != loops; ++i) {
+			queue.push_back(queued[0]);
+			for(std::size_t next = 1; queue.pop_front(id); ++popped) {
+				if (next != ids) {
+					if (front) {
+						queue.push_front(queued[next++]);
+					}
+					else {
+						queue.push_back(queued[next++]);
+					}
+				}
+			}
+		}
+		return bench_clock::now() - start;
+	}
+
+	void report(const char *name, std::size_t ids, std::size_t loops, bench_clock::duration elapsed) {
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+		std::cout
+			<< name << ", " << ids << " ids: "
+			<< static_cast<std::size_t>(loops / seconds) << " emit loops/s\n";
+	}
+
+	bench_clock::duration push_back_loops(std::size_t ids, std::size_t loops, std::size_t &calls) {
+		slirc::irc context;
+		context.connect(bench_events::first, [&calls](slirc::event &) { ++calls; });
+
+		const auto ev = context.make_event(bench_events::first);
+		const bench_events queued[] = { bench_events::first, bench_events::second, bench_events::third, bench_events::fourth };
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != loops; ++i) {
+			for(std::size_t id = 0; id != ids; ++id) {
+				ev->push_back(queued[id]);
+			}
+			ev->emit();
+		}
+		return bench_clock::now() - start;
+	}
+
+	bench_clock::duration push_front_loops(std::size_t ids, std::size_t loops, std::size_t &calls) {
+		slirc::irc context;
+		// every handled id prepends the next one until ids ids were emitted
+		const auto translate = [ids](bench_events next) {
+			return [ids, next](slirc::event &ev) {
+				if (static_cast<std::size_t>(next) < ids) {
+					ev.push_front(next);
+				}
+			};
+		};
+		context.connect(bench_events::first, translate(bench_events::second));
+		context.connect(bench_events::second, translate(bench_events::third));
+		context.connect(bench_events::third, translate(bench_events::fourth));
+		context.connect(bench_events::first, [&calls](slirc::event &) { ++calls; });
+
+		const auto ev = context.make_event(bench_events::first);
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != loops; ++i) {
+			ev->push_back(bench_events::first);
+			ev->emit();
+		}
+		return bench_clock::now() - start;
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t loops = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 5000000;
+
+	std::size_t calls = 0;
+	std::size_t popped = 0;
+	for(std::size_t ids = 1; ids <= 4; ++ids) {
+		report("event push_back", ids, loops, push_back_loops(ids, loops, calls));
+		report("event push_front", ids, loops, push_front_loops(ids, loops, calls));
+		report("ring push_back", ids, loops, queue_loops<ring_id_queue>(ids, loops, false, popped));
+		report("ring push_front", ids, loops, queue_loops<ring_id_queue>(ids, loops, true, popped));
+		report("vectors push_back", ids, loops, queue_loops<vector_id_queue>(ids, loops, false, popped));
+		report("vectors push_front", ids, loops, queue_loops<vector_id_queue>(ids, loops, true, popped));
+	}
+	return (calls == 8 * loops && popped == 40 * loops) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
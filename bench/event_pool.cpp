@@ -0,0 +1,135 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures events created per second through irc::make_event(), with each
+// event queueing a second event id and attaching one component, once with the
+// event pool enabled and once with a capacity of 0. Reports the heap
+// allocations per event, counted through a replaced operator new, and the
+// event pools hit rate.
+//
+// Also checks that recycled events attaching more components than fit into
+// the inline slots of their component_map allocate nothing once the pool is
+// warmed up. The benchmark fails if they do.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <utility>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	std::atomic<std::size_t> allocations(0);
+}
+
+void *operator new(std::size_t size) {
+	++allocations;
+	if (void * const memory = std::malloc(size ? size : 1)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		created,
+		handled
+	};
+
+	struct bench_component {
+		std::size_t value;
+	};
+
+	template<std::size_t Tag>
+	struct tagged_component {
+		std::size_t value;
+	};
+
+	constexpr std::size_t many_components = slirc::util::component_map::inline_slots + 4;
+
+	using bench_clock = std::chrono::steady_clock;
+
+	void create_events(const char *name, std::size_t pool_capacity, std::size_t events) {
+		slirc::irc context;
+		context.set_event_pool_capacity(pool_capacity);
+
+		const std::size_t allocations_before = allocations;
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != events; ++i) {
+			const auto ev = context.make_event(bench_events::created);
+			ev->push_back(bench_events::handled);
+			ev->data.insert(bench_component{ i });
+		}
+		const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+		const std::size_t event_allocations = allocations - allocations_before;
+
+		const auto stats = context.event_pool_statistics();
+		std::cout
+			<< name << ": " << static_cast<std::size_t>(events / seconds) << " events/s, "
+			<< static_cast<double>(event_allocations) / events << " allocations per event, "
+			<< "hit rate " << stats.hit_rate() << "\n";
+	}
+
+	template<std::size_t... Tags>
+	void attach_components(slirc::event &ev, std::size_t value, std::index_sequence<Tags...>) {
+		(ev.data.insert(tagged_component<Tags>{ value }), ...);
+	}
+
+	std::size_t create_events_with_many_components(std::size_t events) {
+		slirc::irc context;
+		const auto create = [&context](std::size_t value) {
+			const auto ev = context.make_event(bench_events::created);
+			attach_components(*ev, value, std::make_index_sequence<many_components>());
+		};
+
+		create(0);
+		const std::size_t allocations_before = allocations;
+		for(std::size_t i = 0; i != events; ++i) {
+			create(i);
+		}
+		const std::size_t event_allocations = allocations - allocations_before;
+
+		std::cout << "event pool, " << many_components << " components: " << event_allocations << " allocations in " << events << " events\n";
+		return event_allocations;
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t events = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+	create_events("event pool", slirc::event_pool::default_capacity, events);
+	create_events("no event pool", 0, events);
+	return (create_events_with_many_components(events) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,125 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures events posted per second to a full event queue of 1024 events under
+// the drop_oldest, drop_newest and coalesce overflow policies, with every
+// fourth event posted to the front.
+//
+// Also checks that drop_oldest drops the event queued first, whether it was
+// posted to the front or the back of its lane. The benchmark fails if not.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		first,
+		second,
+		third,
+		fourth,
+		fifth,
+		sixth
+	};
+
+	using bench_clock = std::chrono::steady_clock;
+
+	void post_to_full_queue(const char *name, slirc::irc::overflow_policy policy, std::size_t events) {
+		constexpr std::size_t capacity = 1024;
+		slirc::irc context;
+		context.set_event_queue_capacity(capacity, policy);
+
+		for(std::size_t i = 0; i != capacity; ++i) {
+			context.make_event(bench_events::first)->post_back();
+		}
+
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != events; ++i) {
+			const auto ev = context.make_event(bench_events::first);
+			if (i % 4 == 0) {
+				ev->post_front();
+			}
+			else {
+				ev->post_back();
+			}
+		}
+		const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+		std::cout << name << ": " << static_cast<std::size_t>(events / seconds) << " posts/s\n";
+	}
+
+	bool drops_oldest() {
+		slirc::irc context;
+		context.set_event_queue_capacity(4, slirc::irc::overflow_policy::drop_oldest);
+
+		const auto post = [&context](bench_events id, bool front) {
+			const auto ev = context.make_event(id);
+			if (front) {
+				ev->post_front();
+			}
+			else {
+				ev->post_back();
+			}
+		};
+		post(bench_events::first, false);
+		post(bench_events::second, true);
+		post(bench_events::third, false);
+		post(bench_events::fourth, true);
+		// drop first, then second, which was posted to the front before third
+		post(bench_events::fifth, false);
+		post(bench_events::sixth, false);
+
+		// the front is fetched newest first, before the back
+		const std::vector<slirc::event_id> expected{
+			bench_events::fourth,
+			bench_events::third,
+			bench_events::fifth,
+			bench_events::sixth
+		};
+		std::vector<slirc::event_id> fetched;
+		while(const auto ev = context.fetch_event(std::chrono::milliseconds(0))) {
+			fetched.push_back(ev->original_id);
+		}
+		return fetched == expected;
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t events = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 4000000;
+
+	post_to_full_queue("drop_oldest", slirc::irc::overflow_policy::drop_oldest, events);
+	post_to_full_queue("drop_newest", slirc::irc::overflow_policy::drop_newest, events);
+	post_to_full_queue("coalesce", slirc::irc::overflow_policy::coalesce, events);
+
+	if (!drops_oldest()) {
+		std::cout << "drop_oldest did not drop the oldest events\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
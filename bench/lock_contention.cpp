@@ -0,0 +1,126 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures lock acquisitions per second of slirc::util::spin_lock, std::mutex
+// and the previous spin_lock, which retried compare_exchange_weak() after
+// std::this_thread::yield(), with 1 to 16 threads incrementing a shared
+// counter. Each thread does 0, 50 or 500 iterations of unrelated work between
+// acquisitions, giving high, medium and low contention.
+//
+// Contention depends on the number of cores; results from a machine with
+// fewer cores than threads mostly measure the cost of parking and waking.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../include/slirc/util/spin_lock.hpp"
+
+namespace {
+	using bench_clock = std::chrono::steady_clock;
+
+	// the previous spin_lock
+	class yield_lock {
+	public:
+		void lock() noexcept {
+			bool current_locked_flag;
+			while(!locked_.compare_exchange_weak(current_locked_flag = false, true)) {
+				std::this_thread::yield();
+			}
+		}
+
+		void unlock() noexcept {
+			locked_ = false;
+		}
+
+	private:
+		std::atomic<bool> locked_{ false };
+	};
+
+	volatile std::size_t work_sink;
+
+	void unrelated_work(std::size_t iterations) {
+		std::size_t value = 0;
+		for(std::size_t i = 0; i != iterations; ++i) {
+			value = value * 31 + i;
+		}
+		work_sink = value;
+	}
+
+	template<typename Lock>
+	void contend(const char *name, std::size_t threads, std::size_t work, std::size_t acquisitions) {
+		Lock lock;
+		std::size_t counter = 0;
+		std::atomic<bool> go(false);
+
+		std::vector<std::thread> workers;
+		for(std::size_t t = 0; t != threads; ++t) {
+			workers.emplace_back([&] {
+				while(!go) {
+					std::this_thread::yield();
+				}
+				for(std::size_t i = 0; i != acquisitions; ++i) {
+					{ std::lock_guard<Lock> guard(lock);
+						++counter;
+					}
+					unrelated_work(work);
+				}
+			});
+		}
+
+		const auto start = bench_clock::now();
+		go = true;
+		for(std::thread &worker : workers) {
+			worker.join();
+		}
+		const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+		std::cout
+			<< name << ", " << threads << " threads, " << work << " work: "
+			<< static_cast<std::size_t>(counter / seconds) << " acquisitions/s\n";
+
+		if (counter != threads * acquisitions) {
+			std::exit(EXIT_FAILURE);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t acquisitions = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 200000;
+	const std::size_t max_threads = std::max<std::size_t>(16, std::thread::hardware_concurrency());
+
+	for(std::size_t work : { 0, 50, 500 }) {
+		for(std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+			contend<slirc::util::spin_lock>("spin_lock", threads, work, acquisitions);
+			contend<std::mutex>("std::mutex", threads, work, acquisitions);
+			contend<yield_lock>("yield lock", threads, work, acquisitions);
+		}
+	}
+	return EXIT_SUCCESS;
+}
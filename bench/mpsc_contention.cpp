@@ -0,0 +1,118 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures events per second through an irc event queue with 1, 4 and 16
+// producer threads posting to the back of the queue while the main thread
+// fetches in batches of up to 256 events, once with the mutex based queue
+// and once with the lock-free queue. Events are created before the clock
+// starts, so only posting and fetching is measured.
+//
+// Contention depends on the number of cores; results from a machine with
+// fewer cores than threads mostly measure the cost of switching threads.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		posted
+	};
+
+	using bench_clock = std::chrono::steady_clock;
+
+	void contend(const char *name, bool lock_free, std::size_t producers, std::size_t events_per_producer) {
+		slirc::irc context;
+		if (lock_free) {
+			context.use_lock_free_event_queue();
+		}
+
+		std::vector<std::vector<std::shared_ptr<slirc::event>>> prepared(producers);
+		for(auto &events : prepared) {
+			events.reserve(events_per_producer);
+			for(std::size_t i = 0; i != events_per_producer; ++i) {
+				events.push_back(context.make_event(bench_events::posted));
+			}
+		}
+
+		std::atomic<bool> go(false);
+		std::vector<std::thread> threads;
+		for(auto &events : prepared) {
+			threads.emplace_back([&go, &events] {
+				while(!go) {
+					std::this_thread::yield();
+				}
+				for(const auto &ev : events) {
+					ev->post_back();
+				}
+			});
+		}
+
+		const std::size_t expected = producers * events_per_producer;
+		std::size_t fetched = 0;
+		std::vector<std::shared_ptr<slirc::event>> batch;
+		batch.reserve(256);
+
+		const auto start = bench_clock::now();
+		go = true;
+		while(fetched != expected) {
+			const std::size_t count = context.fetch_events(std::back_inserter(batch), 256, std::chrono::milliseconds(5000));
+			if (count == 0) {
+				break;
+			}
+			fetched += count;
+			batch.clear();
+		}
+		const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+		for(std::thread &thread : threads) {
+			thread.join();
+		}
+
+		std::cout
+			<< name << ", " << producers << " producers: "
+			<< static_cast<std::size_t>(fetched / seconds) << " events/s\n";
+
+		if (fetched != expected) {
+			std::exit(EXIT_FAILURE);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t events = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1600000;
+
+	for(std::size_t producers : { 1, 4, 16 }) {
+		contend("mutex queue", false, producers, events / producers);
+		contend("lock-free queue", true, producers, events / producers);
+	}
+	return EXIT_SUCCESS;
+}
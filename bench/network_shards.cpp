@@ -0,0 +1,230 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures throughput in IRC lines per second over loopback TCP connections,
+// for 1 to 256 connections served by a network_thread with 1 to 8 event
+// loops. Both ends of every connection get an io_service assigned through
+// slirc::acquire_io_service(). Every client writes batches of 64 lines of 64
+// bytes each until it has written its share; the servers count the bytes
+// read.
+//
+// The number of event loops only pays off up to the number of cores.
+//
+// Also checks that slirc::get_io_service() spreads IRC contexts over all
+// event loops when called off them, always picking the same one per context,
+// and that it picks the calling event loop when called on one. The benchmark
+// fails if not.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/network.hpp"
+
+namespace {
+	using bench_clock = std::chrono::steady_clock;
+	using boost::asio::ip::tcp;
+
+	constexpr std::size_t line_length = 64;
+	constexpr std::size_t lines_per_write = 64;
+
+	struct completion {
+		void finished() {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--remaining == 0) {
+				done.notify_one();
+			}
+		}
+
+		void wait() {
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock, [this] { return remaining == 0; });
+		}
+
+		std::mutex mutex;
+			std::condition_variable done;
+			std::size_t remaining;
+	};
+
+	struct bench_connection {
+		bench_connection()
+		: client_service(slirc::acquire_io_service())
+		, server_service(slirc::acquire_io_service())
+		, client(client_service)
+		, server(server_service) {}
+
+		~bench_connection() {
+			slirc::release_io_service(client_service);
+			slirc::release_io_service(server_service);
+		}
+
+		void start(const std::string &batch, std::size_t bytes, completion &completed) {
+			to_write = bytes;
+			to_read = bytes;
+			write(batch, completed);
+			read(completed);
+		}
+
+		void write(const std::string &batch, completion &completed) {
+			const std::size_t size = std::min(batch.size(), to_write);
+			to_write -= size;
+			boost::asio::async_write(client, boost::asio::buffer(batch.data(), size),
+				[this, &batch, &completed](const boost::system::error_code &error, std::size_t) {
+					if (error) {
+						std::exit(EXIT_FAILURE);
+					}
+					if (to_write != 0) {
+						write(batch, completed);
+					}
+				}
+			);
+		}
+
+		void read(completion &completed) {
+			server.async_read_some(boost::asio::buffer(buffer),
+				[this, &completed](const boost::system::error_code &error, std::size_t size) {
+					if (error) {
+						std::exit(EXIT_FAILURE);
+					}
+					to_read -= size;
+					if (to_read != 0) {
+						read(completed);
+					}
+					else {
+						completed.finished();
+					}
+				}
+			);
+		}
+
+		boost::asio::io_service &client_service;
+		boost::asio::io_service &server_service;
+		tcp::socket client;
+		tcp::socket server;
+		char buffer[16384];
+		std::size_t to_write = 0;
+		std::size_t to_read = 0;
+	};
+
+	void transfer(std::size_t threads, std::size_t connections, std::size_t lines) {
+		slirc::network_thread network(threads);
+
+		boost::asio::io_service accept_service;
+		tcp::acceptor acceptor(accept_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+
+		std::vector<std::unique_ptr<bench_connection>> established;
+		for(std::size_t i = 0; i != connections; ++i) {
+			established.push_back(std::make_unique<bench_connection>());
+			established.back()->client.connect(acceptor.local_endpoint());
+			acceptor.accept(established.back()->server);
+			established.back()->client.set_option(tcp::no_delay(true));
+		}
+
+		std::string line(line_length - 2, 'x');
+		line += "\r\n";
+		std::string batch;
+		for(std::size_t i = 0; i != lines_per_write; ++i) {
+			batch += line;
+		}
+
+		completion completed;
+		completed.remaining = connections;
+		const std::size_t bytes = lines / connections * line_length;
+
+		const auto start = bench_clock::now();
+		for(auto &current : established) {
+			current->start(batch, bytes, completed);
+		}
+		completed.wait();
+		const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+		std::cout
+			<< threads << " event loops, " << connections << " connections: "
+			<< static_cast<std::size_t>(bytes / line_length * connections / seconds) << " lines/s\n";
+
+		for(auto &current : established) {
+			current->client.close();
+			current->server.close();
+		}
+	}
+
+	bool spreads_contexts(std::size_t threads) {
+		slirc::network_thread network(threads);
+
+		std::vector<std::unique_ptr<slirc::irc>> contexts;
+		std::vector<std::size_t> contexts_per_shard(threads, 0);
+		for(std::size_t i = 0; i != 16 * threads; ++i) {
+			contexts.push_back(std::make_unique<slirc::irc>());
+			boost::asio::io_service &io_service = slirc::get_io_service(*contexts.back());
+			if (&slirc::get_io_service(*contexts.back()) != &io_service) {
+				return false;
+			}
+			for(std::size_t shard = 0; shard != threads; ++shard) {
+				if (&network.get_io_service(shard) == &io_service) {
+					++contexts_per_shard[shard];
+				}
+			}
+		}
+		if (std::count(contexts_per_shard.begin(), contexts_per_shard.end(), 0) != 0) {
+			return false;
+		}
+
+		boost::asio::io_service &last_shard = network.get_io_service(threads - 1);
+		std::promise<boost::asio::io_service *> on_shard;
+		last_shard.post([&] {
+			on_shard.set_value(&slirc::get_io_service(*contexts.front()));
+		});
+		return on_shard.get_future().get() == &last_shard;
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t lines = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 4000000;
+
+	for(std::size_t threads = 1; threads <= 8; threads *= 2) {
+		if (!spreads_contexts(threads)) {
+			std::cout << threads << " event loops: IRC contexts are not spread over the event loops\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	for(std::size_t threads = 1; threads <= 8; threads *= 2) {
+		for(std::size_t connections = 1; connections <= 256; connections *= 4) {
+			transfer(threads, connections, lines);
+		}
+	}
+	return EXIT_SUCCESS;
+}
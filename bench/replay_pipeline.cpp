@@ -0,0 +1,137 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Records a synthetic stream of received IRC lines, posted in batches of 64
+// as the connection modules do, into an in-memory log and replays it into a fresh IRC context, whose events are fetched and emitted
+// by a consumer thread with an event handler routed by channel. Reports the
+// throughput of the whole event pipeline and the latency from posting an
+// event to the end of its last event handler.
+//
+// Replays as fast as possible by default; the first argument selects the
+// number of lines, the second one a replay speed factor (1 = recorded pace).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/slirc/apis/connection.hpp"
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/event_recording.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	using bench_clock = std::chrono::steady_clock;
+	using channel_key = slirc::irc::route_key<slirc::apis::connection::message_target>;
+
+	const std::size_t channels = 100;
+
+	std::string record_lines(std::size_t lines) {
+		std::ostringstream log(std::ios::binary);
+		slirc::irc context;
+		slirc::event_recorder recorder(context, log);
+		std::vector<std::shared_ptr<slirc::event>> batch;
+		for(std::size_t i = 0; i != lines; ++i) {
+			const auto ev = context.make_event(slirc::apis::connection::on_message_received);
+			ev->push_back(slirc::apis::connection::on_message_received);
+			ev->data.insert(slirc::apis::connection::raw_message::copy(
+				":nick" + std::to_string(i % 37) + "!user@host PRIVMSG #channel" + std::to_string(i % channels) + " :message " + std::to_string(i)
+			));
+			batch.push_back(ev);
+			if (batch.size() == 64 || i + 1 == lines) {
+				context.post_events_back(batch.begin(), batch.end());
+				batch.clear();
+				context.fetch_events(std::back_inserter(batch), 64, std::chrono::milliseconds(0));
+				batch.clear();
+				// spread the recording over some time, as a network would
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		}
+		recorder.stop();
+		return log.str();
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t lines = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 200000;
+	const double speed = (argc > 2) ? std::strtod(argv[2], nullptr) : 0.0;
+
+	std::istringstream log(record_lines(lines), std::ios::binary);
+	const slirc::event_replay replay(log);
+	std::cout << "recorded " << replay.size() << " lines in " << std::chrono::duration<double>(replay.duration()).count() << " s\n";
+	if (replay.size() != lines) {
+		// lines posted in batches went unrecorded
+		return EXIT_FAILURE;
+	}
+
+	slirc::irc context;
+	std::atomic<std::size_t> handled(0);
+	std::vector<bench_clock::duration> latencies;
+	latencies.reserve(replay.size());
+
+	context.connect(slirc::apis::connection::on_message_received, [](slirc::event &ev) {
+		const std::string_view line = ev.data.at<slirc::apis::connection::raw_message>().line;
+		const auto target = line.find(" #");
+		ev.data.insert(channel_key{ std::string(line.substr(target + 1, line.find(' ', target + 1) - target - 1)) });
+	}, slirc::irc::at_front);
+	for(std::size_t channel = 0; channel != channels; ++channel) {
+		context.connect_routed<slirc::apis::connection::message_target>(
+			slirc::apis::connection::on_message_received,
+			"#channel" + std::to_string(channel),
+			[&handled](slirc::event &) { ++handled; }
+		);
+	}
+	context.set_post_observer([](slirc::event &ev, std::size_t, bool) {
+		ev.data.insert(bench_clock::now());
+	});
+
+	// the posting time travels with the event, so the latency covers the queue
+	std::thread consumer([&]{
+		while(const auto ev = context.fetch_event(std::chrono::milliseconds(100))) {
+			ev->emit();
+			latencies.push_back(bench_clock::now() - ev->data.at<bench_clock::time_point>());
+		}
+	});
+	const auto stats = replay.replay(context, speed);
+	consumer.join();
+
+	std::sort(latencies.begin(), latencies.end());
+	const auto percentile = [&](double p) {
+		return std::chrono::duration<double, std::micro>(latencies[static_cast<std::size_t>(p * (latencies.size() - 1))]).count();
+	};
+	std::cout
+		<< "replayed " << stats.posted << " lines (" << stats.skipped << " skipped) in "
+		<< std::chrono::duration<double>(stats.elapsed).count() << " s, "
+		<< static_cast<std::size_t>(stats.posted / std::chrono::duration<double>(stats.elapsed).count()) << " lines/s, "
+		<< "max lag " << std::chrono::duration<double, std::micro>(stats.max_lag).count() << " us\n"
+		<< "latency p50 " << percentile(0.5) << " us, p99 " << percentile(0.99) << " us, max " << percentile(1.0) << " us\n";
+	return (handled == lines && stats.posted == lines) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
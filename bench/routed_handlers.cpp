@@ -0,0 +1,101 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures emits per second of a message event with 1, 100 and 2000 per
+// channel event handlers connected, once through irc::connect() with each
+// event handler filtering by channel itself and once through
+// irc::connect_routed() with the channel as routing key.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../include/slirc/apis/connection.hpp"
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	using channel_key = slirc::irc::route_key<slirc::apis::connection::message_target>;
+	using bench_clock = std::chrono::steady_clock;
+
+	void report(const char *name, std::size_t handlers, std::size_t emits, bench_clock::duration elapsed) {
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+		std::cout
+			<< name << ", " << handlers << " channels: "
+			<< static_cast<std::size_t>(emits / seconds) << " emits/s\n";
+	}
+
+	std::string channel_name(std::size_t i) {
+		return "#channel" + std::to_string(i);
+	}
+
+	bench_clock::duration emit_messages(slirc::irc &context, std::size_t channels, std::size_t emits) {
+		const auto ev = context.make_event(slirc::apis::connection::on_message_received);
+		ev->data.insert(channel_key{ channel_name(channels / 2) });
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != emits; ++i) {
+			context.emit_event(*ev);
+		}
+		return bench_clock::now() - start;
+	}
+
+	bench_clock::duration filtered(std::size_t channels, std::size_t emits, std::size_t &calls) {
+		slirc::irc context;
+		for(std::size_t i = 0; i != channels; ++i) {
+			context.connect(slirc::apis::connection::on_message_received, [&calls, channel = channel_name(i)](slirc::event &ev) {
+				if (ev.data.at<channel_key>().value == channel) {
+					++calls;
+				}
+			});
+		}
+		return emit_messages(context, channels, emits);
+	}
+
+	bench_clock::duration routed(std::size_t channels, std::size_t emits, std::size_t &calls) {
+		slirc::irc context;
+		for(std::size_t i = 0; i != channels; ++i) {
+			context.connect_routed<slirc::apis::connection::message_target>(
+				slirc::apis::connection::on_message_received,
+				channel_name(i),
+				[&calls](slirc::event &) { ++calls; }
+			);
+		}
+		return emit_messages(context, channels, emits);
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t emits = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 100000;
+
+	bool all_called = true;
+	for(std::size_t channels: { 1, 100, 2000 }) {
+		std::size_t filtered_calls = 0;
+		std::size_t routed_calls = 0;
+		report("filtered", channels, emits, filtered(channels, emits, filtered_calls));
+		report("routed", channels, emits, routed(channels, emits, routed_calls));
+		all_called = all_called && filtered_calls == emits && routed_calls == emits;
+	}
+	return all_called ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,177 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures events handled per second by a slirc::scheduler with 1 to 16
+// worker threads driving 1000 IRC contexts. Each context starts with 8
+// events in flight; the handler of each event posts the next one until the
+// context handled its share of events, so every event also goes through the
+// run queues. A handler does 0 or 2000 iterations of unrelated work, giving
+// cheap and expensive events.
+//
+// Scaling depends on the number of cores; results from a machine with fewer
+// cores than worker threads mostly measure the cost of stealing.
+//
+// Also checks that a scheduler can be destroyed while an attached context
+// keeps posting events to itself.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/scheduler.hpp"
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		ping
+	};
+
+	using bench_clock = std::chrono::steady_clock;
+
+	constexpr std::size_t contexts = 1000;
+	constexpr std::size_t events_in_flight = 8;
+
+	volatile std::size_t work_sink;
+
+	void unrelated_work(std::size_t iterations) {
+		std::size_t value = 0;
+		for(std::size_t i = 0; i != iterations; ++i) {
+			value = value * 31 + i;
+		}
+		work_sink = value;
+	}
+
+	void post_ping(slirc::irc &context) {
+		const auto ev = context.make_event(bench_events::ping);
+		ev->push_back(bench_events::ping);
+		ev->post_back();
+	}
+
+	struct completion {
+		void finished() {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--remaining == 0) {
+				done.notify_one();
+			}
+		}
+
+		bool wait_for(std::chrono::milliseconds timeout) {
+			std::unique_lock<std::mutex> lock(mutex);
+			return done.wait_for(lock, timeout, [this] { return remaining == 0; });
+		}
+
+		std::mutex mutex;
+			std::condition_variable done;
+			std::size_t remaining;
+	};
+
+	void run(std::size_t threads, std::size_t work, std::size_t events_per_context) {
+		std::vector<std::unique_ptr<slirc::irc>> irc_contexts;
+		std::vector<std::size_t> remaining(contexts, events_per_context);
+		completion completed;
+		completed.remaining = contexts;
+
+		for(std::size_t i = 0; i != contexts; ++i) {
+			irc_contexts.push_back(std::make_unique<slirc::irc>());
+			// only the worker running the context touches its counter
+			irc_contexts.back()->connect(bench_events::ping, [&remaining, &completed, work, i](slirc::event &ev) {
+				unrelated_work(work);
+				if (--remaining[i] == 0) {
+					completed.finished();
+				}
+				else if (remaining[i] >= events_in_flight) {
+					post_ping(ev.irc);
+				}
+			});
+		}
+
+		slirc::scheduler workers(threads);
+		for(auto &context : irc_contexts) {
+			workers.attach(*context);
+		}
+
+		const auto start = bench_clock::now();
+		for(auto &context : irc_contexts) {
+			for(std::size_t i = 0; i != std::min(events_in_flight, events_per_context); ++i) {
+				post_ping(*context);
+			}
+		}
+		const bool finished = completed.wait_for(std::chrono::milliseconds(60000));
+		const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+		std::cout
+			<< threads << " threads, " << work << " work: "
+			<< static_cast<std::size_t>(contexts * events_per_context / seconds) << " events/s\n";
+
+		for(auto &context : irc_contexts) {
+			workers.detach(*context);
+		}
+		if (!finished) {
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	bool stops_while_busy() {
+		std::promise<void> stopped;
+		auto stopped_future = stopped.get_future();
+		std::thread([&stopped] {
+			slirc::irc context;
+			context.connect(bench_events::ping, [](slirc::event &ev) {
+				post_ping(ev.irc);
+			});
+			{ slirc::scheduler workers(1);
+				workers.attach(context);
+				post_ping(context);
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+			stopped.set_value();
+		}).detach();
+		return stopped_future.wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+	}
+}
+
+int main(int argc, char **argv) {
+	if (!stops_while_busy()) {
+		std::cout << "scheduler did not stop while a context kept posting events\n";
+		return EXIT_FAILURE;
+	}
+
+	const std::size_t events_per_context = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 2000;
+
+	for(std::size_t work : { 0, 2000 }) {
+		for(std::size_t threads = 1; threads <= 16; threads *= 2) {
+			run(threads, work, events_per_context);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures message derivations per second, where a parsed PRIVMSG event spawns
+// a CTCP event, which in turn spawns a bot command event, each reading the
+// parse result of the original message. Runs once with the spawned events
+// reading the inherited component and once copying it into every spawned
+// event, as handlers had to before events inherited the data of their origin.
+// Reports the heap allocations per message, counted through a replaced
+// operator new.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	std::atomic<std::size_t> allocations(0);
+}
+
+void *operator new(std::size_t size) {
+	++allocations;
+	if (void * const memory = std::malloc(size ? size : 1)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		privmsg,
+		ctcp,
+		bot_command
+	};
+
+	struct parsed_message {
+		std::string prefix;
+		std::string command;
+		std::vector<std::string> params;
+	};
+
+	using bench_clock = std::chrono::steady_clock;
+
+	void derive_messages(const char *name, bool copy, std::size_t messages) {
+		slirc::irc context;
+		std::size_t handled = 0;
+
+		context.connect(bench_events::privmsg, [copy](slirc::event &ev) {
+			const auto ctcp = ev.spawn(bench_events::ctcp);
+			if (copy) {
+				ctcp->data.insert(ev.data.at<const parsed_message>());
+			}
+			ctcp->push_back(bench_events::ctcp);
+			ctcp->emit();
+		});
+		context.connect(bench_events::ctcp, [copy](slirc::event &ev) {
+			if (ev.data.at<const parsed_message>().params.back().front() == '\x01') {
+				const auto command = ev.spawn(bench_events::bot_command);
+				if (copy) {
+					command->data.insert(ev.data.at<const parsed_message>());
+				}
+				command->push_back(bench_events::bot_command);
+				command->emit();
+			}
+		});
+		context.connect(bench_events::bot_command, [&handled](slirc::event &ev) {
+			handled += ev.data.at<const parsed_message>().params.size();
+		});
+
+		const parsed_message message{
+			"nickname!username@some.host.example",
+			"PRIVMSG",
+			{ "#channel", "\x01" "ACTION derives a bot command from a CTCP request\x01" }
+		};
+
+		const std::size_t allocations_before = allocations;
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != messages; ++i) {
+			const auto ev = context.make_event(bench_events::privmsg);
+			ev->push_back(bench_events::privmsg);
+			ev->data.insert(message);
+			ev->emit();
+		}
+		const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+		const double allocations_per_message = static_cast<double>(allocations - allocations_before) / messages;
+
+		std::cout
+			<< name << ": "
+			<< static_cast<std::size_t>(messages / seconds) << " messages/s, "
+			<< allocations_per_message << " allocations per message\n";
+
+		if (handled != 2 * messages) {
+			std::exit(EXIT_FAILURE);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t messages = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+	derive_messages("inherited", false, messages);
+	derive_messages("copied", true, messages);
+	return EXIT_SUCCESS;
+}
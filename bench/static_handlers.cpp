@@ -0,0 +1,116 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures emits per second with 1, 10 and 100 event handlers for the emitted
+// event id, once registered at compile time as static handlers of a module and
+// once connected at runtime through irc::connect().
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/module.hpp"
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		emitted,
+		other
+	};
+
+	using bench_clock = std::chrono::steady_clock;
+
+	void report(const char *name, std::size_t handlers, std::size_t emits, bench_clock::duration elapsed) {
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+		std::cout
+			<< name << ", " << handlers << " handlers: "
+			<< static_cast<std::size_t>(emits / seconds) << " emits/s\n";
+	}
+
+	template<std::size_t... Is>
+	struct counting_module
+	: slirc::module<counting_module<Is...>> {
+		template<std::size_t>
+		void on_emitted(slirc::event &) { ++calls; }
+
+		void on_other(slirc::event &) { ++calls; }
+
+		using slirc_static_handlers = slirc::static_handlers<
+			slirc::static_handler<bench_events::emitted, &counting_module::on_emitted<Is>>...,
+			slirc::static_handler<bench_events::other, &counting_module::on_other>
+		>;
+
+		counting_module(slirc::irc &irc, std::size_t &calls)
+		: slirc::module<counting_module<Is...>>(irc)
+		, calls(calls) {}
+
+		std::size_t &calls;
+	};
+
+	template<std::size_t... Is>
+	bench_clock::duration static_handlers(std::index_sequence<Is...>, std::size_t emits, std::size_t &calls) {
+		slirc::irc context;
+		context.load_module<counting_module<Is...>>(calls);
+
+		const auto ev = context.make_event(bench_events::emitted);
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != emits; ++i) {
+			context.emit_event(*ev);
+		}
+		return bench_clock::now() - start;
+	}
+
+	bench_clock::duration dynamic_handlers(std::size_t handlers, std::size_t emits, std::size_t &calls) {
+		slirc::irc context;
+		for(std::size_t i = 0; i != handlers; ++i) {
+			context.connect(bench_events::emitted, [&calls](slirc::event &) { ++calls; });
+			context.connect(bench_events::other, [&calls](slirc::event &) { ++calls; });
+		}
+
+		const auto ev = context.make_event(bench_events::emitted);
+		const auto start = bench_clock::now();
+		for(std::size_t i = 0; i != emits; ++i) {
+			context.emit_event(*ev);
+		}
+		return bench_clock::now() - start;
+	}
+
+	template<std::size_t Handlers>
+	bool compare(std::size_t handler_calls) {
+		const std::size_t emits = handler_calls / Handlers;
+		std::size_t static_calls = 0;
+		std::size_t dynamic_calls = 0;
+		report("static handlers", Handlers, emits, static_handlers(std::make_index_sequence<Handlers>(), emits, static_calls));
+		report("dynamic handlers", Handlers, emits, dynamic_handlers(Handlers, emits, dynamic_calls));
+		return static_calls == emits * Handlers && dynamic_calls == emits * Handlers;
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t handler_calls = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+
+	const bool all_called = compare<1>(handler_calls) && compare<10>(handler_calls) && compare<100>(handler_calls);
+	return all_called ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,260 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures received IRC lines per second over loopback TCP, for 1 to 1024
+// connections to a local server writing 64 byte lines in batches of 64,
+// once through slirc::modules::uring_connection and once through
+// slirc::modules::connection on the io_service of a network_thread. Both
+// post one on_message_received event per line, in batches per read; the
+// events are fetched and counted on the main thread.
+//
+// Also checks for both that the event queue stays within its capacity under
+// the block overflow policy, and that the thread fetching events can send and
+// disconnect while the queue is full.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "../include/slirc/apis/connection.hpp"
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/modules/connection.hpp"
+#include "../include/slirc/modules/uring_connection.hpp"
+#include "../include/slirc/network.hpp"
+
+namespace {
+	using bench_clock = std::chrono::steady_clock;
+	using boost::asio::ip::tcp;
+
+	constexpr std::size_t line_length = 64;
+	constexpr std::size_t lines_per_write = 64;
+
+	// lines posted after the high watermark: the multishot receives complete
+	// into at most all receive buffers of the service before being cancelled
+	std::size_t max_overshoot(std::size_t) {
+		return slirc::modules::uring_service::default_buffers * slirc::modules::uring_service::default_buffer_size / line_length;
+	}
+
+	// accepts connections and writes lines to all of them once started
+	class line_server {
+	public:
+		line_server()
+		: acceptor_(io_service_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)) {
+			std::string line(line_length - 2, 'x');
+			line += "\r\n";
+			for(std::size_t i = 0; i != lines_per_write; ++i) {
+				batch_ += line;
+			}
+		}
+
+		unsigned port() const {
+			return acceptor_.local_endpoint().port();
+		}
+
+		void accept(std::size_t connections) {
+			for(std::size_t i = 0; i != connections; ++i) {
+				sockets_.push_back(std::make_unique<tcp::socket>(io_service_));
+				acceptor_.accept(*sockets_.back());
+			}
+		}
+
+		void write(std::size_t bytes_per_connection) {
+			for(auto &socket : sockets_) {
+				write(*socket, bytes_per_connection);
+			}
+			// the connections stay open until the server goes away, so the
+			// clients see no disconnect while their event queue is checked
+			io_service_.run();
+			io_service_.reset();
+		}
+
+	private:
+		void write(tcp::socket &socket, std::size_t remaining) {
+			const std::size_t size = std::min(batch_.size(), remaining);
+			boost::asio::async_write(socket, boost::asio::buffer(batch_.data(), size),
+				[this, &socket, remaining = remaining - size](const boost::system::error_code &error, std::size_t) {
+					if (!error && remaining != 0) {
+						write(socket, remaining);
+					}
+				}
+			);
+		}
+
+		boost::asio::io_service io_service_;
+		tcp::acceptor acceptor_;
+		std::vector<std::unique_ptr<tcp::socket>> sockets_;
+		std::string batch_;
+	};
+
+	template<typename MakeConnection>
+	void receive(const char *name, std::size_t connections, std::size_t lines, MakeConnection make_connection, std::size_t high_watermark = 0) {
+		slirc::irc context;
+		if (high_watermark != 0) {
+			context.set_event_queue_watermarks(high_watermark, high_watermark / 4);
+		}
+		line_server server;
+
+		std::vector<std::unique_ptr<slirc::apis::connection>> clients;
+		std::thread acceptor([&] { server.accept(connections); });
+		for(std::size_t i = 0; i != connections; ++i) {
+			clients.push_back(make_connection(context, server.port()));
+			clients.back()->connect();
+		}
+		acceptor.join();
+
+		const std::size_t lines_per_connection = lines / connections;
+		const std::size_t expected = lines_per_connection * connections;
+		const auto start = bench_clock::now();
+		std::thread writer([&] { server.write(lines_per_connection * line_length); });
+
+		std::size_t received = 0;
+		std::size_t max_depth = 0;
+		std::vector<std::shared_ptr<slirc::event>> events;
+		while(received != expected && context.fetch_events(std::back_inserter(events), 1024, std::chrono::milliseconds(5000))) {
+			max_depth = std::max(max_depth, context.event_queue_depth() + events.size());
+			if (high_watermark != 0) {
+				// a slow handler thread
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+			for(const auto &ev : events) {
+				if (ev->data.find<const slirc::apis::connection::raw_message>()) {
+					++received;
+				}
+			}
+			events.clear();
+		}
+		const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+		writer.join();
+
+		std::cout
+			<< name << ", " << connections << " connections"
+			<< (high_watermark != 0 ? ", slow handler" : "") << ": "
+			<< static_cast<std::size_t>(received / seconds) << " lines/s, "
+			<< max_depth << " max queue depth\n";
+
+		clients.clear();
+		if (received != expected) {
+			std::exit(EXIT_FAILURE);
+		}
+		if (high_watermark != 0 && max_depth > high_watermark + max_overshoot(connections)) {
+			// reading did not stop at the high watermark
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	template<typename MakeConnection>
+	void disconnect_while_full(const char *name, std::size_t lines, MakeConnection make_connection) {
+		constexpr std::size_t capacity = 256;
+		slirc::irc context;
+		context.set_event_queue_capacity(capacity, slirc::irc::overflow_policy::block);
+		line_server server;
+
+		std::thread acceptor([&] { server.accept(1); });
+		auto client = make_connection(context, server.port());
+		client->connect();
+		acceptor.join();
+		std::thread writer([&] { server.write(lines * line_length); });
+
+		std::size_t received = 0;
+		std::size_t max_depth = 0;
+		std::vector<std::shared_ptr<slirc::event>> events;
+		while(received < lines / 2 && context.fetch_events(std::back_inserter(events), 64, std::chrono::milliseconds(5000))) {
+			max_depth = std::max(max_depth, context.event_queue_depth());
+			for(const auto &ev : events) {
+				if (ev->data.find<const slirc::apis::connection::raw_message>()) {
+					++received;
+				}
+			}
+			events.clear();
+		}
+		// wait until the lines stopped being posted to the full event queue
+		std::size_t depth;
+		do {
+			depth = context.event_queue_depth();
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		} while(depth != context.event_queue_depth());
+		max_depth = std::max(max_depth, depth);
+
+		std::promise<void> disconnected;
+		std::thread watchdog([name, future = disconnected.get_future()] {
+			if (future.wait_for(std::chrono::seconds(10)) != std::future_status::ready) {
+				std::cout << name << ": disconnecting while the event queue is full did not return" << std::endl;
+				std::_Exit(EXIT_FAILURE);
+			}
+		});
+		client->send("QUIT\r\n");
+		client->disconnect();
+		disconnected.set_value();
+		watchdog.join();
+		writer.join();
+
+		std::cout << name << ", full event queue of " << capacity << " events: " << max_depth << " max queue depth\n";
+		if (received < lines / 2 || max_depth > capacity) {
+			std::exit(EXIT_FAILURE);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t lines = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 4000000;
+
+	slirc::network_thread network;
+	const auto service = std::make_shared<slirc::modules::uring_service>();
+
+	disconnect_while_full("uring_connection", std::min<std::size_t>(lines, 100000), [&service](slirc::irc &context, unsigned port) {
+		return std::make_unique<slirc::modules::uring_connection>(context, "127.0.0.1", port, service);
+	});
+	disconnect_while_full("connection", std::min<std::size_t>(lines, 100000), [](slirc::irc &context, unsigned port) {
+		return std::make_unique<slirc::modules::connection>(context, "127.0.0.1", port);
+	});
+
+	for(std::size_t connections = 1; connections <= 1024; connections *= 4) {
+		receive("uring_connection", connections, lines, [&service](slirc::irc &context, unsigned port) {
+			return std::make_unique<slirc::modules::uring_connection>(context, "127.0.0.1", port, service);
+		});
+		receive("connection", connections, lines, [](slirc::irc &context, unsigned port) {
+			return std::make_unique<slirc::modules::connection>(context, "127.0.0.1", port);
+		});
+	}
+
+	// reading stops at the high watermark of 4096 events, so the queue stays
+	// bounded while the handler thread cannot keep up
+	receive("uring_connection", 16, lines / 4, [&service](slirc::irc &context, unsigned port) {
+		return std::make_unique<slirc::modules::uring_connection>(context, "127.0.0.1", port, service);
+	}, 4096);
+	receive("connection", 16, lines / 4, [](slirc::irc &context, unsigned port) {
+		return std::make_unique<slirc::modules::connection>(context, "127.0.0.1", port);
+	}, 4096);
+	return EXIT_SUCCESS;
+}
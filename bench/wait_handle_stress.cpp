@@ -0,0 +1,117 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// Stress test of the wait handle of an irc context: 1, 4 and 16 producer
+// threads post events in small bursts while the main thread waits for the
+// eventfd with poll() and fetches with a timeout of 0 whenever it becomes
+// readable, once with the mutex based and once with the lock-free event
+// queue. Fails if poll() times out while events are queued, i.e. if a wakeup
+// got lost. Reports fetched events per second and the number of wakeups.
+
+#include <poll.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	enum class bench_events: slirc::event_id::enum_type {
+		posted
+	};
+
+	using bench_clock = std::chrono::steady_clock;
+
+	void stress(const char *name, bool lock_free, std::size_t producers, std::size_t events_per_producer) {
+		slirc::irc context;
+		if (lock_free) {
+			context.use_lock_free_event_queue();
+		}
+		const int wait_handle = context.enable_wait_handle();
+
+		std::atomic<bool> go(false);
+		std::vector<std::thread> threads;
+		for(std::size_t p = 0; p != producers; ++p) {
+			threads.emplace_back([&context, &go, events_per_producer, p] {
+				while(!go) {
+					std::this_thread::yield();
+				}
+				for(std::size_t i = 0; i != events_per_producer; ++i) {
+					context.make_event(bench_events::posted)->post_back();
+					// bursts of varying length, so posts hit the consumer
+					// draining the queue as well as an idle consumer
+					if ((i + p) % (1 + (i / 7) % 13) == 0) {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+
+		const std::size_t expected = producers * events_per_producer;
+		std::size_t fetched = 0;
+		std::size_t wakeups = 0;
+		std::vector<std::shared_ptr<slirc::event>> batch;
+
+		const auto start = bench_clock::now();
+		go = true;
+		while(fetched != expected) {
+			pollfd readable = { wait_handle, POLLIN, 0 };
+			if (poll(&readable, 1, 2000) != 1) {
+				std::cout
+					<< name << ", " << producers << " producers: lost wakeup with "
+					<< context.event_queue_depth() << " events queued\n";
+				std::exit(EXIT_FAILURE);
+			}
+			++wakeups;
+			fetched += context.fetch_events(std::back_inserter(batch), expected, std::chrono::milliseconds(0));
+			batch.clear();
+		}
+		const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+		for(std::thread &thread : threads) {
+			thread.join();
+		}
+
+		std::cout
+			<< name << ", " << producers << " producers: "
+			<< static_cast<std::size_t>(fetched / seconds) << " events/s, "
+			<< wakeups << " wakeups\n";
+	}
+}
+
+int main(int argc, char **argv) {
+	const std::size_t events = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 800000;
+
+	for(std::size_t producers : { 1, 4, 16 }) {
+		stress("mutex queue", false, producers, events / producers);
+		stress("lock-free queue", true, producers, events / producers);
+	}
+	return EXIT_SUCCESS;
+}
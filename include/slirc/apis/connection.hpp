@@ -27,6 +27,8 @@
 #ifndef LIBSLIRC_APIS_CONNECTION_HPP
 #define LIBSLIRC_APIS_CONNECTION_HPP
 
+#include <memory>
+#include <string>
 #include <string_view>
 
 #include "../event_id.hpp"
@@ -52,6 +54,35 @@ struct connection
 		on_message_received
 	};
 
+	/**
+	 * \brief Data of \c on_message_received events: The received line.
+	 *
+	 * The line is a view into memory owned by \c storage, usually the buffer
+	 * the connection received it into, so lines are not copied on receipt.
+	 * Copies of the message share the storage.
+	 */
+	struct raw_message {
+		/**
+		 * \brief Creates a message owning a copy of a line.
+		 * \param line The line to copy.
+		 * \return The message.
+		 */
+		static raw_message copy(std::string_view line) {
+			auto copied_line = std::make_shared<const std::string>(line);
+			return raw_message{ *copied_line, std::move(copied_line) };
+		}
+
+		std::string_view line; ///< @brief The line as received, without line ending
+		std::shared_ptr<const void> storage; ///< @brief Keeps the memory \c line points into alive
+	};
+
+	/// \name Routing keys of \c on_message_received events, see \c irc::connect_routed().
+	/// @{
+	struct message_command; ///< @brief The command of the message, e.g. \c PRIVMSG
+	struct message_target; ///< @brief The channel or nick the message is addressed to
+	struct message_sender; ///< @brief The nick the message was sent by
+	/// @}
+
 	using module<connection>::module;
 
 	virtual void connect() = 0;
@@ -0,0 +1,173 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_COROUTINE_HPP
+#define LIBSLIRC_COROUTINE_HPP
+
+#if !defined(__cpp_impl_coroutine)
+#error "slirc/coroutine.hpp requires C++20 coroutine support."
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+
+#include "event.hpp"
+#include "event_id.hpp"
+#include "irc.hpp"
+
+namespace slirc {
+
+/**
+ * \brief Return type for coroutines that run on their own.
+ *
+ * A coroutine returning \c detached_coroutine starts running immediately and
+ * cleans up after itself once it finishes. Exceptions escaping it call
+ * \c std::terminate().
+ *
+ * \code
+ * slirc::detached_coroutine registration(slirc::irc &context) {
+ *     auto ev = co_await slirc::next_event(context);
+ *     // ...
+ * }
+ * \endcode
+ */
+struct detached_coroutine {
+	struct promise_type {
+		detached_coroutine get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+/**
+ * \brief Awaitable fetching the next event from an IRC contexts event queue.
+ * \see next_event()
+ */
+class next_event_awaiter {
+public:
+	explicit next_event_awaiter(irc &context) noexcept
+	: context_(context)
+	, result_() {}
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> coroutine) {
+		context_.async_fetch_event([this, coroutine](std::shared_ptr<event> ev) {
+			result_ = std::move(ev);
+			coroutine.resume();
+		});
+	}
+
+	std::shared_ptr<event> await_resume() noexcept {
+		return std::move(result_);
+	}
+
+private:
+	irc &context_;
+	std::shared_ptr<event> result_;
+};
+
+/**
+ * \brief Awaitable waiting for an event to be emitted with a given id.
+ * \see wait_for()
+ */
+class wait_for_awaiter {
+public:
+	wait_for_awaiter(irc &context, const event_id &id) noexcept
+	: context_(context)
+	, id_(id)
+	, result_() {}
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> coroutine) {
+		context_.async_wait_for(id_, [this, coroutine](std::shared_ptr<event> ev) {
+			result_ = std::move(ev);
+			coroutine.resume();
+		});
+	}
+
+	std::shared_ptr<event> await_resume() noexcept {
+		return std::move(result_);
+	}
+
+private:
+	irc &context_;
+	event_id id_;
+	std::shared_ptr<event> result_;
+};
+
+/**
+ * \brief Fetches the next event from the event queue of an IRC context.
+ *
+ * <tt>co_await next_event(context)</tt> suspends the coroutine until an
+ * event becomes available and resumes it on the active io_service. See
+ * \c irc::async_fetch_event().
+ *
+ * \param context The IRC context to fetch the event from.
+ * \return An awaitable yielding the fetched event, or \c nullptr if the IRC
+ *         context was destructed meanwhile.
+ */
+inline next_event_awaiter next_event(irc &context) noexcept {
+	return next_event_awaiter(context);
+}
+
+/**
+ * \brief Waits for an event to be emitted with a given id.
+ *
+ * <tt>co_await wait_for(context, id)</tt> suspends the coroutine until the
+ * next event is emitted for \c id and resumes it on the active io_service,
+ * after the event handlers of \c id connected before have seen the event.
+ * See \c irc::async_wait_for().
+ *
+ * \param context The IRC context to watch.
+ * \param id The event id to wait for.
+ * \return An awaitable yielding the emitted event.
+ */
+inline wait_for_awaiter wait_for(irc &context, const event_id &id) noexcept {
+	return wait_for_awaiter(context, id);
+}
+
+/**
+ * \brief Waits for an event to be emitted with a given id in the IRC context of an event.
+ * \param ev The event whose IRC context to watch.
+ * \param id The event id to wait for.
+ * \return An awaitable yielding the emitted event.
+ */
+inline wait_for_awaiter wait_for(event &ev, const event_id &id) noexcept {
+	return wait_for_awaiter(ev.irc, id);
+}
+
+}
+
+#endif //LIBSLIRC_COROUTINE_HPP
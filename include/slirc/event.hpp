@@ -27,16 +27,18 @@
 #ifndef LIBSLIRC_EVENT_HPP
 #define LIBSLIRC_EVENT_HPP
 
+#include <chrono>
 #include <memory>
-#include <vector>
 
 #include "event_id.hpp"
+#include "event_pool.hpp"
+#include "event_trace.hpp"
+#include "irc.hpp"
 #include "util/component_map.hpp"
+#include "util/timer_wheel.hpp"
 
 namespace slirc {
 
-class irc;
-
 class event: public std::enable_shared_from_this<event> {
 private:
 	struct private_construction_tag;
@@ -48,10 +50,14 @@ public:
 	 * \brief Internal use only
 	 * \sa <tt>create(slirc::irc &irc, const event_id &original_id)</tt>
 	 */
-	event(const private_construction_tag &, slirc::irc &, const event_id &, pointer);
+	event(const private_construction_tag &, slirc::irc &, const event_id &, pointer, event_pool &);
+	~event();
 
 	/**
 	 * \brief Create a new event
+	 *
+	 * The event is allocated from the IRC contexts \c event_pool.
+	 *
 	 * \param irc The IRC context the event belongs to.
 	 * \param original_id The starting ID for this event.
 	 * \return A smart pointer to the newly created event.
@@ -63,6 +69,7 @@ public:
 	 * \param irc The IRC context the event belongs to.
 	 * \param original_id The starting ID for this event.
 	 * \param origin The original event the new event is spawned off.
+	 *               The new event inherits the data attached to it.
 	 * \return A smart pointer to the newly created event.
 	 */
 	static pointer create(slirc::irc &irc, const event_id &original_id, pointer origin);
@@ -72,6 +79,13 @@ public:
 	 * \param new_event_id The original ID for the new event.
 	 * \return A smart pointer to a new event with the current and original ID
 	 *         set to \c new_event_id and \c origin set to <tt>*this</tt>.
+	 *
+	 * The new event inherits the data attached to this event: components not
+	 * attached to the new event itself are read from this event, and are only
+	 * copied into the new event when accessed for modification, e.g. through
+	 * <tt>data.at\<T\>()</tt> with a non-const \c T. Use
+	 * <tt>data.at\<const T\>()</tt> to read inherited components without
+	 * copying them.
 	 */
 	pointer spawn(const event_id &new_event_id) {
 		return create(irc, new_event_id, shared_from_this());
@@ -80,18 +94,77 @@ public:
 
 
 	/**
-	 * \brief Posts this event to the front of the IRC contexts event queue.
+	 * \brief Posts this event to the front of the IRC contexts default event lane.
 	 */
 	void post_front();
 
 	/**
-	 * \brief Posts this event to the front of the IRC contexts event queue.
+	 * \brief Posts this event to the front of one of the IRC contexts event lanes.
+	 * \param lane The event lane to post the event to.
+	 * \throw std::out_of_range if there is no such lane.
+	 */
+	void post_front(std::size_t lane);
+
+	/**
+	 * \brief Posts this event to the back of the IRC contexts default event lane.
 	 */
 	void post_back();
 
+	/**
+	 * \brief Posts this event to the back of one of the IRC contexts event lanes.
+	 * \param lane The event lane to post the event to.
+	 * \throw std::out_of_range if there is no such lane.
+	 */
+	void post_back(std::size_t lane);
+
+	/**
+	 * \brief Posts this event to the back of the IRC contexts default event lane once a deadline has passed.
+	 * \param deadline The point in time to post the event at.
+	 * \return A handle to cancel the timer with. See \c irc::cancel_timer().
+	 */
+	util::timer_handle post_at(std::chrono::steady_clock::time_point deadline);
+
+	/**
+	 * \brief Posts this event to the back of one of the IRC contexts event lanes once a deadline has passed.
+	 * \param deadline The point in time to post the event at.
+	 * \param lane The event lane to post the event to.
+	 * \return A handle to cancel the timer with. See \c irc::cancel_timer().
+	 * \throw std::out_of_range if there is no such lane.
+	 */
+	util::timer_handle post_at(std::chrono::steady_clock::time_point deadline, std::size_t lane);
+
+	/**
+	 * \brief Posts this event to the back of the IRC contexts default event lane after a delay.
+	 * \param delay The time to wait before posting the event.
+	 * \return A handle to cancel the timer with. See \c irc::cancel_timer().
+	 */
+	template<typename Rep, typename Period>
+	util::timer_handle post_after(std::chrono::duration<Rep, Period> delay) {
+		return post_at(
+			std::chrono::steady_clock::now()
+			+ std::chrono::ceil<std::chrono::steady_clock::duration>(delay)
+		);
+	}
+
+	/**
+	 * \brief Posts this event to the back of one of the IRC contexts event lanes after a delay.
+	 * \param delay The time to wait before posting the event.
+	 * \param lane The event lane to post the event to.
+	 * \return A handle to cancel the timer with. See \c irc::cancel_timer().
+	 * \throw std::out_of_range if there is no such lane.
+	 */
+	template<typename Rep, typename Period>
+	util::timer_handle post_after(std::chrono::duration<Rep, Period> delay, std::size_t lane) {
+		return post_at(
+			std::chrono::steady_clock::now()
+			+ std::chrono::ceil<std::chrono::steady_clock::duration>(delay),
+			lane
+		);
+	}
+
 
 
-	using underlying_type = std::vector<event_id>; ///< @brief Container type of the event_id queue
+	using underlying_type = event_pool::id_queue_type; ///< @brief Container type of the event_id queue
 	using value_type = event_id; ///< @brief Value type of the event_id queue
 	using reference = value_type &; ///< @brief Reference type of the event_id queue
 	using const_reference = const value_type &; ///< @brief Constant reference type of the event_id queue
@@ -255,7 +328,7 @@ public:
 	 * \return The number of queued items
 	 */
 	underlying_type::size_type size() const {
-		return id_queue.size() + next_id_queue.size() - skipped;
+		return id_queue.size();
 	}
 
 	/**
@@ -265,7 +338,7 @@ public:
 	 *     - \c true if the queue is empty
 	 */
 	bool empty() const {
-		return id_queue.size() == skipped && next_id_queue.empty();
+		return id_queue.empty();
 	}
 
 	const pointer origin; ///< The original event this event is spawned off
@@ -275,13 +348,45 @@ public:
 
 	slirc::irc &irc; ///< The IRC context this event is associated with.
 
-	util::component_map data; ///< The data attached to the event.
+	util::component_map data; ///< The data attached to the event, inheriting the data attached to \c origin.
+
+	/**
+	 * \brief Checks which event handler is currently handling the event.
+	 * \return The connection of the event handler currently being called for
+	 *         this event, or a connection not referring to any event handler
+	 *         if the event is not being emitted.
+	 */
+	const slirc::irc::connection_type &current_connection() const noexcept;
+
+	/**
+	 * \brief Checks whether and as what the event is traced.
+	 * \return The trace id of the event, or \c 0 if the event is not traced.
+	 * \sa irc::set_event_tracing()
+	 */
+	std::uint64_t trace_id() const noexcept {
+		return trace_id_;
+	}
 
 private:
-	mutable underlying_type next_id_queue;
-	mutable underlying_type id_queue;
-	mutable underlying_type::size_type skipped;
+	friend class slirc::irc;
+
+	event(const private_construction_tag &, slirc::irc &, const event_id &, pointer, event_pool &, event_pool::containers &&);
+
+	void emit_traced();
+
+	event_pool &pool_;
+	underlying_type id_queue;
 	value_type current_id_;
+	const slirc::irc::connection_type *current_connection_;
+	const std::uint64_t trace_id_;
+	std::uint64_t queue_order_; // when it was queued last, see irc::event_queue_order_
+
+	void trace(event_trace::phase what) const noexcept {
+		if (trace_id_) {
+			const auto timestamp = event_trace::now();
+			event_trace::add({ &irc, trace_id_, 0, original_id.index(), what, timestamp, timestamp });
+		}
+	}
 };
 
 }
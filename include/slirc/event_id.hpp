@@ -27,31 +27,41 @@
 #ifndef LIBSLIRC_EVENT_ID_HPP
 #define LIBSLIRC_EVENT_ID_HPP
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <tuple>
 #include <typeindex>
 
 namespace slirc {
 
+/**
+ * \brief Identifies an event as a pair of an enum type and one of its values.
+ *
+ * Every distinct event id is interned into a dense index on construction, so
+ * that comparing and hashing event ids as well as looking up event handlers
+ * does not need to look at the enum type. Indices start at \c 0, which is the
+ * index of the default constructed event id, and are never reused.
+ */
 struct event_id
 : std::tuple<std::type_index, unsigned> {
 	using enum_type = unsigned;
-	using std::tuple<std::type_index, enum_type>::tuple;
+	using index_type = std::uint32_t; ///< @brief Type of dense event id indices
 
 	/// @brief Hash type for event_id
 	struct hash {
-		std::size_t operator()(const event_id &value) const {
-			return
-				std::hash<std::type_index>{}(std::get<0>(value))
-				^ std::hash<unsigned>{}(std::get<1>(value));
+		std::size_t operator()(const event_id &value) const noexcept {
+			return value.index();
 		}
 	};
 
-	constexpr event_id()
+	event_id() noexcept
 	: std::tuple<std::type_index, enum_type>{
 		typeid(none_t),
 		static_cast<enum_type>(none_t::NONE)
-	} {}
+	}
+	, index_(0) {}
 
 	template<
 		typename Enum,
@@ -59,11 +69,12 @@ struct event_id
 			std::is_enum_v<std::decay_t<Enum>>
 		>* = nullptr
 	>
-	constexpr event_id(Enum id)
+	event_id(Enum id)
 	: std::tuple<std::type_index, enum_type>{
 		typeid(std::decay_t<Enum>),
 		static_cast<enum_type>(id)
-	} {
+	}
+	, index_(intern_cached<std::decay_t<Enum>>(static_cast<enum_type>(id))) {
 		static_assert(
 			std::is_same_v<
 				std::underlying_type_t<std::decay_t<Enum>>,
@@ -74,20 +85,68 @@ struct event_id
 		);
 	}
 
-	constexpr bool operator==(const event_id &other) const {
-		return
-			static_cast<const std::tuple<std::type_index, enum_type> &>(*this)
-			== static_cast<const std::tuple<std::type_index, enum_type> &>(other);
+	/**
+	 * \brief Creates an event id from an enum type determined at runtime.
+	 * \param type The enum type.
+	 * \param value The value of the enum.
+	 */
+	event_id(std::type_index type, enum_type value)
+	: std::tuple<std::type_index, enum_type>{ type, value }
+	, index_(intern(type, value)) {}
+
+	/**
+	 * \brief Checks the dense index of the event id.
+	 * \return The index, which is below \c registered_count().
+	 */
+	index_type index() const noexcept {
+		return index_;
+	}
+
+	/**
+	 * \brief Checks the number of distinct event ids created so far.
+	 * \return One more than the highest index handed out so far.
+	 */
+	static std::size_t registered_count() noexcept;
+
+	/**
+	 * \brief Looks up the event id with a given dense index.
+	 * \param index The index to look up.
+	 * \return The event id whose \c index() is \c index.
+	 * \throw std::out_of_range if no event id has this index.
+	 */
+	static event_id from_index(index_type index);
+
+	bool operator==(const event_id &other) const noexcept {
+		return index_ == other.index_;
 	}
 
-	constexpr bool operator!=(const event_id &other) const {
-		return
-			static_cast<const std::tuple<std::type_index, enum_type> &>(*this)
-			!= static_cast<const std::tuple<std::type_index, enum_type> &>(other);
+	bool operator!=(const event_id &other) const noexcept {
+		return index_ != other.index_;
 	}
 
 private:
 	enum class none_t: enum_type { NONE };
+
+	static index_type intern(std::type_index type, enum_type value);
+
+	template<typename Enum>
+	static index_type intern_cached(enum_type value) {
+		// Small enum values are looked up in the global registry only once.
+		// The cache stores index + 1, so 0 means unknown.
+		static std::array<std::atomic<index_type>, 64> cache{};
+		if (value >= cache.size()) {
+			return intern(typeid(Enum), value);
+		}
+
+		if (const index_type cached = cache[value].load(std::memory_order_relaxed)) {
+			return cached - 1;
+		}
+		const index_type index = intern(typeid(Enum), value);
+		cache[value].store(index + 1, std::memory_order_relaxed);
+		return index;
+	}
+
+	index_type index_;
 };
 
 }
@@ -0,0 +1,170 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_EVENT_POOL_HPP
+#define LIBSLIRC_EVENT_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "event_id.hpp"
+#include "util/component_map.hpp"
+#include "util/small_ring.hpp"
+
+namespace slirc {
+
+/**
+ * \brief Recycles the memory and containers of the events of an IRC context.
+ *
+ * Every event created by \c event::create() (and thus by \c irc::make_event()
+ * and \c event::spawn()) is allocated from the pool of its IRC context. When
+ * the last \c std::shared_ptr to an event is gone, the pool keeps the memory
+ * block of the event and its (cleared) event id queues and data for the next
+ * event, so their capacity does not have to be allocated again.
+ *
+ * The pool keeps up to \c capacity() memory blocks and container sets. Events
+ * keep the pool alive, so they may outlive the IRC context's pool reference.
+ */
+class event_pool {
+public:
+	/// \brief Usage statistics of an event pool.
+	struct statistics {
+		std::size_t created; ///< @brief Number of events created from the pool
+		std::size_t recycled_memory; ///< @brief Number of events placed in recycled memory blocks
+		std::size_t recycled_containers; ///< @brief Number of events reusing recycled event id queues and data
+
+		/**
+		 * \brief Calculates the share of events placed in recycled memory blocks.
+		 * \return A value between \c 0 and \c 1.
+		 */
+		double hit_rate() const noexcept {
+			return created ? static_cast<double>(recycled_memory) / created : 0.0;
+		}
+	};
+
+	using id_queue_type = util::small_ring<event_id, 4>; ///< @brief Type of the event id queue of events
+
+	/// \brief Internal use only
+	struct containers {
+		id_queue_type id_queue;
+		util::component_map data;
+	};
+
+	/// \brief Allocator handing out the memory blocks of an event pool.
+	template<typename T>
+	class allocator {
+	public:
+		using value_type = T;
+
+		explicit allocator(std::shared_ptr<event_pool> pool) noexcept
+		: pool_(std::move(pool)) {}
+
+		template<typename U>
+		allocator(const allocator<U> &other) noexcept
+		: pool_(other.pool_) {}
+
+		T *allocate(std::size_t n) {
+			return static_cast<T*>(pool_->allocate(n * sizeof(T)));
+		}
+
+		void deallocate(T *block, std::size_t n) noexcept {
+			pool_->deallocate(block, n * sizeof(T));
+		}
+
+		template<typename U>
+		bool operator==(const allocator<U> &other) const noexcept {
+			return pool_ == other.pool_;
+		}
+
+		template<typename U>
+		bool operator!=(const allocator<U> &other) const noexcept {
+			return pool_ != other.pool_;
+		}
+
+	private:
+		template<typename U>
+		friend class allocator;
+
+		std::shared_ptr<event_pool> pool_;
+	};
+
+	static constexpr std::size_t default_capacity = 1024; ///< @brief Capacity of newly created pools
+
+	/**
+	 * \brief Creates an empty event pool.
+	 * \param capacity The maximum number of memory blocks and container sets to keep.
+	 */
+	explicit event_pool(std::size_t capacity = default_capacity);
+	event_pool(const event_pool &) = delete;
+	event_pool &operator=(const event_pool &) = delete;
+	~event_pool();
+
+	/**
+	 * \brief Checks how many memory blocks and container sets the pool keeps at most.
+	 * \return The capacity of the pool.
+	 */
+	std::size_t capacity() const;
+
+	/**
+	 * \brief Changes how many memory blocks and container sets the pool keeps at most.
+	 * \param capacity The new capacity of the pool. Memory blocks and container
+	 *                 sets exceeding it are released immediately. A capacity
+	 *                 of \c 0 disables recycling.
+	 */
+	void set_capacity(std::size_t capacity);
+
+	/**
+	 * \brief Takes a snapshot of the pools usage statistics.
+	 * \return The number of events created and how many of them were recycled.
+	 */
+	statistics stats() const;
+
+	/// \brief Internal use only
+	containers acquire_containers();
+
+	/// \brief Internal use only
+	void release_containers(containers &&released) noexcept;
+
+	/// \brief Internal use only
+	void *allocate(std::size_t size);
+
+	/// \brief Internal use only
+	void deallocate(void *block, std::size_t size) noexcept;
+
+private:
+	mutable std::mutex mutex_;
+		std::size_t capacity_;
+		std::size_t block_size_; // blocks of other sizes are not recycled
+		std::vector<void *> blocks_;
+		std::vector<containers> containers_;
+		statistics statistics_;
+};
+
+}
+
+#endif //LIBSLIRC_EVENT_POOL_HPP
@@ -0,0 +1,184 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_EVENT_RECORDING_HPP
+#define LIBSLIRC_EVENT_RECORDING_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "event_id.hpp"
+
+namespace slirc {
+
+class irc;
+
+/**
+ * \brief Records the events posted to an IRC context into a binary log.
+ *
+ * For every event posted to the front or back of an event lane, the recorder
+ * writes the time since the start of the recording, the event lane, the
+ * original and the queued event ids and, for events carrying an
+ * <tt>apis::connection::raw_message</tt>, the received line. Events spawned
+ * off other events are not recorded, as replaying the events they were
+ * spawned off recreates them.
+ *
+ * Recordings are played back by \c event_replay. Event ids are stored by the
+ * (implementation defined) name of their enum type, so recordings should be
+ * replayed by a program built with the same compiler.
+ */
+class event_recorder {
+public:
+	/**
+	 * \brief Starts recording the events posted to an IRC context.
+	 * \param irc The IRC context to record.
+	 * \param out The stream to write the log to. Must be opened in binary
+	 *            mode and stay valid until the recording is stopped.
+	 * \throw std::logic_error if the IRC context already has a post observer.
+	 */
+	event_recorder(slirc::irc &irc, std::ostream &out);
+	event_recorder(const event_recorder &) = delete;
+	event_recorder &operator=(const event_recorder &) = delete;
+
+	/**
+	 * \brief Stops recording.
+	 */
+	~event_recorder();
+
+	/**
+	 * \brief Stops recording and flushes the stream.
+	 * \post No more events are written, even by posts in progress.
+	 */
+	void stop();
+
+	/**
+	 * \brief Checks the number of recorded events.
+	 * \return The number of events written to the log.
+	 */
+	std::size_t recorded() const;
+
+private:
+	struct state;
+
+	slirc::irc &irc_;
+	std::shared_ptr<state> state_;
+};
+
+/**
+ * \brief Plays back a log written by \c event_recorder.
+ *
+ * Replaying creates a new event for every recorded event and posts it to the
+ * same event lane of the target IRC context, either at the recorded pace,
+ * faster by some factor or as fast as possible. Fetching and emitting the
+ * events is left to the usual consumers of the target context, so the whole
+ * event pipeline is exercised.
+ */
+class event_replay {
+public:
+	/// \brief Results of a replay.
+	struct statistics {
+		std::size_t posted; ///< @brief Number of events posted
+		std::size_t skipped; ///< @brief Number of events skipped because their event ids are unknown
+		std::chrono::nanoseconds elapsed; ///< @brief Time taken to post all events
+		std::chrono::nanoseconds max_lag; ///< @brief Largest delay of a post behind its schedule
+	};
+
+	/**
+	 * \brief Reads a recording.
+	 * \param in The stream to read the log from, opened in binary mode.
+	 * \throw std::invalid_argument if the stream does not contain a complete
+	 *        recording.
+	 */
+	explicit event_replay(std::istream &in);
+
+	/**
+	 * \brief Makes the event ids of an enum type known to the replay.
+	 *
+	 * Event ids whose enum type has been used in this program before the
+	 * replay starts, e.g. to connect an event handler, are known without
+	 * registering them.
+	 *
+	 * \tparam Enum The enum type.
+	 */
+	template<typename Enum>
+	void register_enum() {
+		types_.insert_or_assign(typeid(Enum).name(), std::type_index(typeid(Enum)));
+	}
+
+	/**
+	 * \brief Checks the number of recorded events.
+	 * \return The number of events in the recording.
+	 */
+	std::size_t size() const noexcept {
+		return records_.size();
+	}
+
+	/**
+	 * \brief Checks the duration of the recording.
+	 * \return The time between the start of the recording and its last event.
+	 */
+	std::chrono::nanoseconds duration() const noexcept;
+
+	/**
+	 * \brief Posts the recorded events to an IRC context.
+	 * \param irc The IRC context to post the events to.
+	 * \param speed The factor to speed up the recorded pace by. \c 1 replays
+	 *              at the original pace, \c 0 as fast as possible.
+	 * \return Statistics about the replay.
+	 * \throw std::out_of_range if a recorded event lane does not exist.
+	 */
+	statistics replay(slirc::irc &irc, double speed = 1.0) const;
+
+private:
+	struct id_definition {
+		std::string type;
+		event_id::enum_type value;
+	};
+
+	struct record {
+		std::chrono::nanoseconds time;
+		std::vector<std::uint32_t> ids;
+		std::size_t lane;
+		bool front;
+		bool has_line;
+		std::string line;
+	};
+
+	std::vector<id_definition> ids_;
+	std::vector<record> records_;
+	std::unordered_map<std::string, std::type_index> types_;
+};
+
+}
+
+#endif //LIBSLIRC_EVENT_RECORDING_HPP
@@ -0,0 +1,109 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_EVENT_TRACE_HPP
+#define LIBSLIRC_EVENT_TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+#include "event_id.hpp"
+
+namespace slirc {
+
+/**
+ * \brief Records the lifecycle of sampled events.
+ *
+ * Records are written to a fixed size ring buffer owned by the recording
+ * thread, so recording never takes a lock and never waits for other threads.
+ * Once a buffer is full, its oldest records are overwritten. Buffers are kept
+ * after their thread exits, so their records can still be exported.
+ *
+ * Tracing is enabled per IRC context by \c irc::set_event_tracing(), which
+ * also selects the share of events to trace.
+ */
+class event_trace {
+public:
+	/// \brief The step in the lifecycle of an event a record stands for.
+	enum class phase: std::uint8_t {
+		created,      ///< The event was created (or spawned)
+		posted_front, ///< The event was posted to the front of an event lane
+		posted_back,  ///< The event was posted to the back of an event lane
+		fetched,      ///< The event was taken from the event queue
+		emitted,      ///< The event was emitted for one event id
+		destroyed     ///< The last reference to the event was released
+	};
+
+	/// \brief A single trace record.
+	struct record {
+		const void *context; ///< @brief The IRC context of the event
+		std::uint64_t trace_id; ///< @brief Identifies the traced event
+		std::uint64_t origin_trace_id; ///< @brief Trace id of the origin of spawned events, or \c 0
+		event_id::index_type id; ///< @brief The original id, or the emitted id for \c phase::emitted
+		phase what; ///< @brief The recorded lifecycle step
+		std::int64_t start; ///< @brief Time of the step, see \c now()
+		std::int64_t end; ///< @brief End of the step for \c phase::emitted, else equal to \c start
+	};
+
+	static constexpr std::size_t records_per_thread = 8192; ///< @brief Capacity of each threads buffer
+
+	/**
+	 * \brief Reads the clock used for trace records.
+	 * \return Nanoseconds of <tt>std::chrono::steady_clock</tt>.
+	 */
+	static std::int64_t now() noexcept;
+
+	/**
+	 * \brief Hands out a new trace id.
+	 * \return A trace id, never \c 0.
+	 */
+	static std::uint64_t next_trace_id() noexcept;
+
+	/**
+	 * \brief Adds a record to the calling threads buffer.
+	 * \param value The record to add.
+	 */
+	static void add(const record &value) noexcept;
+
+	/**
+	 * \brief Writes the records of an IRC context as Chrome trace event JSON.
+	 *
+	 * The output can be loaded into \c chrome://tracing and into Perfetto.
+	 * Each traced event becomes an asynchronous slice from its creation to its
+	 * destruction, with posting and fetching as instant events and origins of
+	 * spawned events as arguments. Each emit is a complete event on the thread
+	 * it ran on. Records being overwritten during the export are skipped.
+	 *
+	 * \param out The stream to write to.
+	 * \param context The IRC context to export the records of.
+	 */
+	static void write_chrome_json(std::ostream &out, const void *context);
+};
+
+}
+
+#endif //LIBSLIRC_EVENT_TRACE_HPP
@@ -27,22 +27,36 @@
 #ifndef LIBSLIRC_IRC_HPP
 #define LIBSLIRC_IRC_HPP
 
+#include <cassert>
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
+#include <iosfwd>
 #include <memory>
 #include <mutex>
+#include <iterator>
+#include <string>
 #include <typeindex>
 #include <unordered_map>
 #include <variant>
 
-#include <boost/signals2.hpp>
-
 #include "event_id.hpp"
+#include "event_pool.hpp"
+#include "event_trace.hpp"
 #include "module.hpp"
+#include "util/component_map.hpp"
+#include "util/latency_histogram.hpp"
+#include "util/mpsc_stack.hpp"
+#include "util/rcu_ptr.hpp"
+#include "util/timer_wheel.hpp"
 
 namespace slirc {
 
 class event;
+class scheduler;
 
 /**
  * \brief An IRC context.
@@ -60,6 +74,14 @@ class event;
  */
 class irc {
 public:
+	/// \brief Events emitted by the IRC context itself.
+	enum events: event_id::enum_type {
+		/// \brief The event queue depth reached the high watermark.
+		on_event_queue_high_watermark,
+		/// \brief The event queue depth fell back to the low watermark.
+		on_event_queue_low_watermark
+	};
+
 	/**
 	 * \brief Creates an empty IRC context.
 	 */
@@ -87,14 +109,14 @@ public:
 	detail::module_base *module(const std::type_index &slirc_module_type) noexcept {
 		const auto it = modules_.find(slirc_module_type);
 		return it != modules_.end()
-			? it->second
+			? it->second.get()
 			: nullptr;
 	}
 
 	const detail::module_base *module(const std::type_index &slirc_module_type) const noexcept {
 		const auto it = modules_.find(slirc_module_type);
 		return it != modules_.end()
-			? it->second
+			? it->second.get()
 			: nullptr;
 	}
 
@@ -135,14 +157,23 @@ public:
 	template<typename Module, typename... Args>
 	Module &load_module(Args&&... module_args) {
 		using EffectiveModule = effective_module_implementation<Module>;
-		auto &modptr = modules_[typeid(typename Module::slirc_module_type)];
-		if (modptr) {
-			delete modptr;
-			modptr = nullptr;
-		}
-		Module *real_modptr = new EffectiveModule(*this, std::forward<Args>(module_args)...);
-		modptr = real_modptr;
-		return *real_modptr;
+		const std::type_index type = typeid(typename Module::slirc_module_type);
+		unload_module(type);
+
+		// Shared with the static dispatchers, so a module unloaded by one of
+		// its own static handlers lives until the emit dispatching it is done.
+		const auto modptr = std::make_shared<EffectiveModule>(*this, std::forward<Args>(module_args)...);
+		if constexpr (has_static_handlers<EffectiveModule>::value) {
+			add_static_handlers(modptr, typename EffectiveModule::slirc_static_handlers{});
+		}
+		try {
+			modules_[type] = modptr;
+		}
+		catch(...) {
+			remove_static_handlers(*modptr);
+			throw;
+		}
+		return *modptr;
 	};
 
 	bool unload_module(const std::type_index &type) {
@@ -150,9 +181,9 @@ public:
 			const auto it = modules_.find(type);
 			it != modules_.end()
 		) {
-			const auto modptr = it->second;
+			const auto modptr = std::move(it->second);
 			modules_.erase(it);
-			delete modptr;
+			remove_static_handlers(*modptr);
 			return true;
 		}
 		else {
@@ -165,11 +196,11 @@ public:
 		if (
 			const auto it = modules_.find(typeid(typename Module::slirc_module_type));
 			it != modules_.end()
-			&& dynamic_cast<Module*>(it->second) != nullptr
+			&& dynamic_cast<Module*>(it->second.get()) != nullptr
 		) {
-			const auto modptr = it->second;
+			const auto modptr = std::move(it->second);
 			modules_.erase(it);
-			delete modptr;
+			remove_static_handlers(*modptr);
 			return true;
 		}
 		else {
@@ -180,25 +211,125 @@ public:
 
 
 	using event_handler_signature = void(event&);
-	using signal_type = boost::signals2::signal<event_handler_signature>;
-	using connection_type = boost::signals2::connection;
+	using group_type = int; ///< @brief Type of event handler groups
+
+private:
+	struct handler_entry;
+	struct handler_registry;
+
+public:
+	/**
+	 * \brief Refers to an event handler connected by \c connect().
+	 *
+	 * Connections are cheap to copy. All copies refer to the same event
+	 * handler. They stay valid after the event handler was disconnected and
+	 * even after the IRC context was destructed.
+	 */
+	class connection_type {
+	public:
+		/**
+		 * \brief Creates a connection not referring to any event handler.
+		 */
+		connection_type() noexcept = default;
+
+		/**
+		 * \brief Checks whether the event handler is still connected.
+		 * \return
+		 *     - \c false if the event handler has been disconnected,
+		 *     - \c true if the event handler is connected
+		 */
+		bool connected() const noexcept;
+
+		/**
+		 * \brief Disconnects the event handler.
+		 *
+		 * Emits that are already in progress skip the event handler if they
+		 * did not call it yet. Event handlers may disconnect themselves or
+		 * other event handlers while being called.
+		 */
+		void disconnect() const;
+
+		bool operator==(const connection_type &other) const noexcept {
+			return !entry_.owner_before(other.entry_) && !other.entry_.owner_before(entry_);
+		}
+
+		bool operator!=(const connection_type &other) const noexcept {
+			return !(*this == other);
+		}
+
+	private:
+		friend class irc;
+		explicit connection_type(std::weak_ptr<handler_entry> entry) noexcept
+		: entry_(std::move(entry)) {}
+
+		std::weak_ptr<handler_entry> entry_;
+	};
+
+	/**
+	 * \brief A connection that disconnects its event handler when destructed.
+	 */
+	class scoped_connection
+	: public connection_type {
+	public:
+		scoped_connection() noexcept = default;
+
+		scoped_connection(const connection_type &connection) noexcept
+		: connection_type(connection) {}
+
+		scoped_connection(const scoped_connection &) = delete;
+		scoped_connection &operator=(const scoped_connection &) = delete;
+
+		scoped_connection(scoped_connection &&) noexcept = default;
+		scoped_connection &operator=(scoped_connection &&other) {
+			if (this != &other) {
+				disconnect();
+				connection_type::operator=(std::move(other));
+				static_cast<connection_type &>(other) = connection_type();
+			}
+			return *this;
+		}
+
+		~scoped_connection() {
+			disconnect();
+		}
+
+		/**
+		 * \brief Stops managing the event handler without disconnecting it.
+		 * \return The connection to the event handler.
+		 */
+		connection_type release() noexcept {
+			connection_type retval(std::move(static_cast<connection_type &>(*this)));
+			static_cast<connection_type &>(*this) = connection_type();
+			return retval;
+		}
+	};
 
 	enum connect_position {
-		at_back = boost::signals2::connect_position::at_back,
-		at_front = boost::signals2::connect_position::at_front
+		at_back,
+		at_front
 	};
 
 	struct slot_group
-	: std::variant<signal_type::group_type, connect_position> {
-		slot_group(signal_type::group_type value = 0)
-		: std::variant<signal_type::group_type, connect_position>(value) {}
+	: std::variant<group_type, connect_position> {
+		slot_group(group_type value = 0)
+		: std::variant<group_type, connect_position>(value) {}
 
 		slot_group(connect_position value)
-		: std::variant<signal_type::group_type, connect_position>(value) {}
+		: std::variant<group_type, connect_position>(value) {}
 	};
 
 	/**
 	 * \brief Connects an event handler to an event.
+	 *
+	 * Event handlers for an event are called in the following order:
+	 *  -# ungrouped event handlers connected \c at_front
+	 *  -# grouped event handlers, by ascending group
+	 *  -# ungrouped event handlers connected \c at_back
+	 *
+	 * Emitting an event does not take any locks. Connecting and disconnecting
+	 * event handlers publishes a modified copy of the event handler table
+	 * instead, so it is considerably more expensive than emitting events.
+	 *
 	 * \tparam Func The event handlers function signature; must be callable as
 	 *              <tt>f(event &, connection_type)</tt> or <tt>f(event &)</tt>.
 	 *              If either is possible, the former form is chosen.
@@ -206,7 +337,8 @@ public:
 	 * \param f The event handler to connect to the event. Will be called with
 	 *          a events matching the given event_id, and also the connection
 	 *          returned from this function, if the event handler accepts a
-	 *          second parameter.
+	 *          second parameter. The connection is also available through
+	 *          \c event::current_connection() while the handler runs.
 	 * \param group Which group to add the event handler to.
 	 * \param position Whether to add the event handler at the front or the back
 	 *                 of the given group. If \c group is either \c at_back or
@@ -216,42 +348,99 @@ public:
 	 */
 	template<typename Func>
 	connection_type connect(const event_id &id, Func &&f, slot_group group = at_back, connect_position position = at_back) {
-		signal_type *signal;
-		{ std::lock_guard<std::mutex> lock(signals_mutex_);
-			signal = &signals_[id];
-		}
+		return connect_handler(id, make_handler_callback(std::forward<Func>(f)), group, position, false);
+	}
 
-		const auto callback =
-			[f = std::forward<Func>(f)](event &ev, connection_type connection) {
-				event_scoped_connection esc(ev, connection);
-				if constexpr (is_callable_with_connection<Func>::value) {
-					f(ev, connection);
-				}
-				else {
-					static_assert(
-						is_callable_without_connection<Func>::value,
-						"passed function can neither be called with "
-						"(event_t&, connection_type) nor with (event&)"
-					);
-					f(ev);
-				}
-			};
+	/**
+	 * \brief Connects an event handler that may run concurrently with other event handlers.
+	 *
+	 * Works like \c connect(), but marks the event handler as safe to run
+	 * concurrently with other such event handlers, e.g. because it only
+	 * observes the event. When an event is emitted, each run of adjacent
+	 * concurrent event handlers (according to the usual order of event
+	 * handlers) is executed in parallel on a shared worker pool, with the
+	 * emitting thread taking part. Regular event handlers before and after
+	 * such a run are called once all event handlers of the run returned, so
+	 * \c emit_event() still only returns once all event handlers are done.
+	 *
+	 * Concurrent event handlers only get a const view of the event, so they
+	 * can not modify it, and must not rely on \c event::current_connection();
+	 * accept the connection as second parameter instead. As several events
+	 * may be emitted at once, they must also be safe to call concurrently with
+	 * themselves. If any of them throws, one of the exceptions is rethrown
+	 * after all event handlers of the run returned.
+	 *
+	 * \tparam Func The event handlers function signature; must be callable as
+	 *              <tt>f(const event &, connection_type)</tt> or
+	 *              <tt>f(const event &)</tt> through a const reference.
+	 * \param id The event id to connect the handler to.
+	 * \param f The event handler to connect to the event.
+	 * \param group Which group to add the event handler to.
+	 * \param position Whether to add the event handler at the front or the back
+	 *                 of the given group.
+	 * \return A connection
+	 */
+	template<typename Func>
+	connection_type connect_concurrent(const event_id &id, Func &&f, slot_group group = at_back, connect_position position = at_back) {
+		return connect_handler(id, make_handler_callback<const event>(std::forward<Func>(f)), group, position, true);
+	}
 
-		if (group.index() == 0) {
-			// grouped slot
-			return signal->connect_extended(
-				static_cast<boost::signals2::connect_position>(std::get<0>(group)),
-				callback,
-				static_cast<boost::signals2::connect_position>(position)
-			);
-		}
-		else {
-			// ungrouped slot
-			return signal->connect_extended(
-				callback,
-				static_cast<boost::signals2::connect_position>(std::get<1>(group))
-			);
-		}
+	/**
+	 * \brief Routing key of an event, see \c connect_routed().
+	 *
+	 * Emitters attach routing keys to the events data, e.g.:
+	 *
+	 * \code
+	 * ev->data.insert(slirc::irc::route_key<slirc::apis::connection::message_target>{ "#channel" });
+	 * \endcode
+	 *
+	 * \tparam Tag Names the kind of routing key. Tags need not be complete.
+	 */
+	template<typename Tag>
+	struct route_key {
+		std::string value; ///< @brief The key, compared exactly
+	};
+
+	/**
+	 * \brief Connects an event handler to an event carrying a specific routing key.
+	 *
+	 * Works like \c connect(), but the event handler is only called for events
+	 * carrying a <tt>route_key\<Tag\></tt> equal to \c key. Event handlers
+	 * routed by the same kind of key are kept in a hash index per event id,
+	 * so emitting an event only costs one lookup per kind of key instead of
+	 * one call per routed event handler, no matter how many other keys have
+	 * event handlers connected.
+	 *
+	 * For each event, the event handlers connected by \c connect() and
+	 * \c connect_concurrent() are called first, followed by the routed event
+	 * handlers, by kind of key in the order the kinds were first connected
+	 * to the event id. Within one key, \c group and \c position apply as
+	 * usual.
+	 *
+	 * \tparam Tag The kind of routing key.
+	 * \tparam Func See \c connect().
+	 * \param id The event id to connect the handler to.
+	 * \param key The routing key the event handler is interested in.
+	 * \param f The event handler to connect to the event.
+	 * \param group Which group to add the event handler to.
+	 * \param position Whether to add the event handler at the front or the back
+	 *                 of the given group.
+	 * \return A connection
+	 */
+	template<typename Tag, typename Func>
+	connection_type connect_routed(const event_id &id, std::string key, Func &&f, slot_group group = at_back, connect_position position = at_back) {
+		return connect_routed_handler(
+			id,
+			typeid(route_key<Tag>),
+			[](const util::component_map &data) -> const std::string * {
+				const auto route = data.find<route_key<Tag>>();
+				return route ? &route->value : nullptr;
+			},
+			std::move(key),
+			make_handler_callback(std::forward<Func>(f)),
+			group,
+			position
+		);
 	}
 
 
@@ -263,6 +452,27 @@ public:
 	 */
 	std::shared_ptr<event> make_event(const event_id &id);
 
+	/**
+	 * \brief Checks the usage of the IRC contexts event pool.
+	 * \return How many events were created and how many of them were
+	 *         placed in recycled memory or reused recycled containers.
+	 * \sa event_pool
+	 */
+	event_pool::statistics event_pool_statistics() const;
+
+	/**
+	 * \brief Checks how many released events the IRC contexts event pool keeps at most.
+	 * \return The capacity of the event pool.
+	 */
+	std::size_t event_pool_capacity() const;
+
+	/**
+	 * \brief Changes how many released events the IRC contexts event pool keeps at most.
+	 * \param capacity The new capacity of the event pool. A capacity of \c 0
+	 *                 disables recycling events.
+	 */
+	void set_event_pool_capacity(std::size_t capacity);
+
 	/**
 	 * \brief Fetches an event from the event queue.
 	 * Blocks until an event becomes available, the timeout is exceeded or the
@@ -274,20 +484,667 @@ public:
 	std::shared_ptr<event> fetch_event(std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
 
 	/**
-	 * \brief Posts an event to the back of the event queue.
+	 * \brief Fetches multiple events from the event queue at once.
+	 * Blocks until at least one event becomes available, the timeout is
+	 * exceeded or the destructor is called. Then fetches as many events as are
+	 * available, up to \c max_events, in the same order repeated calls to
+	 * \c fetch_event() would have returned them.
+	 * \tparam OutputIterator An output iterator accepting
+	 *                        <tt>std::shared_ptr\<event\></tt>.
+	 * \param out Where to store the fetched events.
+	 * \param max_events Maximum number of events to fetch.
+	 * \param timeout Maximum time to wait for the first event.
+	 * \return The number of events written to \c out. This is \c 0 if the
+	 *         timeout has exceeded or the IRC context is destructed.
+	 */
+	template<typename OutputIterator>
+	std::size_t fetch_events(OutputIterator out, std::size_t max_events, std::chrono::milliseconds timeout = std::chrono::milliseconds::max()) {
+		return fetch_events_into(
+			max_events,
+			timeout,
+			[](void *out, std::shared_ptr<event> &&ev) {
+				OutputIterator &it = *static_cast<OutputIterator*>(out);
+				*it = std::move(ev);
+				++it;
+			},
+			&out
+		);
+	}
+
+	/// \brief Completion handler type of asynchronous operations.
+	using async_handler = std::function<void(std::shared_ptr<event>)>;
+
+	/**
+	 * \brief Fetches an event from the event queue asynchronously.
+	 *
+	 * Returns immediately. Once an event becomes available, it is fetched and
+	 * passed to \c handler, which is run on the io_service returned by
+	 * <tt>get_io_service(*this)</tt> at the time of this call. Expired timers
+	 * are picked up as well. The handler is never run from within this
+	 * function.
+	 *
+	 * \param handler The handler to pass the fetched event to. If the IRC
+	 *                context is destructed before an event becomes available,
+	 *                it is passed \c nullptr instead.
+	 * \throw std::logic_error if another asynchronous fetch is pending or if
+	 *        there is no active io_service.
+	 *
+	 * \warning While an asynchronous fetch is pending, events must not be
+	 *          fetched by other means.
+	 * \warning The IRC context must outlive the io_service handlers of a
+	 *          pending asynchronous fetch, e.g. by destructing it on the
+	 *          thread running the io_service.
+	 */
+	void async_fetch_event(async_handler handler);
+
+	/**
+	 * \brief Waits asynchronously for an event to be emitted with a given id.
+	 *
+	 * Returns immediately. The next time an event is emitted for \c id, it is
+	 * passed to \c handler, which is run on the io_service returned by
+	 * <tt>get_io_service(*this)</tt> at the time of this call. All event
+	 * handlers for \c id connected before this call will have seen the event
+	 * by then.
+	 *
+	 * \param id The event id to wait for.
+	 * \param handler The handler to pass the event to.
+	 * \return The connection of the internal event handler. Disconnect it to
+	 *         stop waiting; \c handler is not called in that case.
+	 * \throw std::logic_error if there is no active io_service.
+	 */
+	connection_type async_wait_for(const event_id &id, async_handler handler);
+
+	/**
+	 * \brief Posts an event to the back of the default event lane.
 	 * \param ev The event to add to the event queue.
 	 * \note ev must belong to the exact IRC context it is posted to. Prefer
 	 *          <tt>ev.post_back()</tt> instead.
 	 */
-	void post_event_back(event &ev);
+	void post_event_back(event &ev) {
+		post_event_back(ev, default_event_lane_);
+	}
 
 	/**
-	 * \brief Posts an event to the front of the event queue.
+	 * \brief Posts an event to the back of an event lane.
+	 * \param ev The event to add to the event queue.
+	 * \param lane The event lane to add the event to.
+	 * \throw std::out_of_range if there is no such lane.
+	 * \note ev must belong to the exact IRC context it is posted to. Prefer
+	 *          <tt>ev.post_back(lane)</tt> instead.
+	 */
+	void post_event_back(event &ev, std::size_t lane);
+
+	/**
+	 * \brief Posts an event to the front of the default event lane.
 	 * \param ev The event to add to the event queue.
 	 * \note ev must belong to the exact IRC context it is posted to. Prefer
 	 *          <tt>ev.post_front()</tt> instead.
 	 */
-	void post_event_front(event &ev);
+	void post_event_front(event &ev) {
+		post_event_front(ev, default_event_lane_);
+	}
+
+	/**
+	 * \brief Posts an event to the front of an event lane.
+	 * \param ev The event to add to the event queue.
+	 * \param lane The event lane to add the event to.
+	 * \throw std::out_of_range if there is no such lane.
+	 * \note ev must belong to the exact IRC context it is posted to. Prefer
+	 *          <tt>ev.post_front(lane)</tt> instead.
+	 */
+	void post_event_front(event &ev, std::size_t lane);
+
+	/**
+	 * \brief Observes events posted to the front or back of an event lane.
+	 * \param ev The posted event. Observers may attach data to it.
+	 * \param lane The event lane the event is posted to.
+	 * \param front Whether the event is posted to the front of the lane.
+	 */
+	using post_observer = std::function<void(event &ev, std::size_t lane, bool front)>;
+
+	/**
+	 * \brief Installs a function to be called for every posted event.
+	 *
+	 * The observer is called by the posting thread right before the event is
+	 * added to the event queue, so calls may happen concurrently. Events
+	 * posted by a timer are observed once it expired, by the thread fetching
+	 * events. Used by \c event_recorder.
+	 *
+	 * \param observer The observer to install, or an empty function to remove
+	 *                 the installed observer.
+	 * \return The previously installed observer.
+	 * \note Posts already in progress may still call the previous observer
+	 *       after this function returns.
+	 */
+	post_observer set_post_observer(post_observer observer);
+
+	/**
+	 * \brief Posts a range of events to the back of the default event lane.
+	 * The events are enqueued at once, in the order given.
+	 * \tparam ForwardIterator A forward iterator over <tt>std::shared_ptr\<event\></tt>.
+	 * \param first The begin of the range of events to post.
+	 * \param last The end of the range of events to post.
+	 * \note All events must belong to the exact IRC context they are posted to.
+	 */
+	template<typename ForwardIterator>
+	void post_events_back(ForwardIterator first, ForwardIterator last) {
+		post_events_back(first, last, default_event_lane_);
+	}
+
+	/**
+	 * \brief Posts a range of events to the back of an event lane.
+	 * The events are enqueued at once, in the order given.
+	 * \tparam ForwardIterator A forward iterator over <tt>std::shared_ptr\<event\></tt>.
+	 * \param first The begin of the range of events to post.
+	 * \param last The end of the range of events to post.
+	 * \param lane The event lane to add the events to.
+	 * \throw std::out_of_range if there is no such lane.
+	 * \note All events must belong to the exact IRC context they are posted to.
+	 */
+	template<typename ForwardIterator>
+	void post_events_back(ForwardIterator first, ForwardIterator last, std::size_t lane) {
+		if (!try_post_events_back(first, last, lane)) {
+			// does not fit as a whole; block per event
+			event_lane &target = *event_lanes_.at(lane);
+			if (has_post_observer_) {
+				for(ForwardIterator it = first; it != last; ++it) {
+					observe_post(**it, lane, false);
+				}
+			}
+			for(; first != last; ++first) {
+				enqueue_event_back(**first, target);
+			}
+		}
+	}
+
+	/**
+	 * \brief Posts a range of events to the back of the default event lane unless that blocks.
+	 * \sa <tt>try_post_events_back(ForwardIterator first, ForwardIterator last, std::size_t lane)</tt>
+	 */
+	template<typename ForwardIterator>
+	bool try_post_events_back(ForwardIterator first, ForwardIterator last) {
+		return try_post_events_back(first, last, default_event_lane_);
+	}
+
+	/**
+	 * \brief Posts a range of events to the back of an event lane unless that blocks.
+	 *
+	 * Works like \c post_events_back(), but if the events do not fit into
+	 * the event queue as a whole under \c overflow_policy::block, none of
+	 * them is posted instead of blocking. Lets threads that must not wait
+	 * for the thread fetching events, like network threads, keep the events
+	 * and retry later.
+	 *
+	 * \tparam ForwardIterator A forward iterator over <tt>std::shared_ptr\<event\></tt>.
+	 * \param first The begin of the range of events to post.
+	 * \param last The end of the range of events to post.
+	 * \param lane The event lane to add the events to.
+	 * \return \c false if the events were not posted because posting would
+	 *         block, \c true otherwise.
+	 * \throw std::out_of_range if there is no such lane.
+	 * \note All events must belong to the exact IRC context they are posted to.
+	 */
+	template<typename ForwardIterator>
+	bool try_post_events_back(ForwardIterator first, ForwardIterator last, std::size_t lane) {
+#ifndef NDEBUG
+		for(ForwardIterator it = first; it != last; ++it) {
+			assert(&((*it)->irc) == this && "Must post event to correct IRC context!");
+		}
+#endif
+
+		const std::size_t count = std::distance(first, last);
+		if (count == 0) {
+			return true;
+		}
+
+		event_lane &target = *event_lanes_.at(lane);
+		if (!try_reserve_event_queue_slots(count)) {
+			if (event_queue_overflow_policy_ == overflow_policy::block) {
+				return false;
+			}
+
+			// does not fit as a whole; apply the overflow policy per event
+			if (has_post_observer_) {
+				for(ForwardIterator it = first; it != last; ++it) {
+					observe_post(**it, lane, false);
+				}
+			}
+			for(; first != last; ++first) {
+				enqueue_event_back(**first, target);
+			}
+			return true;
+		}
+
+		enqueue_counted_events_back(first, last, count, lane, target);
+		return true;
+	}
+
+	/**
+	 * \brief Posts a range of events to the back of the default event lane, even if the event queue is full.
+	 * \sa <tt>force_post_events_back(ForwardIterator first, ForwardIterator last, std::size_t lane)</tt>
+	 */
+	template<typename ForwardIterator>
+	void force_post_events_back(ForwardIterator first, ForwardIterator last) {
+		force_post_events_back(first, last, default_event_lane_);
+	}
+
+	/**
+	 * \brief Posts a range of events to the back of an event lane, even if the event queue is full.
+	 *
+	 * Works like \c post_events_back(), but neither applies the overflow
+	 * policy nor blocks, so the event queue may grow beyond its capacity.
+	 * Meant for the few events that may neither be dropped nor wait for the
+	 * thread fetching events, like the state changes of a connection that
+	 * thread tears down.
+	 *
+	 * \tparam ForwardIterator A forward iterator over <tt>std::shared_ptr\<event\></tt>.
+	 * \param first The begin of the range of events to post.
+	 * \param last The end of the range of events to post.
+	 * \param lane The event lane to add the events to.
+	 * \throw std::out_of_range if there is no such lane.
+	 * \note All events must belong to the exact IRC context they are posted to.
+	 */
+	template<typename ForwardIterator>
+	void force_post_events_back(ForwardIterator first, ForwardIterator last, std::size_t lane) {
+#ifndef NDEBUG
+		for(ForwardIterator it = first; it != last; ++it) {
+			assert(&((*it)->irc) == this && "Must post event to correct IRC context!");
+		}
+#endif
+
+		const std::size_t count = std::distance(first, last);
+		if (count == 0) {
+			return;
+		}
+
+		event_lane &target = *event_lanes_.at(lane);
+		event_queue_depth_ += count;
+		enqueue_counted_events_back(first, last, count, lane, target);
+	}
+
+	/**
+	 * \brief Posts an event to the back of the default event lane once a deadline has passed.
+	 * \param ev The event to add to the event queue.
+	 * \param deadline The point in time to post the event at.
+	 * \return A handle to cancel the timer with.
+	 * \note ev must belong to the exact IRC context it is posted to. Prefer
+	 *          <tt>ev.post_at(deadline)</tt> instead.
+	 */
+	util::timer_handle post_event_at(event &ev, std::chrono::steady_clock::time_point deadline) {
+		return post_event_at(ev, deadline, default_event_lane_);
+	}
+
+	/**
+	 * \brief Posts an event to the back of an event lane once a deadline has passed.
+	 *
+	 * Timers are kept in a hierarchical timing wheel with a resolution of one
+	 * millisecond, so adding and cancelling them takes constant time no matter
+	 * how many timers are pending. Deadlines are rounded up to the next
+	 * millisecond, so events are never posted early.
+	 *
+	 * Expired timers are posted by \c fetch_event(), which wakes up in time
+	 * for the earliest deadline. Since the event was accepted when the timer
+	 * was added, it is posted even if the event queue is at capacity.
+	 *
+	 * \param ev The event to add to the event queue.
+	 * \param deadline The point in time to post the event at.
+	 * \param lane The event lane to add the event to. If the lane no longer
+	 *             exists once the timer expires, the default lane is used.
+	 * \return A handle to cancel the timer with.
+	 * \throw std::out_of_range if there is no such lane.
+	 * \note ev must belong to the exact IRC context it is posted to. Prefer
+	 *          <tt>ev.post_at(deadline, lane)</tt> instead.
+	 */
+	util::timer_handle post_event_at(event &ev, std::chrono::steady_clock::time_point deadline, std::size_t lane);
+
+	/**
+	 * \brief Cancels a timer added by \c post_event_at().
+	 * \param timer The handle returned when adding the timer.
+	 * \return
+	 *     - \c false if the event has already been posted or the timer was
+	 *       cancelled before,
+	 *     - \c true if the timer was cancelled
+	 */
+	bool cancel_timer(util::timer_handle timer);
+
+	/**
+	 * \brief Checks the number of pending timers.
+	 * \return The number of events waiting for their deadline.
+	 */
+	std::size_t pending_timers() const;
+
+	/**
+	 * \brief Checks when the earliest pending timer expires.
+	 * \return The deadline of the earliest pending timer, rounded up to the
+	 *         next millisecond, or <tt>std::chrono::steady_clock::time_point::max()</tt>
+	 *         if no timers are pending.
+	 */
+	std::chrono::steady_clock::time_point next_timer_deadline() const noexcept;
+
+	/// \brief Strategy used to pick the event lane the next event is fetched from.
+	enum class lane_scheduling {
+		/// \brief Always serve the lowest numbered non-empty lane.
+		strict_priority,
+		/// \brief Serve each lane up to its weight per round, lowest numbered lanes first.
+		weighted_round_robin
+	};
+
+	/**
+	 * \brief Configures the event lanes of the event queue.
+	 *
+	 * Each lane holds its own front and back queue. Lanes are numbered from 0,
+	 * which is the most urgent one, and \c fetch_event() picks the lane to
+	 * serve according to \c scheduling. Initially, there is only a single lane.
+	 *
+	 * Events in lanes that continue to exist stay where they are, events in
+	 * lanes that are removed are moved to the new default lane.
+	 *
+	 * \param weights The weight of each lane. The number of weights determines
+	 *                the number of lanes. Weights are only relevant for
+	 *                \c lane_scheduling::weighted_round_robin.
+	 * \param scheduling How to pick the lane to fetch the next event from.
+	 * \param default_lane The lane events are posted to if no lane is given.
+	 * \throw std::invalid_argument if no weights are passed, if a weight is
+	 *        \c 0 or if \c default_lane does not exist.
+	 *
+	 * \warning Must not be called while other threads post or fetch events.
+	 */
+	void set_event_lanes(std::vector<unsigned> weights, lane_scheduling scheduling = lane_scheduling::strict_priority, std::size_t default_lane = 0);
+
+	/**
+	 * \brief Checks the number of event lanes.
+	 * \return The number of event lanes.
+	 */
+	std::size_t event_lane_count() const noexcept {
+		return event_lanes_.size();
+	}
+
+	/**
+	 * \brief Checks which event lane events are posted to by default.
+	 * \return The index of the default event lane.
+	 */
+	std::size_t default_event_lane() const noexcept {
+		return default_event_lane_;
+	}
+
+	/**
+	 * \brief Checks the number of events queued in an event lane.
+	 * \param lane The event lane to check.
+	 * \return The number of events currently queued in the lane.
+	 * \throw std::out_of_range if there is no such lane.
+	 * \note The result is only a snapshot if other threads post or fetch
+	 *       events concurrently.
+	 */
+	std::size_t event_lane_depth(std::size_t lane) const {
+		return event_lanes_.at(lane)->depth;
+	}
+
+	/// \brief What to do when an event is posted to a full event queue.
+	enum class overflow_policy {
+		/// \brief Block the posting thread until there is room in the queue.
+		block,
+		/// \brief Drop the oldest event of the least urgent non-empty lane,
+		///        whether it was posted to the front or the back.
+		drop_oldest,
+		/// \brief Drop the event being posted.
+		drop_newest,
+		/// \brief Replace a queued event with the same original id in the
+		///        same lane with the posted event, otherwise drop the posted
+		///        event.
+		coalesce
+	};
+
+	/**
+	 * \brief Limits the number of events in the event queue.
+	 *
+	 * The capacity is shared by all event lanes. When an event is posted to a
+	 * full event queue, \c policy decides what happens.
+	 *
+	 * \param capacity The maximum number of queued events.
+	 * \param policy What to do with events posted to a full event queue.
+	 * \throw std::invalid_argument if \c capacity is \c 0.
+	 * \throw std::logic_error if \c policy is \c overflow_policy::drop_oldest
+	 *        or \c overflow_policy::coalesce while the lock-free event queue
+	 *        is in use, as both need access to the queued events.
+	 *
+	 * \warning With \c overflow_policy::block, posting from the thread that
+	 *          fetches events from the same IRC context will block forever on
+	 *          a full event queue.
+	 * \warning Must not be called while other threads post or fetch events.
+	 */
+	void set_event_queue_capacity(std::size_t capacity, overflow_policy policy = overflow_policy::block);
+
+	/**
+	 * \brief Removes the limit on the number of events in the event queue.
+	 * \warning Must not be called while other threads post or fetch events.
+	 */
+	void unset_event_queue_capacity();
+
+	/**
+	 * \brief Sets the event queue depths that trigger watermark events.
+	 *
+	 * Once the event queue holds \c high_watermark events, an
+	 * \c on_event_queue_high_watermark event is emitted. Once it drained back
+	 * to \c low_watermark events after that, an \c on_event_queue_low_watermark
+	 * event is emitted.
+	 *
+	 * These events do not go through the event queue. Instead, they are
+	 * emitted directly on the thread that crossed the watermark, i.e. a
+	 * posting thread for the high watermark and a fetching thread for the low
+	 * watermark. This allows e.g. a network module to stop reading input while
+	 * the handler thread is stuck.
+	 *
+	 * \param high_watermark The queue depth to emit the high watermark event at.
+	 * \param low_watermark The queue depth to emit the low watermark event at.
+	 * \throw std::invalid_argument if \c low_watermark is not below
+	 *        \c high_watermark.
+	 *
+	 * \warning Must not be called while other threads post or fetch events.
+	 */
+	void set_event_queue_watermarks(std::size_t high_watermark, std::size_t low_watermark);
+
+	/**
+	 * \brief Checks the total number of events in the event queue.
+	 * \return The number of events currently queued in all lanes.
+	 * \note The result is only a snapshot if other threads post or fetch
+	 *       events concurrently.
+	 */
+	std::size_t event_queue_depth() const noexcept {
+		return event_queue_depth_;
+	}
+
+	/**
+	 * \brief Checks whether the event queue is above its high watermark.
+	 * \return
+	 *     - \c true if an \c on_event_queue_high_watermark event was emitted
+	 *       and the matching \c on_event_queue_low_watermark event was not,
+	 *     - \c false otherwise
+	 * \note The result is only a snapshot if other threads post or fetch
+	 *       events concurrently.
+	 */
+	bool event_queue_above_high_watermark() const noexcept {
+		return event_queue_above_high_watermark_;
+	}
+
+	/**
+	 * \brief Switches the event queue to the mutex based implementation.
+	 *
+	 * This is the default. Events posted while the lock-free implementation
+	 * was active are carried over.
+	 *
+	 * \warning Must not be called while other threads post or fetch events.
+	 */
+	void use_locked_event_queue();
+
+	/**
+	 * \brief Switches the event queue to the lock-free implementation.
+	 *
+	 * Posting events will no longer take a lock, so that many producer threads
+	 * will not contend with each other or with the consumer. The consumer only
+	 * takes a lock when it has to block on an empty event queue.
+	 *
+	 * \throw std::logic_error if the overflow policy is
+	 *        \c overflow_policy::drop_oldest or \c overflow_policy::coalesce.
+	 *
+	 * \warning Must not be called while other threads post or fetch events.
+	 * \warning While the lock-free event queue is in use, \c fetch_event() must
+	 *          not be called by multiple threads concurrently.
+	 */
+	void use_lock_free_event_queue();
+
+	/**
+	 * \brief Checks which event queue implementation is in use.
+	 * \return
+	 *     - \c false if the mutex based event queue is used,
+	 *     - \c true if the lock-free event queue is used
+	 */
+	bool uses_lock_free_event_queue() const noexcept {
+		return event_queue_lock_free_;
+	}
+
+	/**
+	 * \brief Creates a pollable handle that signals a non-empty event queue.
+	 *
+	 * The handle is a Linux eventfd. It is readable whenever the event queue
+	 * holds events and is reset once \c fetch_event() drained the queue, so
+	 * that a single thread can wait for many IRC contexts, sockets and other
+	 * file descriptors at once, e.g. using epoll or an asio
+	 * <tt>posix::stream_descriptor</tt>. Posting a burst of events to an
+	 * empty event queue signals the handle only once.
+	 *
+	 * The handle must not be read from or written to; wait for it to become
+	 * readable, then fetch events with a timeout of \c 0. Timers do not signal
+	 * the handle before their events are posted, so the waiting thread also
+	 * needs to fetch events once \c next_timer_deadline() has passed.
+	 *
+	 * \return The file descriptor of the handle. Calling this again returns
+	 *         the same file descriptor.
+	 * \throw std::system_error if the eventfd can not be created.
+	 * \throw std::logic_error if eventfds are not available on this platform.
+	 *
+	 * \warning Must not be called while other threads post or fetch events.
+	 */
+	int enable_wait_handle();
+
+	/**
+	 * \brief Closes the handle created by \c enable_wait_handle().
+	 * \warning Must not be called while other threads post or fetch events.
+	 */
+	void disable_wait_handle();
+
+	/**
+	 * \brief Checks the pollable handle of the IRC context.
+	 * \return The file descriptor returned by \c enable_wait_handle() or
+	 *         \c -1 if there is no wait handle.
+	 */
+	int wait_handle() const noexcept {
+		return wait_handle_;
+	}
+
+	/// \brief Dispatch statistics of an event id or a single event handler.
+	struct dispatch_statistics {
+		event_id id; ///< The event id the statistics refer to.
+		connection_type connection; ///< The event handler, for per handler statistics.
+		util::latency_histogram latency; ///< Time spent per dispatch, in \c util::cycle_clock ticks.
+		double ticks_per_second; ///< Frequency of \c util::cycle_clock.
+
+		/**
+		 * \brief Checks how often the event was dispatched or the event handler was called.
+		 * \return The number of invocations.
+		 */
+		std::uint64_t invocations() const noexcept {
+			return latency.count();
+		}
+
+		/**
+		 * \brief Estimates a latency percentile.
+		 * \param percentile The percentile to look up, from \c 0 to \c 100.
+		 * \return The estimated latency.
+		 */
+		std::chrono::nanoseconds latency_percentile(double percentile) const {
+			return to_duration(latency.percentile(percentile));
+		}
+
+		/**
+		 * \brief Checks the total time spent.
+		 * \return The sum of all latencies.
+		 */
+		std::chrono::nanoseconds total_latency() const {
+			return to_duration(latency.sum());
+		}
+
+	private:
+		std::chrono::nanoseconds to_duration(util::latency_histogram::value_type ticks) const {
+			return std::chrono::nanoseconds(static_cast<std::chrono::nanoseconds::rep>(ticks / ticks_per_second * 1e9));
+		}
+	};
+
+	/// \brief Snapshot of the dispatch statistics of an IRC context.
+	struct dispatch_profile {
+		/// \brief Statistics per emitted event id, covering all of its event handlers.
+		std::vector<dispatch_statistics> events;
+		/// \brief Statistics per currently connected event handler.
+		std::vector<dispatch_statistics> handlers;
+	};
+
+	/**
+	 * \brief Checks whether dispatch profiling has been compiled in.
+	 *
+	 * Dispatch profiling is enabled by defining \c LIBSLIRC_DISPATCH_PROFILING
+	 * when building libslirc. Otherwise, \c emit_event() does not measure
+	 * anything and \c dispatch_profile_snapshot() returns an empty profile.
+	 *
+	 * \return
+	 *     - \c false if dispatch profiling is not available,
+	 *     - \c true if dispatch profiling is available
+	 */
+	static constexpr bool dispatch_profiling_available() noexcept {
+#ifdef LIBSLIRC_DISPATCH_PROFILING
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/**
+	 * \brief Takes a snapshot of the dispatch statistics.
+	 *
+	 * Every call to \c emit_event() that finds event handlers is timed as a
+	 * whole for its event id and per called event handler, reading
+	 * \c util::cycle_clock once per event handler.
+	 *
+	 * \return The statistics of all event ids emitted so far and of all
+	 *         currently connected event handlers.
+	 * \note Statistics of disconnected event handlers are discarded.
+	 */
+	dispatch_profile dispatch_profile_snapshot() const;
+
+	/**
+	 * \brief Enables or disables tracing the lifecycle of events.
+	 *
+	 * Traced events record their creation, posting, fetching, each emit per
+	 * event id and their destruction with timestamps, see \c event_trace.
+	 * Events spawned off a traced event are always traced, so chains of
+	 * events stay complete. Events that are not traced only cost a single
+	 * check per step.
+	 *
+	 * \param sample_every Trace one out of this many created events. \c 1
+	 *                     traces every event, \c 0 disables tracing.
+	 */
+	void set_event_tracing(unsigned sample_every) noexcept;
+
+	/**
+	 * \brief Checks which share of events is traced.
+	 * \return One out of how many events is traced, or \c 0 if tracing is disabled.
+	 */
+	unsigned event_tracing() const noexcept;
+
+	/**
+	 * \brief Exports the recorded traces of this IRC contexts events.
+	 * \param out The stream to write Chrome trace event JSON to.
+	 * \sa event_trace::write_chrome_json()
+	 */
+	void write_event_trace(std::ostream &out) const;
 
 	/**
 	 * \brief Emits an event to all event handlers registered to its \c event::current_id.
@@ -299,43 +1156,295 @@ public:
 
 
 private:
-	std::unordered_map<std::type_index, detail::module_base *> modules_;
-	mutable std::mutex signals_mutex_;
-		std::unordered_map<event_id, signal_type, event_id::hash> signals_; // mutable: const access may create empty signal
+	friend class event;
+
+	std::unordered_map<std::type_index, std::shared_ptr<detail::module_base>> modules_;
+	std::shared_ptr<event_pool> event_pool_;
+	using route_key_function = const std::string *(*)(const util::component_map &);
+	struct handler_entry {
+		using callback_type = std::function<void(const connection_type &, event &)>;
+
+		struct route_type {
+			std::type_index kind;
+			route_key_function key_of;
+			std::string key;
+		};
+
+		handler_entry(const event_id &id, callback_type callback, int category, group_type group, bool concurrent);
+
+		const event_id id;
+		const callback_type callback;
+		const int category; // 0: at_front, 1: grouped, 2: at_back
+		const group_type group;
+		const bool concurrent;
+		connection_type connection;
+		std::atomic<bool> connected;
+		std::weak_ptr<handler_registry> registry;
+		std::unique_ptr<util::latency_histogram> latency; // only with LIBSLIRC_DISPATCH_PROFILING
+		std::unique_ptr<const route_type> route; // only for connect_routed()
+	};
+
+	using handler_list = std::vector<std::shared_ptr<handler_entry>>;
+	using handler_table = std::vector<std::shared_ptr<const handler_list>>; // indexed by event_id::index()
+
+	struct route_index {
+		std::type_index kind;
+		route_key_function key_of;
+		std::unordered_map<std::string, std::shared_ptr<const handler_list>> handlers;
+	};
+	using route_table = std::vector<std::vector<std::shared_ptr<const route_index>>>; // indexed by event_id::index()
+
+	struct handler_registry {
+		void add(const std::shared_ptr<handler_entry> &entry, connect_position position);
+		void remove(const handler_entry &entry);
+
+		static std::shared_ptr<const handler_list> with(const handler_list *list, const std::shared_ptr<handler_entry> &entry, connect_position position);
+		static std::shared_ptr<const handler_list> without(const handler_list &list, const handler_entry &entry);
+
+		util::rcu_ptr<handler_table> table;
+		util::rcu_ptr<route_table> routes;
+	};
+
+	std::shared_ptr<handler_registry> handlers_;
+
+	using static_dispatch_function = void(*)(detail::module_base &, event &);
+	struct static_dispatch {
+		std::shared_ptr<detail::module_base> module;
+		static_dispatch_function dispatch;
+	};
+	util::rcu_ptr<std::vector<std::vector<static_dispatch>>> static_handlers_; // indexed by event_id::index()
+	util::rcu_ptr<std::vector<std::shared_ptr<util::latency_histogram>>> event_latency_; // indexed by event_id::index()
+	std::atomic<unsigned> trace_sampling_;
+	std::atomic<std::uint64_t> trace_samples_;
+	util::rcu_ptr<post_observer> post_observer_;
+	std::atomic<bool> has_post_observer_;
+	struct event_lane {
+		explicit event_lane(unsigned weight);
+
+		bool has_queued_events() const noexcept;
+		bool has_inbox_events() const noexcept;
+		void compact_back();
+		void collect_front_inbox();
+		void collect_back_inbox();
+		std::shared_ptr<event> pop();
+
+		unsigned weight;
+		unsigned credit;
+		std::vector<std::shared_ptr<event>> front;
+		std::vector<std::shared_ptr<event>> back;
+		std::vector<std::shared_ptr<event>>::size_type back_skip;
+		util::mpsc_stack<std::shared_ptr<event>> front_inbox;
+		util::mpsc_stack<std::shared_ptr<event>> back_inbox;
+		std::atomic<std::size_t> depth;
+	};
+
 	mutable std::mutex event_queue_mutex_;
 		std::condition_variable event_queue_condition_;
-		std::vector<std::shared_ptr<event>> event_queue_front_;
-		std::vector<std::shared_ptr<event>> event_queue_back_;
-		std::vector<std::shared_ptr<event>>::size_type event_queue_back_skip_;
+		std::vector<std::unique_ptr<event_lane>> event_lanes_; // the lanes' front and back belong to the consumer while event_queue_lock_free_ is set
+		std::uint64_t event_queue_order_; // stamped on events queued to the front or back, so drop_oldest finds the oldest one
+		std::condition_variable event_queue_space_condition_;
+	lane_scheduling event_lane_scheduling_;
+	std::size_t default_event_lane_;
+	std::atomic<std::size_t> event_queue_producers_waiting_;
+	std::atomic<std::size_t> event_queue_depth_;
+	std::size_t event_queue_capacity_;
+	overflow_policy event_queue_overflow_policy_;
+	std::size_t event_queue_high_watermark_;
+	std::size_t event_queue_low_watermark_;
+	std::atomic<bool> event_queue_above_high_watermark_;
+	std::atomic<bool> event_queue_lock_free_;
+	std::atomic<bool> event_queue_consumer_waiting_;
+	struct delayed_event {
+		std::shared_ptr<event> ev;
+		std::size_t lane;
+	};
+
+	const std::chrono::steady_clock::time_point timer_epoch_;
+	mutable std::mutex timer_mutex_;
+		util::timer_wheel<delayed_event> timers_;
+	std::atomic<util::timer_wheel<delayed_event>::tick_type> next_timer_tick_;
+	int wait_handle_;
+	std::atomic<bool> wait_handle_signalled_;
+	struct async_fetch_state;
+	std::unique_ptr<async_fetch_state> async_fetch_;
+	std::atomic<bool> async_fetch_waiting_;
+	std::atomic<scheduler *> scheduler_;
+	std::atomic<std::size_t> scheduler_users_;
+	std::atomic<unsigned> scheduler_state_;
+	util::timer_handle scheduler_timer_; // guarded by the schedulers timer mutex
+	std::chrono::steady_clock::time_point scheduler_timer_deadline_; // guarded by the schedulers timer mutex
 	bool shutting_down_;
 
+	friend class scheduler;
+	void notify_scheduler();
+	void notify_scheduler_at(std::chrono::steady_clock::time_point deadline);
+	void notify_wait_handle();
+	void notify_async_fetch();
+	void reset_wait_handle();
+
+	void post_expired_timers();
+	void observe_post(event &ev, std::size_t lane, bool front);
+	void enqueue_event_back(event &ev, event_lane &target);
+
+	// The events are already counted in event_queue_depth_.
+	template<typename ForwardIterator>
+	void enqueue_counted_events_back(ForwardIterator first, ForwardIterator last, std::size_t count, std::size_t lane, event_lane &target) {
+		if (has_post_observer_) {
+			for(ForwardIterator it = first; it != last; ++it) {
+				observe_post(**it, lane, false);
+			}
+		}
+
+		if (event_queue_lock_free_) {
+			// count first, so depth never underflows when the consumer is faster
+			target.depth += count;
+			target.back_inbox.push_range(first, last);
+			notify_event_queue_consumer();
+		}
+		else {
+			{ std::lock_guard<std::mutex> lock(event_queue_mutex_);
+				target.compact_back();
+				for(ForwardIterator it = first; it != last; ++it) {
+					(*it)->queue_order_ = event_queue_order_++;
+				}
+				target.back.insert(target.back.end(), first, last);
+				target.depth += count;
+			}
+			event_queue_condition_.notify_all();
+		}
+		trace_posts_back(first, last);
+		notify_scheduler();
+		notify_wait_handle();
+		notify_async_fetch();
+		event_queue_grown();
+	}
+
+	template<typename ForwardIterator>
+	static void trace_posts_back(ForwardIterator first, ForwardIterator last) noexcept {
+		for(; first != last; ++first) {
+			(*first)->trace(event_trace::phase::posted_back);
+		}
+	}
+
+	std::shared_ptr<event> pop_queued_event();
+	std::shared_ptr<event> pop_event_lock_free();
+	void notify_event_queue_consumer();
+	bool try_reserve_event_queue_slots(std::size_t count) noexcept;
+	bool reserve_event_queue_slot_locked(std::unique_lock<std::mutex> &lock, event_lane &target, event &ev);
+	bool reserve_event_queue_slot_lock_free();
+	bool drop_oldest_event_locked();
+	void event_queue_grown();
+	void event_queue_shrunk();
+
+	// Event is const event for concurrent event handlers, which only get a const view of the event.
+	template<typename Event = event, typename Func>
+	static auto make_handler_callback(Func &&f) {
+		return [f = std::forward<Func>(f)](const connection_type &connection, event &ev) {
+			Event &view = ev;
+			if constexpr (is_callable_with_connection<Func, Event>::value) {
+				f(view, connection);
+			}
+			else if constexpr (std::is_const_v<Event>) {
+				static_assert(
+					is_callable_without_connection<Func, Event>::value,
+					"passed function can neither be called with "
+					"(const event&, connection_type) nor with (const event&) "
+					"through a const reference"
+				);
+				f(view);
+			}
+			else {
+				static_assert(
+					is_callable_without_connection<Func, Event>::value,
+					"passed function can neither be called with "
+					"(event_t&, connection_type) nor with (event&)"
+				);
+				f(view);
+			}
+		};
+	}
+
+	connection_type connect_handler(const event_id &id, handler_entry::callback_type callback, slot_group group, connect_position position, bool concurrent);
+	connection_type connect_routed_handler(const event_id &id, std::type_index kind, route_key_function key_of, std::string key, handler_entry::callback_type callback, slot_group group, connect_position position);
+	std::shared_ptr<handler_entry> make_handler_entry(const event_id &id, handler_entry::callback_type callback, slot_group group, bool concurrent);
+
+	template<typename Module, typename=std::void_t<>>
+	struct has_static_handlers: std::false_type {};
+
+	template<typename Module>
+	struct has_static_handlers<Module, std::void_t<typename Module::slirc_static_handlers>>: std::true_type {};
+
+	template<auto Event, auto HandlerEvent>
+	static constexpr bool is_same_event() noexcept {
+		if constexpr (std::is_same_v<decltype(Event), decltype(HandlerEvent)>) {
+			return Event == HandlerEvent;
+		}
+		else {
+			return false;
+		}
+	}
+
+	template<typename Module, auto Event, typename... Handlers>
+	static void dispatch_static_handlers(detail::module_base &module, event &ev) {
+		Module &typed_module = static_cast<Module &>(module);
+		// expands to direct calls of exactly the handlers bound to Event
+		(..., [&]{
+			if constexpr (is_same_event<Event, Handlers::event>()) {
+				Handlers::template call<Module>(typed_module, ev);
+			}
+		}());
+	}
+
+	template<typename Module, typename... Handlers>
+	void add_static_handlers(const std::shared_ptr<Module> &module, static_handlers<Handlers...>) {
+		std::vector<std::pair<event_id, static_dispatch_function>> dispatchers;
+		(..., [&]{
+			const event_id id(Handlers::event);
+			if (std::none_of(dispatchers.begin(), dispatchers.end(), [&](const auto &dispatcher) { return dispatcher.first == id; })) {
+				dispatchers.emplace_back(id, &dispatch_static_handlers<Module, Handlers::event, Handlers...>);
+			}
+		}());
+		add_static_dispatchers(module, dispatchers);
+	}
+
+	void add_static_dispatchers(const std::shared_ptr<detail::module_base> &module, const std::vector<std::pair<event_id, static_dispatch_function>> &dispatchers);
+	void remove_static_handlers(detail::module_base &module);
+	void call_handlers(const handler_list &handlers, event &ev);
+	std::uint64_t sample_event_trace(const event *origin) noexcept;
+	struct concurrent_run;
+	void emit_concurrently(const std::shared_ptr<handler_entry> *handlers, std::size_t count, event &ev);
+
+	using event_sink = void(*)(void *, std::shared_ptr<event> &&);
+	std::size_t fetch_events_into(std::size_t max_events, std::chrono::milliseconds timeout, event_sink sink, void *sink_context);
+
 	struct event_scoped_connection {
-		event_scoped_connection(event &, connection_type);
+		explicit event_scoped_connection(event &) noexcept;
 		~event_scoped_connection();
 		event &ev;
+		const connection_type *previous;
 	};
 
-	template<typename Func, typename=std::void_t<>>
+	template<typename Func, typename Event, typename=std::void_t<>>
 	struct is_callable_with_connection: std::false_type {};
 
-	template<typename Func>
-	struct is_callable_with_connection<Func,
+	template<typename Func, typename Event>
+	struct is_callable_with_connection<Func, Event,
 		std::void_t<decltype(
-			std::declval<std::decay_t<Func>>(
-				std::declval<event&>(),
+			std::declval<const std::decay_t<Func>&>()(
+				std::declval<Event&>(),
 				std::declval<connection_type>()
 			)
 		)>
 	>: std::true_type {};
 
-	template<typename Func, typename=std::void_t<>>
+	template<typename Func, typename Event, typename=std::void_t<>>
 	struct is_callable_without_connection: std::false_type {};
 
-	template<typename Func>
-	struct is_callable_without_connection<Func,
+	template<typename Func, typename Event>
+	struct is_callable_without_connection<Func, Event,
 		std::void_t<decltype(
-			std::declval<std::decay_t<Func>>(
-				std::declval<event&>()
+			std::declval<const std::decay_t<Func>&>()(
+				std::declval<Event&>()
 			)
 		)>
 	>: std::true_type {};
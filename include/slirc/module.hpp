@@ -31,6 +31,7 @@
 
 namespace slirc {
 
+class event;
 class irc;
 
 namespace detail {
@@ -58,6 +59,67 @@ public:
 	using detail::module_base::module_base;
 };
 
+/**
+ * \brief Binds an event handler to an event at compile time.
+ *
+ * Used as an element of \c static_handlers.
+ *
+ * \tparam Event The enum value of the event to handle.
+ * \tparam Handler The event handler. Either a pointer to a member function of
+ *                 the module callable as <tt>(module.*Handler)(event &)</tt>
+ *                 or a pointer to a function callable as
+ *                 <tt>Handler(module, event &)</tt>.
+ */
+template<auto Event, auto Handler>
+struct static_handler {
+	static_assert(std::is_enum_v<decltype(Event)>, "Static handler events must be enum values.");
+
+	static constexpr auto event = Event; ///< @brief The event to handle
+
+	/// @brief Internal use only
+	template<typename Module>
+	static void call(Module &module, slirc::event &ev) {
+		if constexpr (std::is_member_function_pointer_v<decltype(Handler)>) {
+			(module.*Handler)(ev);
+		}
+		else {
+			Handler(module, ev);
+		}
+	}
+};
+
+/**
+ * \brief A compile-time list of event handlers of a module.
+ *
+ * Modules announce their static event handlers by declaring a type alias
+ * named \c slirc_static_handlers:
+ *
+ * \code
+ * struct pinger
+ * : slirc::module<pinger> {
+ *     using slirc::module<pinger>::module;
+ *     void on_ping(slirc::event &ev);
+ *
+ *     using slirc_static_handlers = slirc::static_handlers<
+ *         slirc::static_handler<ping_events::on_ping, &pinger::on_ping>
+ *     >;
+ * };
+ * \endcode
+ *
+ * When the module is loaded, the IRC context registers a single dispatch
+ * function per event handled by the module, in which all of the modules
+ * event handlers for that event are called directly (and thus may be
+ * inlined), in the order they are listed. Static event handlers are called
+ * before the event handlers connected by \c irc::connect() and stay
+ * registered until the module is unloaded. A module unloaded while one of
+ * its static event handlers runs, e.g. by that handler, is destroyed once
+ * the emit is done.
+ *
+ * \tparam Handlers The \c static_handler bindings.
+ */
+template<typename... Handlers>
+struct static_handlers {};
+
 #ifndef SLIRC_DEFAULT_IMPLEMENTATION
 #define SLIRC_DEFAULT_IMPLEMENTATION(DefImplementationClass) \
 	using slirc_default_implementation = DefImplementationClass*
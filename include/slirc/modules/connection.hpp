@@ -29,6 +29,7 @@
 
 #include <atomic>
 #include <memory>
+#include <string>
 #include <string_view>
 
 #include <boost/asio/io_service.hpp>
@@ -38,10 +39,45 @@
 
 namespace slirc::modules {
 
+/**
+ * \brief Default implementation of \c apis::connection on a Boost.ASIO io_service.
+ *
+ * Received data is read into reusable buffers and split into lines in
+ * place. Each line is posted as an \c on_message_received event whose
+ * \c apis::connection::raw_message is a view into the buffer, so lines are
+ * never copied. A buffer is reused once no event refers to it anymore.
+ *
+ * Reading stops while the event queue is above its high watermark, see
+ * \c irc::set_event_queue_watermarks(), so a slow handler thread makes the
+ * server wait instead of the queue growing.
+ * Lines that do not fit into a full event queue under
+ * \c irc::overflow_policy::block stop reading the same way until they are
+ * posted, so the io_service never waits for the thread fetching events.
+ * Lines still held back when the connection shuts down are dropped.
+ * Connection state events are posted even to a full event queue.
+ *
+ * Data sent while connecting is queued and written once connected.
+ */
 class connection
-: apis::connection {
+: public apis::connection {
 public:
-	connection(slirc::irc &irc, std::string_view host, unsigned port, boost::asio::io_service &io_service = get_io_service());
+	/**
+	 * \brief Creates a connection served by an io_service assigned by \c acquire_io_service().
+	 * \param irc The IRC context the connection belongs to.
+	 * \param host The host to connect to.
+	 * \param port The port to connect to.
+	 * \throw std::logic_error if there is no active io_service.
+	 */
+	connection(slirc::irc &irc, std::string_view host, unsigned port);
+
+	/**
+	 * \brief Creates a connection served by a given io_service.
+	 * \param irc The IRC context the connection belongs to.
+	 * \param host The host to connect to.
+	 * \param port The port to connect to.
+	 * \param io_service The io_service to run the connection on.
+	 */
+	connection(slirc::irc &irc, std::string_view host, unsigned port, boost::asio::io_service &io_service);
 	~connection();
 
 	virtual void connect() override;
@@ -53,6 +89,7 @@ private:
 	std::string host_;
 	unsigned port_;
 	boost::asio::io_service &io_service_;
+	const bool assigned_io_service_;
 
 	struct impl;
 	std::shared_ptr<impl> impl_;
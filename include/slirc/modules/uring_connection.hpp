@@ -0,0 +1,161 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_MODULES_URING_CONNECTION_HPP
+#define LIBSLIRC_MODULES_URING_CONNECTION_HPP
+
+#ifdef __linux__
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "../apis/connection.hpp"
+
+namespace slirc::modules {
+
+/**
+ * \brief Drives sockets through a Linux io_uring instance.
+ *
+ * Every socket receives through a single multishot receive request, which
+ * picks its buffers from a pool of receive buffers provided to the kernel, so
+ * idle sockets cost no syscalls and reading needs no syscall per read. Used
+ * buffers are provided again along with the next submission. Completions are
+ * processed on a thread owned by the service.
+ *
+ * Requires Linux 6.0 or later.
+ */
+class uring_service {
+public:
+	static constexpr unsigned default_entries = 4096; ///< @brief Default size of the submission queue
+	static constexpr unsigned default_buffers = 1024; ///< @brief Default number of receive buffers
+	static constexpr std::size_t default_buffer_size = 4096; ///< @brief Default size of each receive buffer
+
+	/**
+	 * \brief Sets up the io_uring instance and starts the completion thread.
+	 * \param entries The size of the submission queue.
+	 * \param buffers The number of receive buffers shared by all sockets.
+	 *                Must be between 1 and 65536.
+	 * \param buffer_size The size of each receive buffer.
+	 * \throw std::invalid_argument if \c buffers is out of range.
+	 * \throw std::system_error if io_uring is not available.
+	 */
+	explicit uring_service(unsigned entries = default_entries, unsigned buffers = default_buffers, std::size_t buffer_size = default_buffer_size);
+	uring_service(const uring_service &) = delete;
+	~uring_service();
+
+	/**
+	 * \brief Gets the service shared by connections created without one.
+	 *
+	 * The service is created with the default parameters when needed and
+	 * destroyed once no connection uses it anymore.
+	 *
+	 * \return The shared service.
+	 * \throw std::system_error if io_uring is not available.
+	 */
+	static std::shared_ptr<uring_service> get_default();
+
+private:
+	friend class uring_connection;
+
+	struct impl;
+	std::unique_ptr<impl> impl_;
+};
+
+/**
+ * \brief Implementation of \c apis::connection on top of io_uring.
+ *
+ * Load it in place of the default implementation:
+ *
+ * \code
+ * context.load_module<slirc::modules::uring_connection>("irc.example.net", 6667);
+ * \endcode
+ *
+ * Received lines are posted as \c on_message_received events carrying an
+ * \c apis::connection::raw_message, in batches per received chunk.
+ * Receiving stops while the event queue is above its high watermark, see
+ * \c irc::set_event_queue_watermarks(). Lines that do not fit into a full
+ * event queue under \c irc::overflow_policy::block stop receiving the same
+ * way until they are posted, so the completion thread never waits for the
+ * thread fetching events. Lines still held back when the connection shuts
+ * down are dropped. Connection state events are posted even to a full event
+ * queue.
+ */
+class uring_connection
+: public apis::connection {
+public:
+	/**
+	 * \brief Creates a connection driven by the shared \c uring_service.
+	 * \param irc The IRC context the connection belongs to.
+	 * \param host The host to connect to.
+	 * \param port The port to connect to.
+	 * \throw std::system_error if io_uring is not available.
+	 */
+	uring_connection(slirc::irc &irc, std::string_view host, unsigned port);
+
+	/**
+	 * \brief Creates a connection driven by a given \c uring_service.
+	 * \param irc The IRC context the connection belongs to.
+	 * \param host The host to connect to.
+	 * \param port The port to connect to.
+	 * \param service The service to drive the socket.
+	 */
+	uring_connection(slirc::irc &irc, std::string_view host, unsigned port, std::shared_ptr<uring_service> service);
+	~uring_connection();
+
+	/**
+	 * \brief Connects to the host.
+	 *
+	 * The host name is resolved synchronously; connecting itself completes
+	 * asynchronously with an \c on_connected or \c on_connecting_failed event.
+	 */
+	virtual void connect() override;
+	virtual void disconnect() override;
+
+	/**
+	 * \brief Sends data to the host.
+	 *
+	 * Data sent before the connection is established is sent once it is.
+	 *
+	 * \param data The data to send. It is copied before returning.
+	 */
+	virtual void send(std::string_view data) override;
+
+private:
+	std::string host_;
+	unsigned port_;
+	std::shared_ptr<uring_service> service_;
+
+	struct socket;
+	std::shared_ptr<socket> socket_;
+};
+
+}
+
+#endif // __linux__
+
+#endif //LIBSLIRC_MODULES_URING_CONNECTION_HPP
@@ -28,45 +28,177 @@
 #ifndef LIBSLIRC_NETWORK_HPP
 #define LIBSLIRC_NETWORK_HPP
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
 #include <boost/asio/io_service.hpp>
 
 namespace slirc {
 
+class irc;
+
 /**
- * \brief Represents a libslirc network thread.
+ * \brief Represents the libslirc network threads.
  *
  * Some of the facilities in libslirc require a Boost.ASIO io_service for their
  * operation. This can either be passed manually on a per-instance basis, or a
  * default one will be used. The default can be set to use a user provided
  * io_service, by calling the function \c use_external_io_service(), or
- * libslirc can provide an io_service itself if a \c network_thread instance
+ * libslirc can provide io_services itself if a \c network_thread instance
  * is created.
  *
  * If a user provided io_service is used, it is up to the user to ensure that
- * it is regularly run. When using the \c network_thread instance, it will be
- * automatically run in the background for the lifetime of the instance.
+ * it is regularly run. When using the \c network_thread instance, it runs a
+ * pool of event loops in the background for the lifetime of the instance,
+ * each with an io_service of its own running on a thread of its own. Every
+ * connection is assigned to one of these shards by \c acquire_io_service(),
+ * either round-robin or to the shard serving the fewest connections.
  */
 class network_thread {
-	network_thread();
+public:
+	/// \brief How io_services are assigned to connections.
+	enum class assignment_policy {
+		round_robin, ///< @brief Assign the shards in turn.
+		least_loaded ///< @brief Assign the shard with the fewest acquired io_services.
+	};
+
+	/**
+	 * \brief Starts the network threads.
+	 * \param threads The number of event loops to run. \c 0 runs one event
+	 *                loop per hardware thread.
+	 * \param policy How io_services are assigned to connections.
+	 * \param pin_threads Whether to pin the event loop threads to a CPU each,
+	 *                    in turn. Ignored on platforms other than Linux.
+	 * \throw std::logic_error if another \c network_thread instance exists.
+	 */
+	explicit network_thread(std::size_t threads = 1, assignment_policy policy = assignment_policy::least_loaded, bool pin_threads = false);
 	network_thread(const network_thread &) = delete;
 	network_thread(network_thread &&) = delete;
 	~network_thread();
 
-	boost::asio::io_service &get_io_service() const {
-		return io_service_;
+	/**
+	 * \brief Gets the io_service for the calling context.
+	 * \return
+	 *     - The io_service of the calling thread, if called from one of the
+	 *       event loop threads, or
+	 *     - the io_service of the first shard otherwise.
+	 */
+	boost::asio::io_service &get_io_service() const noexcept;
+
+	/**
+	 * \brief Gets the io_service for the calling context on behalf of an IRC context.
+	 *
+	 * Spreads the IRC contexts over the shards, so asynchronous operations
+	 * started off the event loop threads do not all end up on the first one.
+	 *
+	 * \param context The IRC context to run the asynchronous operation for.
+	 * \return
+	 *     - The io_service of the calling thread, if called from one of the
+	 *       event loop threads, or
+	 *     - the io_service of the shard of \c context otherwise, which is the
+	 *       same for every call with the same context.
+	 */
+	boost::asio::io_service &get_io_service(const irc &context) const noexcept;
+
+	/**
+	 * \brief Gets the io_service of a single shard.
+	 * \param shard The index of the shard.
+	 * \return The io_service of the shard.
+	 * \throw std::out_of_range if \c shard is not less than \c size().
+	 */
+	boost::asio::io_service &get_io_service(std::size_t shard) const;
+
+	/**
+	 * \brief Assigns an io_service according to the assignment policy.
+	 * \return The assigned io_service. It has to be returned through
+	 *         \c release_io_service() when no longer used.
+	 */
+	boost::asio::io_service &acquire_io_service();
+
+	/**
+	 * \brief Returns an io_service assigned by \c acquire_io_service().
+	 * \param io_service The assigned io_service. Other io_services are ignored.
+	 */
+	void release_io_service(boost::asio::io_service &io_service) noexcept;
+
+	/**
+	 * \brief Checks the number of shards.
+	 * \return The number of event loops.
+	 */
+	std::size_t size() const noexcept {
+		return shards_.size();
 	}
 
+	/**
+	 * \brief Checks the load of a shard.
+	 * \param shard The index of the shard.
+	 * \return The number of currently acquired io_services of the shard.
+	 * \throw std::out_of_range if \c shard is not less than \c size().
+	 */
+	std::size_t load(std::size_t shard) const;
+
 private:
-	mutable boost::asio::io_service io_service_;
+	struct shard {
+		mutable boost::asio::io_service io_service;
+		std::optional<boost::asio::io_service::work> work;
+		std::atomic<std::size_t> load{ 0 };
+		std::thread thread;
+	};
+
+	shard &next_shard() const noexcept;
+
+	const assignment_policy policy_;
+	std::vector<std::unique_ptr<shard>> shards_;
+	mutable std::atomic<std::size_t> next_shard_;
 };
 
 /**
  * \brief Get the active io_service used by libslirc.
+ *
+ * If the internal io_services are active, this is the io_service returned by
+ * <tt>network_thread::get_io_service()</tt>. Neither locks nor assigns an
+ * io_service, so it is cheap to call for every asynchronous operation.
+ *
  * \return A reference to the active io_service.
  * \throws std::logic_error if no io_service is set.
  */
 boost::asio::io_service &get_io_service();
 
+/**
+ * \brief Get the active io_service used by libslirc for an IRC context.
+ *
+ * Like \c get_io_service(), but if the internal io_services are active, this
+ * is the io_service returned by <tt>network_thread::get_io_service(context)</tt>.
+ *
+ * \param context The IRC context to run the asynchronous operation for.
+ * \return A reference to the active io_service.
+ * \throws std::logic_error if no io_service is set.
+ */
+boost::asio::io_service &get_io_service(const irc &context);
+
+/**
+ * \brief Assign an io_service to a connection.
+ *
+ * If the internal io_services are active, an io_service is assigned by
+ * <tt>network_thread::acquire_io_service()</tt>, otherwise the external
+ * io_service is returned.
+ *
+ * \return A reference to the assigned io_service. It has to be returned
+ *         through \c release_io_service() when no longer used.
+ * \throws std::logic_error if no io_service is set.
+ */
+boost::asio::io_service &acquire_io_service();
+
+/**
+ * \brief Return an io_service assigned by \c acquire_io_service().
+ * \param io_service The io_service to return.
+ */
+void release_io_service(boost::asio::io_service &io_service) noexcept;
+
 void use_external_io_service(boost::asio::io_service &io_service);
 void use_internal_io_service();
 
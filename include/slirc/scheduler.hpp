@@ -0,0 +1,160 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_SCHEDULER_HPP
+#define LIBSLIRC_SCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "util/timer_wheel.hpp"
+
+namespace slirc {
+
+class event;
+class irc;
+
+/**
+ * \brief Drives many IRC contexts on a fixed pool of worker threads.
+ *
+ * Rather than dedicating a thread to every IRC context that blocks in
+ * \c irc::fetch_event(), contexts can be attached to a scheduler. Whenever an
+ * event is posted to an attached context, the context is put on the run queue
+ * of one of the worker threads, which will then fetch and emit its events.
+ *
+ * Like a strand, the scheduler guarantees that each IRC context is only
+ * handled by a single worker thread at a time, so the usual threading
+ * assumptions of libslirc hold. A context that has handled a number of events
+ * is put back into the run queue, so that busy contexts can not starve others.
+ * Worker threads whose run queues ran dry steal runnable contexts from the
+ * other worker threads.
+ *
+ * Timers of attached contexts (see \c irc::post_event_at()) are tracked in a
+ * timing wheel of the scheduler, so that a context is run once its earliest
+ * timer expires.
+ *
+ * \warning While a context is attached to a scheduler, its events must not be
+ *          fetched by other means.
+ * \warning Exceptions escaping event handlers run by the scheduler will call
+ *          \c std::terminate().
+ */
+class scheduler {
+public:
+	/**
+	 * \brief Creates a scheduler and starts its worker threads.
+	 * \param thread_count The number of worker threads. If this is \c 0, one
+	 *                     thread will be used.
+	 * \param events_per_run The maximum number of events of a single context a
+	 *                       worker thread handles before moving on to the next
+	 *                       context.
+	 */
+	explicit scheduler(
+		std::size_t thread_count = std::thread::hardware_concurrency(),
+		std::size_t events_per_run = 64
+	);
+
+	scheduler(const scheduler &) = delete;
+	scheduler &operator=(const scheduler &) = delete;
+
+	scheduler(scheduler &&) = delete;
+	scheduler &operator=(scheduler &&) = delete;
+
+	/**
+	 * \brief Stops all worker threads and detaches all IRC contexts.
+	 * Events still queued in the IRC contexts are left in place.
+	 */
+	~scheduler();
+
+	/**
+	 * \brief Attaches an IRC context to the scheduler.
+	 * Events already queued in the context will be handled right away.
+	 * \param context The IRC context to attach.
+	 * \throw std::logic_error if the context is attached to another scheduler.
+	 */
+	void attach(irc &context);
+
+	/**
+	 * \brief Detaches an IRC context from the scheduler.
+	 * Blocks until no worker thread handles the context anymore. Events still
+	 * queued in the context are left in place.
+	 * \param context The IRC context to detach.
+	 * \warning Must not be called from an event handler of the context being
+	 *          detached.
+	 */
+	void detach(irc &context);
+
+	/**
+	 * \brief Checks the number of worker threads.
+	 * \return The number of worker threads.
+	 */
+	std::size_t thread_count() const noexcept {
+		return workers_.size();
+	}
+
+private:
+	friend class irc;
+
+	struct worker {
+		std::mutex run_queue_mutex;
+			std::deque<irc *> run_queue;
+		std::thread thread;
+	};
+
+	void schedule(irc &context);
+	void schedule_at(irc &context, std::chrono::steady_clock::time_point deadline);
+	void schedule_expired_timers();
+	void enqueue(irc &context);
+	irc *next_context(std::size_t index);
+	void run(irc &context, std::vector<std::shared_ptr<event>> &events);
+	void work(std::size_t index);
+
+	const std::size_t events_per_run_;
+	std::vector<std::unique_ptr<worker>> workers_;
+	std::atomic<std::size_t> next_worker_;
+	std::atomic<std::size_t> runnable_;
+	std::mutex idle_mutex_;
+		std::condition_variable idle_condition_;
+		std::atomic<std::size_t> sleeping_; // modified under the lock, also read without it
+		std::atomic<bool> stopping_; // modified under the lock, also read without it
+	std::mutex contexts_mutex_;
+		std::unordered_set<irc *> contexts_;
+	const std::chrono::steady_clock::time_point timer_epoch_;
+	std::mutex timers_mutex_;
+		util::timer_wheel<irc *> timers_;
+		std::atomic<util::timer_wheel<irc *>::tick_type> next_timer_tick_; // modified under the lock, also read without it
+};
+
+}
+
+#endif //LIBSLIRC_SCHEDULER_HPP
@@ -28,38 +28,95 @@
 #define LIBSLIRC_COMPONENT_MAP_HPP
 
 #include <cassert>
+#include <cstddef>
 
-#include <any>
-#include <typeindex>
-#include <unordered_map>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
 
 namespace slirc::util {
 
-/// \brief Container type using types as keys, able to hold 0 or 1 instances per type.
+/**
+ * \brief Container type using types as keys, able to hold 0 or 1 instances per type.
+ *
+ * The first \c inline_slots objects are kept in slots inside the map itself.
+ * Objects of at most \c inline_size bytes that are nothrow move constructible
+ * are stored directly in their slot; larger objects and objects beyond
+ * \c inline_slots are allocated separately. The slots beyond \c inline_slots
+ * are kept when their objects are erased or cleared, so refilling the map does
+ * not allocate them again.
+ *
+ * Objects are never moved while stored, so references stay valid until the
+ * object is erased or replaced or the \c component_map itself is moved from.
+ *
+ * A \c component_map may inherit the objects of a parent map, see \c inherit().
+ * Lookups of types not stored locally fall through to the parent, while any
+ * access allowing modification first copies the parent's object into the
+ * map, so the parent is never modified through its children.
+ */
 class component_map {
 public:
-	using underlying_type = std::unordered_map<std::type_index, std::any>;
-	using size_type = underlying_type::size_type;
+	using size_type = std::size_t;
+
+	static constexpr size_type inline_slots = 8; ///< @brief Number of slots stored inside the map
+	static constexpr size_type inline_size = 4 * sizeof(void*); ///< @brief Maximum size of objects stored inside a slot
+
+	component_map() noexcept = default;
+
+	/**
+	 * \brief Copies every object stored in another \c component_map
+	 * \param other The map to copy
+	 */
+	component_map(const component_map &other);
+
+	/**
+	 * \brief Takes the objects stored in another \c component_map
+	 * \param other The map to take the objects from
+	 * \post <tt>other.empty()</tt>
+	 *
+	 * \note Objects stored inside their slot are move constructed into the new
+	 *       map, invalidating references to them.
+	 */
+	component_map(component_map &&other) noexcept;
+
+	/**
+	 * \brief Replaces the contents with copies of the objects stored in another \c component_map
+	 * \param other The map to copy
+	 * \return \c *this
+	 */
+	component_map &operator=(const component_map &other);
+
+	/**
+	 * \brief Replaces the contents with the objects stored in another \c component_map
+	 * \param other The map to take the objects from
+	 * \return \c *this
+	 * \post <tt>other.empty()</tt>
+	 */
+	component_map &operator=(component_map &&other) noexcept;
+
+	~component_map() {
+		clear();
+	}
 
 	/**
 	 * \brief Fetches an element from the map
 	 * \tparam T The type to look up. This may be cv-qualified to change the type of reference returned.
 	 * \return A reference to the stored object
 	 * \throw std::out_of_range if no object of the given type is stored
+	 *
+	 * \note Unless \c T is const qualified, an inherited object is copied into the map first.
 	 */
 	template<typename T>
 	T &at() {
-#ifndef NDEBUG
-		try {
-#endif
-			return std::any_cast<T&>(content_.at(typeid(std::decay_t<T>)));
-#ifndef NDEBUG
-		}
-		catch(std::bad_any_cast &) {
-			assert(false && "type_index lookup should have guaranteed no std::bad_any_cast");
-			throw;
+		T *object = find<T>();
+		if (!object) {
+			throw std::out_of_range("slirc::util::component_map::at(): No object of the given type stored.");
 		}
-#endif
+		return *object;
 	}
 
 	/**
@@ -71,17 +128,52 @@ public:
 	 */
 	template<typename T>
 	std::add_const_t<T> &at() const {
-#ifndef NDEBUG
-		try {
-#endif
-			return std::any_cast<T&>(content_.at(typeid(std::decay_t<T>)));
-#ifndef NDEBUG
+		std::add_const_t<T> *object = find<T>();
+		if (!object) {
+			throw std::out_of_range("slirc::util::component_map::at(): No object of the given type stored.");
 		}
-		catch(std::bad_any_cast &) {
-			assert(false && "type_index lookup should have guaranteed no std::bad_any_cast");
-			throw;
+		return *object;
+	}
+
+	/**
+	 * \brief Looks up an element in the map
+	 * \tparam T The type to look up. This may be cv-qualified to change the type of pointer returned.
+	 * \return A pointer to the stored object or \c nullptr if no object of the given type is stored
+	 *
+	 * \note Unless \c T is const qualified, an inherited object is copied into the map first.
+	 */
+	template<typename T>
+	T *find() {
+		if constexpr (std::is_const_v<T>) {
+			return std::as_const(*this).template find<T>();
+		}
+		else {
+			using value_type = std::decay_t<T>;
+			const size_type index = index_of(typeid(value_type));
+			if (index != npos) {
+				return static_cast<value_type*>(slot_at(index).object);
+			}
+			const value_type *inherited = parent_ ? parent_->find<const value_type>() : nullptr;
+			return inherited ? &emplace<value_type>(*inherited) : nullptr;
 		}
-#endif
+	}
+
+	/**
+	 * \brief Looks up an element in the map
+	 * \tparam T The type to look up. This may be cv-qualified to change the type of pointer returned.
+	 *           (The const qualification is effectively ignored in this overload.)
+	 * \return A const pointer to the stored object or \c nullptr if no object of the given type is stored
+	 */
+	template<typename T>
+	std::add_const_t<T> *find() const noexcept {
+		const std::type_info &type = typeid(std::decay_t<T>);
+		for(const component_map *map = this; map; map = map->parent_) {
+			const size_type index = map->index_of(type);
+			if (index != npos) {
+				return static_cast<const std::decay_t<T>*>(map->slot_at(index).object);
+			}
+		}
+		return nullptr;
 	}
 
 	/**
@@ -90,12 +182,13 @@ public:
 	 * \tparam Args... The \c T constructor argument types.
 	 * \param args... The arguments passed to the \c T constructor.
 	 * \return A reference to the existing or newly inserted object.
+	 *
+	 * \note An inherited object is copied into the map instead of constructing a new one.
 	 */
 	template<typename T, typename... Args>
 	std::decay_t<T> &at_or_emplace(Args&&... args) {
-		return (content_.end() != content_.find(typeid(std::decay_t<T>)))
-			? at<T>()
-			: emplace<T>(std::forward<Args>(args)...);
+		std::decay_t<T> *object = find<std::decay_t<T>>();
+		return object ? *object : emplace<T>(std::forward<Args>(args)...);
 	};
 
 	/**
@@ -110,24 +203,47 @@ public:
 	 */
 	template<typename T, typename... Args>
 	std::decay_t<T> &emplace(Args&&... args) {
-		std::any temp_any;
-		std::any &map_any = content_[typeid(std::decay_t<T>)];
-		temp_any.swap(map_any);
+		using value_type = std::decay_t<T>;
+		const std::type_info &type = typeid(value_type);
 
-		try {
-			return map_any.emplace<std::decay_t<T>>(std::forward<Args>(args)...);
-		}
-		catch(...) {
-			if (temp_any.has_value()) {
-				// put old value back
-				temp_any.swap(map_any);
+		if (const size_type index = index_of(type); index != npos) {
+			// construct the new value first so the old one survives if that throws
+			slot &existing = slot_at(index);
+			if (!existing.object) {
+				// unmask the erased inherited object
+				value_type &object = construct<value_type>(existing, std::forward<Args>(args)...);
+				--masked_;
+				++size_;
+				return object;
+			}
+			else if constexpr (component_ops<value_type>::stored_inline) {
+				value_type temp(std::forward<Args>(args)...);
+				existing.ops->destroy(existing.object);
+				existing.object = ::new(static_cast<void*>(existing.storage)) value_type(std::move(temp));
 			}
 			else {
-				// old value was empty; remove from map
-				content_.erase(typeid(std::decay_t<T>));
+				value_type *object = new value_type(std::forward<Args>(args)...);
+				existing.ops->destroy(existing.object);
+				existing.object = object;
 			}
-			throw;
+			return *static_cast<value_type*>(existing.object);
 		}
+
+		for(size_type index = 0; index != inline_slots; ++index) {
+			if (!types_[index]) {
+				value_type &object = construct<value_type>(slots_[index], std::forward<Args>(args)...);
+				types_[index] = &type;
+				++size_;
+				return object;
+			}
+		}
+
+		overflow_.reserve(overflow_.size() + 1);
+		std::unique_ptr<slot> content = take_slot();
+		value_type &object = construct<value_type>(*content, std::forward<Args>(args)...);
+		overflow_.push_back(overflow_slot{ &type, std::move(content) });
+		++size_;
+		return object;
 	}
 
 	/**
@@ -165,32 +281,213 @@ public:
 	 *     - \c false if no object of the given type was stored,
 	 *     - \c true if an object was removed.
 	 * \post <tt>.at\<T\>()</tt> will throw
+	 *
+	 * \note Erasing an inherited object masks it in this map; the parent keeps it.
 	 */
 	template<typename T>
 	bool erase() {
-		content_.erase(typeid(std::decay_t<T>));
+		using value_type = std::decay_t<T>;
+		return erase_type(typeid(value_type), parent_ && parent_->find<const value_type>());
+	}
+
+	/**
+	 * \brief Removes all objects from the map and stops inheriting from its parent.
+	 *
+	 * Keeps the slots beyond \c inline_slots for the objects inserted next.
+	 *
+	 * \post <tt>empty()</tt>
+	 */
+	void clear() noexcept;
+
+	/**
+	 * \brief Makes the objects stored in another map visible through this map.
+	 *
+	 * Objects stored in this map take precedence over those of \c parent,
+	 * which in turn may inherit from another map. Objects are looked up in
+	 * \c parent on every access until they are copied into this map, so
+	 * later changes to \c parent are visible through this map as well.
+	 *
+	 * \param parent The map to inherit from. It must outlive this map or the
+	 *               next call to \c clear().
+	 */
+	void inherit(const component_map &parent) noexcept {
+		assert(&parent != this && "component_map cannot inherit from itself");
+		parent_ = &parent;
+	}
+
+	/**
+	 * \brief Fetches the map objects are inherited from.
+	 * \return The parent map or \c nullptr if this map doesn't inherit any objects.
+	 */
+	const component_map *parent() const noexcept {
+		return parent_;
 	}
 
 	/**
 	 * \brief Checks whether the \c component_map is empty.
 	 * \return
-	 *     - \c false if any objects are stored,
-	 *     - \c true if no objects are stored
+	 *     - \c false if any objects are stored or inherited,
+	 *     - \c true if no objects are stored or inherited
 	 */
 	bool empty() const {
-		return content_.empty();
+		return size() == 0;
 	}
 
 	/**
 	 * \brief Checks the number of elements stored in the \c component_map
-	 * \return The number of elements stored.
+	 * \return The number of elements stored or inherited.
 	 */
 	size_type size() const {
-		return content_.size();
+		return parent_ ? size_ + inherited_size() : size_;
 	}
 
 private:
-	underlying_type content_;
+	static constexpr size_type npos = static_cast<size_type>(-1);
+
+	struct slot;
+
+	/// \brief Type erased operations on a stored object
+	struct type_ops {
+		void (*copy)(slot &to, const void *from); ///< @brief Copy constructs \c *from into \c to
+		void (*move)(slot &to, slot &from) noexcept; ///< @brief Transfers the object stored in \c from into \c to
+		void (*destroy)(void *object) noexcept; ///< @brief Destroys an object and releases its storage
+	};
+
+	/// \brief Storage for a single object
+	struct slot {
+		const type_ops *ops; ///< @brief Operations for the stored object, \c nullptr for masked objects
+		void *object; ///< @brief The stored object, either in \c storage or separately allocated, \c nullptr for masked objects
+		alignas(std::max_align_t) unsigned char storage[inline_size]; ///< @brief Storage for small objects
+	};
+
+	/// \brief Separately allocated slot for objects beyond \c inline_slots
+	struct overflow_slot {
+		const std::type_info *type; ///< @brief The type of the stored object
+		std::unique_ptr<slot> content; ///< @brief The slot holding the object
+	};
+
+	template<typename T>
+	struct component_ops {
+		static constexpr bool stored_inline =
+			sizeof(T) <= inline_size &&
+			alignof(T) <= alignof(std::max_align_t) &&
+			std::is_nothrow_move_constructible_v<T>;
+
+		template<typename... Args>
+		static T *create(slot &target, Args&&... args) {
+			if constexpr (stored_inline) {
+				return ::new(static_cast<void*>(target.storage)) T(std::forward<Args>(args)...);
+			}
+			else {
+				return new T(std::forward<Args>(args)...);
+			}
+		}
+
+		static void copy(slot &to, const void *from) {
+			to.object = create(to, *static_cast<const T*>(from));
+			to.ops = &ops;
+		}
+
+		static void move(slot &to, slot &from) noexcept {
+			if constexpr (stored_inline) {
+				T &object = *static_cast<T*>(from.object);
+				to.object = ::new(static_cast<void*>(to.storage)) T(std::move(object));
+				object.~T();
+			}
+			else {
+				to.object = from.object;
+			}
+			to.ops = &ops;
+		}
+
+		static void destroy(void *object) noexcept {
+			if constexpr (stored_inline) {
+				static_cast<T*>(object)->~T();
+			}
+			else {
+				delete static_cast<T*>(object);
+			}
+		}
+
+		static constexpr type_ops ops{ &copy, &move, &destroy };
+	};
+
+	template<typename T, typename... Args>
+	static T &construct(slot &target, Args&&... args) {
+		T *object = component_ops<T>::create(target, std::forward<Args>(args)...);
+		target.object = object;
+		target.ops = &component_ops<T>::ops;
+		return *object;
+	}
+
+	/**
+	 * \brief Finds the slot holding an object of the given type
+	 * \param type The type to look up
+	 * \return
+	 *     - The index of the slot, with overflow slots following the inline slots, or
+	 *     - \c npos if no object of the given type is stored or masked.
+	 */
+	size_type index_of(const std::type_info &type) const noexcept {
+		if (size_ + masked_ == 0) {
+			return npos;
+		}
+		for(size_type index = 0; index != inline_slots; ++index) {
+			if (types_[index] == &type) {
+				return index;
+			}
+		}
+		for(size_type index = 0; index != overflow_.size(); ++index) {
+			if (overflow_[index].type == &type) {
+				return inline_slots + index;
+			}
+		}
+		return index_of_equivalent(type);
+	}
+
+	/**
+	 * \brief Finds the slot holding an object of the given type by comparing \c type_info
+	 *        objects instead of their addresses, for types whose \c type_info is not unique
+	 *        across shared libraries.
+	 * \param type The type to look up
+	 * \return The index of the slot or \c npos if no object of the given type is stored.
+	 */
+	size_type index_of_equivalent(const std::type_info &type) const noexcept;
+
+	slot &slot_at(size_type index) noexcept {
+		return (index < inline_slots) ? slots_[index] : *overflow_[index - inline_slots].content;
+	}
+
+	const slot &slot_at(size_type index) const noexcept {
+		return (index < inline_slots) ? slots_[index] : *overflow_[index - inline_slots].content;
+	}
+
+	/**
+	 * \brief Removes an object from the map.
+	 * \param type The type of the object to remove.
+	 * \param inherited Whether an object of the given type is inherited and has to be masked.
+	 * \return Whether an object was removed or masked.
+	 */
+	bool erase_type(const std::type_info &type, bool inherited);
+
+	void release_at(size_type index) noexcept;
+
+	/**
+	 * \brief Takes a slot for an object beyond \c inline_slots, reusing a spare one if possible.
+	 * \return An empty slot.
+	 */
+	std::unique_ptr<slot> take_slot();
+
+	size_type inherited_size() const noexcept;
+
+	void move_from(component_map &other) noexcept;
+
+	const std::type_info *types_[inline_slots] = {}; ///< @brief The types stored in the inline slots, \c nullptr for unused slots
+	slot slots_[inline_slots]; ///< @brief The inline slots
+	std::vector<overflow_slot> overflow_; ///< @brief Slots for objects beyond \c inline_slots
+	std::vector<std::unique_ptr<slot>> spare_slots_; ///< @brief Unused slots of erased objects beyond \c inline_slots, with room for every slot of \c overflow_ as well
+	size_type size_ = 0; ///< @brief The number of stored objects
+	size_type masked_ = 0; ///< @brief The number of slots masking erased inherited objects
+	const component_map *parent_ = nullptr; ///< @brief The map objects are inherited from
 };
 
 }
@@ -0,0 +1,81 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_CYCLE_CLOCK_HPP
+#define LIBSLIRC_CYCLE_CLOCK_HPP
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define LIBSLIRC_HAS_RDTSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define LIBSLIRC_HAS_RDTSC
+#endif
+
+namespace slirc::util {
+
+/**
+ * \brief A cheap clock for measuring short durations.
+ *
+ * Reads the time stamp counter where available and falls back to
+ * <tt>std::chrono::steady_clock</tt> otherwise. Ticks have no fixed unit, use
+ * \c ticks_per_second() to convert them.
+ */
+struct cycle_clock {
+	using tick_type = std::uint64_t; ///< @brief Type of points in time
+
+	/**
+	 * \brief Reads the clock.
+	 * \return The current tick.
+	 */
+	static tick_type now() noexcept {
+#ifdef LIBSLIRC_HAS_RDTSC
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()
+		).count();
+#endif
+	}
+
+	/**
+	 * \brief Estimates the clock frequency.
+	 *
+	 * The first call measures the clock against
+	 * <tt>std::chrono::steady_clock</tt> for a few milliseconds; the result is
+	 * cached afterwards.
+	 *
+	 * \return The number of ticks per second.
+	 */
+	static double ticks_per_second();
+};
+
+}
+
+#endif //LIBSLIRC_CYCLE_CLOCK_HPP
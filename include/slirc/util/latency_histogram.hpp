@@ -0,0 +1,175 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_LATENCY_HISTOGRAM_HPP
+#define LIBSLIRC_LATENCY_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace slirc::util {
+
+/**
+ * \brief A histogram of durations with a bounded relative error.
+ *
+ * Values are sorted into log-linear buckets (as in HDR histograms): Each power
+ * of two is split into 8 buckets of equal width, so any recorded value is
+ * reported with an error of at most 12.5%, using a fixed amount of memory.
+ *
+ * Recording a value is two relaxed loads and stores. Concurrent recording is
+ * safe, but may lose some counts; reading while recording yields a slightly
+ * stale but otherwise consistent enough view for profiling.
+ */
+class latency_histogram {
+public:
+	using value_type = std::uint64_t; ///< @brief Type of recorded values
+
+	latency_histogram() noexcept
+	: buckets_()
+	, sum_(0) {}
+
+	latency_histogram(const latency_histogram &other) noexcept
+	: latency_histogram() {
+		*this = other;
+	}
+
+	latency_histogram &operator=(const latency_histogram &other) noexcept {
+		for(std::size_t i = 0; i != bucket_count; ++i) {
+			buckets_[i].store(other.buckets_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		sum_.store(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return *this;
+	}
+
+	/**
+	 * \brief Records a value.
+	 * \param value The value to record.
+	 */
+	void record(value_type value) noexcept {
+		auto &bucket = buckets_[bucket_of(value)];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	/**
+	 * \brief Checks the number of recorded values.
+	 * \return The number of recorded values.
+	 */
+	std::uint64_t count() const noexcept {
+		std::uint64_t retval = 0;
+		for(const auto &bucket: buckets_) {
+			retval += bucket.load(std::memory_order_relaxed);
+		}
+		return retval;
+	}
+
+	/**
+	 * \brief Checks the sum of all recorded values.
+	 * \return The sum of all recorded values.
+	 */
+	value_type sum() const noexcept {
+		return sum_.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * \brief Estimates a percentile of the recorded values.
+	 * \param percentile The percentile to look up, from \c 0 to \c 100.
+	 * \return The upper bound of the bucket containing the percentile, or
+	 *         \c 0 if no values were recorded.
+	 */
+	value_type percentile(double percentile) const noexcept {
+		const std::uint64_t total = count();
+		if (total == 0) {
+			return 0;
+		}
+
+		std::uint64_t rank = static_cast<std::uint64_t>(percentile / 100 * total + 0.5);
+		rank = (rank == 0) ? 1 : (rank > total) ? total : rank;
+
+		std::uint64_t seen = 0;
+		for(std::size_t i = 0; i != bucket_count; ++i) {
+			seen += buckets_[i].load(std::memory_order_relaxed);
+			if (seen >= rank) {
+				return upper_bound_of(i);
+			}
+		}
+		return upper_bound_of(bucket_count - 1);
+	}
+
+	/**
+	 * \brief Checks the largest recorded value.
+	 * \return The upper bound of the highest non-empty bucket, or \c 0 if no
+	 *         values were recorded.
+	 */
+	value_type max() const noexcept {
+		for(std::size_t i = bucket_count; i != 0; --i) {
+			if (buckets_[i - 1].load(std::memory_order_relaxed) != 0) {
+				return upper_bound_of(i - 1);
+			}
+		}
+		return 0;
+	}
+
+private:
+	static constexpr unsigned sub_bucket_bits = 3;
+	static constexpr unsigned sub_bucket_count = 1u << sub_bucket_bits;
+	// values below sub_bucket_count get a bucket each, every higher power of two gets sub_bucket_count
+	static constexpr std::size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+	static unsigned highest_bit(value_type value) noexcept {
+		unsigned bit = 0;
+		while(value >>= 1) {
+			++bit;
+		}
+		return bit;
+	}
+
+	static std::size_t bucket_of(value_type value) noexcept {
+		if (value < sub_bucket_count) {
+			return static_cast<std::size_t>(value);
+		}
+		const unsigned exponent = highest_bit(value);
+		const unsigned shift = exponent - sub_bucket_bits;
+		return (shift + 1) * sub_bucket_count + ((value >> shift) & (sub_bucket_count - 1));
+	}
+
+	static value_type upper_bound_of(std::size_t bucket) noexcept {
+		if (bucket < sub_bucket_count) {
+			return bucket;
+		}
+		const unsigned shift = static_cast<unsigned>(bucket / sub_bucket_count) - 1;
+		const value_type lower = (value_type(sub_bucket_count + bucket % sub_bucket_count)) << shift;
+		return lower + ((value_type(1) << shift) - 1);
+	}
+
+	std::array<std::atomic<std::uint64_t>, bucket_count> buckets_;
+	std::atomic<value_type> sum_;
+};
+
+}
+
+#endif //LIBSLIRC_LATENCY_HISTOGRAM_HPP
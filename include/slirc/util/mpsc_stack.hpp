@@ -0,0 +1,183 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_MPSC_STACK_HPP
+#define LIBSLIRC_MPSC_STACK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace slirc::util {
+
+/**
+ * \brief A lock-free multi-producer, single-consumer stack.
+ *
+ * Any number of threads may push onto the stack concurrently. Consumption
+ * always detaches the whole content of the stack at once, so there is no
+ * point where a node could be popped and pushed again while a producer still
+ * looks at it (no ABA problem).
+ *
+ * \warning Only one thread at a time may call \c consume_all().
+ */
+template<typename T>
+class mpsc_stack {
+	struct node {
+		T value;
+		node *next;
+	};
+
+public:
+	using value_type = T; ///< @brief Type of the stored elements
+	using size_type = std::size_t; ///< @brief Size type
+
+	/**
+	 * \brief Creates an empty stack
+	 */
+	mpsc_stack()
+	: head_(nullptr) {}
+
+	mpsc_stack(const mpsc_stack &) = delete;
+	mpsc_stack &operator=(const mpsc_stack &) = delete;
+
+	/**
+	 * \brief Destroys the stack and all elements still stored in it.
+	 */
+	~mpsc_stack() {
+		release(head_.load());
+	}
+
+	/**
+	 * \brief Constructs an element on top of the stack.
+	 * \tparam Args... The \c T constructor argument types.
+	 * \param args... The arguments passed to the \c T constructor.
+	 * \note This function is lock-free and may be called concurrently.
+	 */
+	template<typename... Args>
+	void emplace(Args&&... args) {
+		node * const new_node = new node{ T(std::forward<Args>(args)...), head_.load(std::memory_order_relaxed) };
+		while(!head_.compare_exchange_weak(new_node->next, new_node)) {}
+	}
+
+	/**
+	 * \brief Pushes an element on top of the stack.
+	 * \param value The element to push.
+	 * \note This function is lock-free and may be called concurrently.
+	 */
+	void push(T value) {
+		emplace(std::move(value));
+	}
+
+	/**
+	 * \brief Pushes a range of elements on top of the stack.
+	 *
+	 * The elements are pushed in a single atomic operation, so consumers will
+	 * either see all or none of them.
+	 *
+	 * \tparam InputIterator The input iterator type.
+	 * \param first The begin of the range to push.
+	 * \param last The end of the range to push.
+	 * \note This function is lock-free and may be called concurrently.
+	 */
+	template<typename InputIterator>
+	void push_range(InputIterator first, InputIterator last) {
+		if (first == last) {
+			return;
+		}
+
+		node * const bottom = new node{ T(*first), nullptr };
+		node *top = bottom;
+		try {
+			while(++first != last) {
+				top = new node{ T(*first), top };
+			}
+		}
+		catch(...) {
+			release(top);
+			throw;
+		}
+
+		bottom->next = head_.load(std::memory_order_relaxed);
+		while(!head_.compare_exchange_weak(bottom->next, top)) {}
+	}
+
+	/**
+	 * \brief Checks whether the stack is empty
+	 * \return
+	 *     - \c false if the stack contains any items,
+	 *     - \c true if the stack is empty
+	 */
+	bool empty() const noexcept {
+		return head_.load() == nullptr;
+	}
+
+	/**
+	 * \brief Removes all elements from the stack.
+	 * \tparam Func The consumer type; must be callable as <tt>f(T &&)</tt>.
+	 * \param f The consumer. Will be called once for every element, in the
+	 *          order the elements were pushed (oldest first).
+	 * \return The number of elements consumed.
+	 * \note If \c f throws, all elements not yet passed to it are destroyed.
+	 */
+	template<typename Func>
+	size_type consume_all(Func &&f) {
+		node *ordered = nullptr;
+		for(node *list = head_.exchange(nullptr); list; ) {
+			node * const next = list->next;
+			list->next = ordered;
+			ordered = list;
+			list = next;
+		}
+
+		size_type consumed = 0;
+		try {
+			for(; ordered; ++consumed) {
+				f(std::move(ordered->value));
+				delete std::exchange(ordered, ordered->next);
+			}
+		}
+		catch(...) {
+			release(ordered);
+			throw;
+		}
+		return consumed;
+	}
+
+private:
+	static void release(node *list) noexcept {
+		while(list) {
+			node * const next = list->next;
+			delete list;
+			list = next;
+		}
+	}
+
+	std::atomic<node*> head_;
+};
+
+}
+
+#endif //LIBSLIRC_MPSC_STACK_HPP
@@ -0,0 +1,238 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_RCU_PTR_HPP
+#define LIBSLIRC_RCU_PTR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace slirc::util {
+
+namespace detail {
+	/// \brief Gets the reader stripe of the calling thread, assigned in turn on first use.
+	inline std::size_t rcu_reader_stripe() noexcept {
+		static std::atomic<std::size_t> next_stripe(0);
+		thread_local const std::size_t stripe = next_stripe++;
+		return stripe;
+	}
+}
+
+/**
+ * \brief A pointer to an immutable object that can be read without locking.
+ *
+ * Readers access the current object through a \c read_guard. Writers never
+ * modify the object in place, but publish a modified copy instead (read,
+ * copy, update). Replaced objects are retired and destroyed once no reader is
+ * active anymore, so a reader may keep using the object it started with for
+ * as long as it holds its guard.
+ *
+ * Readers count themselves per epoch in one of several cache line sized
+ * stripes, picked by thread, so reading is wait-free and threads reading
+ * concurrently do not share a counter. An object retired in an epoch is
+ * destroyed once the epoch advanced twice, which only waits for the readers
+ * that started before it was retired; readers starting later never hold it
+ * up. Writers are serialized by a mutex and copy the whole object, so this is
+ * meant for data that is read a lot more often than it is written.
+ */
+template<typename T>
+class rcu_ptr {
+	struct alignas(64) reader_stripe {
+		std::atomic<std::size_t> readers[2] = { 0, 0 }; ///< @brief Active readers, indexed by the parity of their epoch
+	};
+	static constexpr std::size_t reader_stripes = 16;
+
+public:
+	using element_type = T; ///< @brief Type of the stored object
+
+	/// @brief Keeps the object current at construction time alive.
+	class read_guard {
+	public:
+		explicit read_guard(const rcu_ptr &owner) noexcept
+		: owner_(&owner)
+		, readers_(nullptr) {
+			reader_stripe &stripe = owner_->stripes_[detail::rcu_reader_stripe() % reader_stripes];
+			// counted in the epoch current after counting, so the epoch can
+			// not advance twice while this reader holds the object
+			for(;;) {
+				const std::uint64_t epoch = owner_->epoch_.load();
+				readers_ = &stripe.readers[epoch & 1];
+				++*readers_;
+				if (owner_->epoch_.load() == epoch) {
+					break;
+				}
+				--*readers_;
+			}
+			value_ = owner_->current_.load();
+		}
+
+		read_guard(const read_guard &) = delete;
+		read_guard &operator=(const read_guard &) = delete;
+
+		~read_guard() {
+			--*readers_;
+			if (owner_->has_retired_.load(std::memory_order_relaxed)) {
+				owner_->collect();
+			}
+		}
+
+		const T &operator*() const noexcept { return *value_; }
+		const T *operator->() const noexcept { return value_; }
+		const T *get() const noexcept { return value_; }
+
+	private:
+		const rcu_ptr *owner_;
+		std::atomic<std::size_t> *readers_;
+		const T *value_;
+	};
+
+	/**
+	 * \brief Creates a pointer to an object.
+	 * \param args... The arguments passed to the \c T constructor.
+	 */
+	template<typename... Args>
+	explicit rcu_ptr(Args&&... args)
+	: write_mutex_()
+	, current_(new T(std::forward<Args>(args)...))
+	, epoch_(0)
+	, stripes_()
+	, has_retired_(false)
+	, retired_() {}
+
+	rcu_ptr(const rcu_ptr &) = delete;
+	rcu_ptr &operator=(const rcu_ptr &) = delete;
+
+	/**
+	 * \brief Destroys the pointer along with the current and all retired objects.
+	 * \pre No reader is active.
+	 */
+	~rcu_ptr() {
+		delete current_.load();
+	}
+
+	/**
+	 * \brief Starts reading the current object.
+	 * \return A guard keeping the current object alive.
+	 * \note This function is lock-free and may be called concurrently.
+	 */
+	read_guard read() const noexcept {
+		return read_guard(*this);
+	}
+
+	/**
+	 * \brief Publishes a modified copy of the current object.
+	 * \tparam Func The updater type; must be callable as <tt>f(T &)</tt>.
+	 * \param f Called with a copy of the current object, which is published
+	 *          once \c f returns. If \c f throws, nothing is published.
+	 * \note Concurrent updates are serialized.
+	 */
+	template<typename Func>
+	void update(Func &&f) {
+		std::vector<retired_object> reclaimed;
+		std::lock_guard<std::mutex> lock(write_mutex_);
+		auto replacement = std::make_unique<T>(*current_.load());
+		f(*replacement);
+		retired_.reserve(retired_.size() + 1);
+		reclaimed.reserve(retired_.size() + 1);
+
+		// Readers load the pointer after counting themselves in the epoch,
+		// so anyone still using the old object counts in this epoch or the
+		// one before.
+		T * const retired = current_.exchange(replacement.release());
+		retired_.push_back({ epoch_.load(), std::unique_ptr<T>(retired) });
+		has_retired_ = true;
+		collect_locked(reclaimed);
+	}
+
+private:
+	struct retired_object {
+		std::uint64_t epoch; ///< @brief The epoch the object was retired in
+		std::unique_ptr<T> object;
+	};
+
+	void collect() const noexcept {
+		std::vector<retired_object> reclaimed;
+		std::unique_lock<std::mutex> lock(write_mutex_, std::try_to_lock);
+		if (lock.owns_lock()) {
+			try {
+				reclaimed.reserve(retired_.size());
+			}
+			catch(...) {
+				// left to the next reader or writer
+				return;
+			}
+			collect_locked(reclaimed);
+		}
+	}
+
+	/**
+	 * \brief Moves the retired objects no reader may use anymore to \c reclaimed.
+	 *
+	 * They are destroyed by the caller once it released \c write_mutex_, so
+	 * their destructors may use this pointer again.
+	 *
+	 * \param reclaimed Receives the objects; must have room for all of them.
+	 */
+	void collect_locked(std::vector<retired_object> &reclaimed) const noexcept {
+		// Readers of the epoch before the current one share their counters
+		// with the next epoch, which can begin once they are done.
+		for(int advanced = 0; advanced != 2 && !has_readers((epoch_ + 1) & 1); ++advanced) {
+			++epoch_;
+		}
+
+		const std::uint64_t epoch = epoch_;
+		const auto still_used = std::partition(retired_.begin(), retired_.end(), [&](const retired_object &retired) {
+			return epoch - retired.epoch < 2;
+		});
+		std::move(still_used, retired_.end(), std::back_inserter(reclaimed));
+		retired_.erase(still_used, retired_.end());
+		has_retired_ = !retired_.empty();
+	}
+
+	bool has_readers(std::uint64_t parity) const noexcept {
+		return std::any_of(std::begin(stripes_), std::end(stripes_), [&](const reader_stripe &stripe) {
+			return stripe.readers[parity] != 0;
+		});
+	}
+
+	mutable std::mutex write_mutex_;
+	std::atomic<T *> current_;
+	mutable std::atomic<std::uint64_t> epoch_;
+	mutable reader_stripe stripes_[reader_stripes];
+	mutable std::atomic<bool> has_retired_;
+	mutable std::vector<retired_object> retired_;
+};
+
+}
+
+#endif //LIBSLIRC_RCU_PTR_HPP
@@ -0,0 +1,441 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_SMALL_RING_HPP
+#define LIBSLIRC_SMALL_RING_HPP
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace slirc::util {
+
+/**
+ * \brief A double-ended queue storing up to \c InlineCapacity elements inline.
+ *
+ * Elements are kept in a ring buffer, so pushing and popping at either end
+ * takes constant time and never moves other elements. The ring starts out in
+ * storage embedded in the object and moves to a heap buffer of twice the size
+ * whenever it runs full. Heap buffers are kept until destruction, also when
+ * the ring is cleared or moved from.
+ *
+ * \tparam T The element type.
+ * \tparam InlineCapacity The number of elements stored without allocating.
+ *                        Must be a power of two.
+ */
+template<typename T, std::size_t InlineCapacity>
+class small_ring {
+	static_assert(InlineCapacity != 0 && (InlineCapacity & (InlineCapacity - 1)) == 0, "InlineCapacity must be a power of two.");
+
+	template<bool Const>
+	class basic_iterator {
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = std::conditional_t<Const, const T *, T *>;
+		using reference = std::conditional_t<Const, const T &, T &>;
+
+		basic_iterator() noexcept
+		: ring_(nullptr)
+		, index_(0) {}
+
+		template<bool OtherConst, typename=std::enable_if_t<Const && !OtherConst>>
+		basic_iterator(const basic_iterator<OtherConst> &other) noexcept
+		: ring_(other.ring_)
+		, index_(other.index_) {}
+
+		reference operator*() const noexcept { return (*ring_)[index_]; }
+		pointer operator->() const noexcept { return &(*ring_)[index_]; }
+		reference operator[](difference_type n) const noexcept { return (*ring_)[index_ + n]; }
+
+		basic_iterator &operator++() noexcept { ++index_; return *this; }
+		basic_iterator &operator--() noexcept { --index_; return *this; }
+		basic_iterator operator++(int) noexcept { basic_iterator retval(*this); ++index_; return retval; }
+		basic_iterator operator--(int) noexcept { basic_iterator retval(*this); --index_; return retval; }
+		basic_iterator &operator+=(difference_type n) noexcept { index_ += n; return *this; }
+		basic_iterator &operator-=(difference_type n) noexcept { index_ -= n; return *this; }
+
+		friend basic_iterator operator+(basic_iterator it, difference_type n) noexcept { return it += n; }
+		friend basic_iterator operator+(difference_type n, basic_iterator it) noexcept { return it += n; }
+		friend basic_iterator operator-(basic_iterator it, difference_type n) noexcept { return it -= n; }
+		friend difference_type operator-(const basic_iterator &lhs, const basic_iterator &rhs) noexcept {
+			return static_cast<difference_type>(lhs.index_) - static_cast<difference_type>(rhs.index_);
+		}
+
+		friend bool operator==(const basic_iterator &lhs, const basic_iterator &rhs) noexcept { return lhs.index_ == rhs.index_; }
+		friend bool operator!=(const basic_iterator &lhs, const basic_iterator &rhs) noexcept { return lhs.index_ != rhs.index_; }
+		friend bool operator<(const basic_iterator &lhs, const basic_iterator &rhs) noexcept { return lhs.index_ < rhs.index_; }
+		friend bool operator>(const basic_iterator &lhs, const basic_iterator &rhs) noexcept { return lhs.index_ > rhs.index_; }
+		friend bool operator<=(const basic_iterator &lhs, const basic_iterator &rhs) noexcept { return lhs.index_ <= rhs.index_; }
+		friend bool operator>=(const basic_iterator &lhs, const basic_iterator &rhs) noexcept { return lhs.index_ >= rhs.index_; }
+
+	private:
+		friend class small_ring;
+
+		template<bool>
+		friend class basic_iterator;
+
+		using ring_type = std::conditional_t<Const, const small_ring, small_ring>;
+
+		basic_iterator(ring_type *ring, std::size_t index) noexcept
+		: ring_(ring)
+		, index_(index) {}
+
+		ring_type *ring_;
+		std::size_t index_;
+	};
+
+public:
+	using value_type = T; ///< @brief Type of the stored elements
+	using size_type = std::size_t; ///< @brief Size type
+	using difference_type = std::ptrdiff_t; ///< @brief Iterator difference type
+	using reference = T &; ///< @brief Element reference type
+	using const_reference = const T &; ///< @brief Constant element reference type
+	using iterator = basic_iterator<false>; ///< @brief Iterator type
+	using const_iterator = basic_iterator<true>; ///< @brief Constant iterator type
+	using reverse_iterator = std::reverse_iterator<iterator>; ///< @brief Reverse iterator type
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>; ///< @brief Constant reverse iterator type
+
+	static constexpr size_type inline_capacity = InlineCapacity; ///< @brief Number of elements stored without allocating
+
+	/**
+	 * \brief Creates an empty ring.
+	 */
+	small_ring() noexcept
+	: data_(inline_data())
+	, capacity_(InlineCapacity)
+	, head_(0)
+	, size_(0) {}
+
+	small_ring(const small_ring &other)
+	: small_ring() {
+		reserve(other.size_);
+		for(const T &value: other) {
+			emplace_back(value);
+		}
+	}
+
+	small_ring(small_ring &&other) noexcept(std::is_nothrow_move_constructible_v<T>)
+	: small_ring() {
+		take(other);
+	}
+
+	small_ring &operator=(const small_ring &other) {
+		if (this != &other) {
+			clear();
+			reserve(other.size_);
+			for(const T &value: other) {
+				emplace_back(value);
+			}
+		}
+		return *this;
+	}
+
+	small_ring &operator=(small_ring &&other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+		if (this != &other) {
+			clear();
+			take(other);
+		}
+		return *this;
+	}
+
+	~small_ring() {
+		clear();
+		if (data_ != inline_data()) {
+			::operator delete(data_);
+		}
+	}
+
+	iterator begin() noexcept { return iterator(this, 0); }
+	iterator end() noexcept { return iterator(this, size_); }
+	const_iterator begin() const noexcept { return cbegin(); }
+	const_iterator end() const noexcept { return cend(); }
+	const_iterator cbegin() const noexcept { return const_iterator(this, 0); }
+	const_iterator cend() const noexcept { return const_iterator(this, size_); }
+	reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+	reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+	const_reverse_iterator rbegin() const noexcept { return crbegin(); }
+	const_reverse_iterator rend() const noexcept { return crend(); }
+	const_reverse_iterator crbegin() const noexcept { return const_reverse_iterator(cend()); }
+	const_reverse_iterator crend() const noexcept { return const_reverse_iterator(cbegin()); }
+
+	/**
+	 * \brief Accesses an element.
+	 * \param index The position of the element, counted from the front.
+	 * \return A reference to the element.
+	 * \pre <tt>index < size()</tt>
+	 */
+	reference operator[](size_type index) noexcept {
+		assert(index < size_ && "index out of range");
+		return data_[(head_ + index) & (capacity_ - 1)];
+	}
+
+	/**
+	 * \brief Accesses an element.
+	 * \param index The position of the element, counted from the front.
+	 * \return A reference to the element.
+	 * \pre <tt>index < size()</tt>
+	 */
+	const_reference operator[](size_type index) const noexcept {
+		assert(index < size_ && "index out of range");
+		return data_[(head_ + index) & (capacity_ - 1)];
+	}
+
+	reference front() noexcept { return (*this)[0]; }
+	const_reference front() const noexcept { return (*this)[0]; }
+	reference back() noexcept { return (*this)[size_ - 1]; }
+	const_reference back() const noexcept { return (*this)[size_ - 1]; }
+
+	/**
+	 * \brief Checks whether the ring is empty.
+	 * \return
+	 *     - \c false if the ring contains any elements,
+	 *     - \c true if the ring is empty
+	 */
+	bool empty() const noexcept { return size_ == 0; }
+
+	/**
+	 * \brief Checks the number of stored elements.
+	 * \return The number of elements in the ring.
+	 */
+	size_type size() const noexcept { return size_; }
+
+	/**
+	 * \brief Checks how many elements fit into the ring without allocating.
+	 * \return The capacity of the current buffer.
+	 */
+	size_type capacity() const noexcept { return capacity_; }
+
+	/**
+	 * \brief Grows the buffer to fit at least \c capacity elements.
+	 * \param capacity The number of elements to make room for.
+	 */
+	void reserve(size_type capacity) {
+		size_type new_capacity = capacity_;
+		while(new_capacity < capacity) {
+			new_capacity *= 2;
+		}
+		if (new_capacity != capacity_) {
+			reallocate(new_capacity);
+		}
+	}
+
+	/**
+	 * \brief Removes all elements, keeping the buffer.
+	 */
+	void clear() noexcept {
+		while(size_ != 0) {
+			pop_back();
+		}
+		head_ = 0;
+	}
+
+	/**
+	 * \brief Constructs an element at the end of the ring.
+	 * \tparam Args... The \c T constructor argument types.
+	 * \param args... The arguments passed to the \c T constructor.
+	 * \return A reference to the new element.
+	 */
+	template<typename... Args>
+	reference emplace_back(Args&&... args) {
+		if (size_ == capacity_) {
+			// args may refer to an element of this ring
+			T value(std::forward<Args>(args)...);
+			reallocate(capacity_ * 2);
+			return *::new(static_cast<void *>(slot(size_++))) T(std::move(value));
+		}
+		return *::new(static_cast<void *>(slot(size_++))) T(std::forward<Args>(args)...);
+	}
+
+	/**
+	 * \brief Constructs an element at the front of the ring.
+	 * \tparam Args... The \c T constructor argument types.
+	 * \param args... The arguments passed to the \c T constructor.
+	 * \return A reference to the new element.
+	 */
+	template<typename... Args>
+	reference emplace_front(Args&&... args) {
+		if (size_ == capacity_) {
+			// args may refer to an element of this ring
+			T value(std::forward<Args>(args)...);
+			reallocate(capacity_ * 2);
+			return construct_front(std::move(value));
+		}
+		return construct_front(std::forward<Args>(args)...);
+	}
+
+	void push_back(const T &value) { emplace_back(value); }
+	void push_back(T &&value) { emplace_back(std::move(value)); }
+	void push_front(const T &value) { emplace_front(value); }
+	void push_front(T &&value) { emplace_front(std::move(value)); }
+
+	/**
+	 * \brief Removes the last element.
+	 * \pre <tt>!empty()</tt>
+	 */
+	void pop_back() noexcept {
+		assert(size_ != 0 && "needs to contain an element to pop");
+		slot(--size_)->~T();
+	}
+
+	/**
+	 * \brief Removes the first element.
+	 * \pre <tt>!empty()</tt>
+	 */
+	void pop_front() noexcept {
+		assert(size_ != 0 && "needs to contain an element to pop");
+		data_[head_].~T();
+		head_ = (head_ + 1) & (capacity_ - 1);
+		--size_;
+	}
+
+	/**
+	 * \brief Constructs an element in front of \c pos.
+	 * \return An iterator to the new element.
+	 * \post Invalidates all iterators
+	 */
+	template<typename... Args>
+	iterator emplace(const_iterator pos, Args&&... args) {
+		const size_type index = pos.index_;
+		emplace_back(std::forward<Args>(args)...);
+		std::rotate(begin() + index, end() - 1, end());
+		return begin() + index;
+	}
+
+	iterator insert(const_iterator pos, const T &value) { return emplace(pos, value); }
+	iterator insert(const_iterator pos, T &&value) { return emplace(pos, std::move(value)); }
+
+	/**
+	 * \brief Removes an element.
+	 * \return An iterator to the element following the removed one.
+	 * \post Invalidates all iterators
+	 */
+	iterator erase(const_iterator pos) {
+		return erase(pos, pos + 1);
+	}
+
+	/**
+	 * \brief Removes the elements in <tt>[first, last)</tt>.
+	 * \return An iterator to the element following the removed ones.
+	 * \post Invalidates all iterators
+	 */
+	iterator erase(const_iterator first, const_iterator last) {
+		const size_type index = first.index_;
+		const size_type count = last.index_ - first.index_;
+		if (count == 0) {
+			return begin() + index;
+		}
+		std::move(begin() + last.index_, end(), begin() + index);
+		for(size_type i = 0; i != count; ++i) {
+			pop_back();
+		}
+		return begin() + index;
+	}
+
+private:
+	T *inline_data() noexcept {
+		return reinterpret_cast<T *>(inline_storage_);
+	}
+
+	T *slot(size_type index) noexcept {
+		return data_ + ((head_ + index) & (capacity_ - 1));
+	}
+
+	template<typename... Args>
+	reference construct_front(Args&&... args) {
+		const size_type new_head = (head_ - 1) & (capacity_ - 1);
+		T &retval = *::new(static_cast<void *>(data_ + new_head)) T(std::forward<Args>(args)...);
+		head_ = new_head;
+		++size_;
+		return retval;
+	}
+
+	void reallocate(size_type new_capacity) {
+		T * const new_data = static_cast<T *>(::operator new(new_capacity * sizeof(T)));
+		size_type moved = 0;
+		try {
+			for(; moved != size_; ++moved) {
+				::new(static_cast<void *>(new_data + moved)) T(std::move_if_noexcept((*this)[moved]));
+			}
+		}
+		catch(...) {
+			while(moved != 0) {
+				new_data[--moved].~T();
+			}
+			::operator delete(new_data);
+			throw;
+		}
+
+		for(size_type i = 0; i != size_; ++i) {
+			(*this)[i].~T();
+		}
+		if (data_ != inline_data()) {
+			::operator delete(data_);
+		}
+		data_ = new_data;
+		capacity_ = new_capacity;
+		head_ = 0;
+	}
+
+	// requires this ring to be empty
+	void take(small_ring &other) {
+		if (other.data_ != other.inline_data()) {
+			if (data_ != inline_data()) {
+				::operator delete(data_);
+			}
+			data_ = other.data_;
+			capacity_ = other.capacity_;
+			head_ = other.head_;
+			size_ = other.size_;
+			other.data_ = other.inline_data();
+			other.capacity_ = InlineCapacity;
+			other.head_ = 0;
+			other.size_ = 0;
+		}
+		else {
+			for(T &value: other) {
+				emplace_back(std::move(value));
+			}
+			other.clear();
+		}
+	}
+
+	T *data_;
+	size_type capacity_;
+	size_type head_;
+	size_type size_;
+	alignas(T) unsigned char inline_storage_[sizeof(T) * InlineCapacity];
+};
+
+}
+
+#endif //LIBSLIRC_SMALL_RING_HPP
@@ -28,33 +28,53 @@
 #define LIBSLIRC_SPIN_LOCK_HPP
 
 #include <atomic>
+#include <cstdint>
 
 namespace slirc::util {
 
-/// @brief A spin lock
+/**
+ * @brief An adaptive lock, spinning briefly before parking the thread
+ *
+ * Locking first spins on a plain load of the lock state, with exponential
+ * backoff between the loads and a CPU pause hint while backing off. Once
+ * \c spin_limit pause hints are exceeded, or another thread is already
+ * parked, the thread is parked on the lock state (using \c std::atomic::wait
+ * where available, a futex on Linux or a condition variable elsewhere) until
+ * the lock is released.
+ *
+ * Uncontended locking and unlocking takes a single atomic operation each.
+ */
 class spin_lock {
+public:
+	static constexpr unsigned spin_limit = 64; ///< @brief Maximum pause hints per backoff round before parking the thread
+
 	/**
 	 * \brief Creates a spin lock
 	 */
-	spin_lock();
+	spin_lock() noexcept;
 	spin_lock(spin_lock&) = delete;
 
 	/**
-	 * \brief Locks the spin lock. Will yield the thread until locking succeeds.
+	 * \brief Locks the spin lock. Will spin and then park the thread until locking succeeds.
 	 * \pre The spin lock is not locked by the calling thread
 	 * \post The spin lock is locked by the calling thread
 	 */
-	void lock() noexcept;
+	void lock() noexcept {
+		std::uint32_t expected = unlocked;
+		if (!state_.compare_exchange_strong(expected, locked, std::memory_order_acquire, std::memory_order_relaxed)) {
+			lock_contended();
+		}
+	}
 
 	/**
-	 * \brief Unlocks the spin lock
+	 * \brief Unlocks the spin lock, waking a parked thread if there is any.
 	 * \pre The spin lock is locked by the calling thread
 	 * \post The spin lock is not locked by the calling thread
 	 */
 	void unlock() noexcept;
 
 	/**
-	 * \brief Unlocks the spin lock
+	 * \brief Tries to lock the spin lock without waiting
 	 * \return
 	 *     - \c false if locking the spin lock failed,
 	 *     - \c true if the spin lock was successfully locked
@@ -63,20 +83,21 @@ class spin_lock {
 	 *     - When returning \c false: The spin lock is not locked by the calling thread
 	 *     - When returning \c true: The spin lock is locked by the calling thread
 	 */
-	bool try_lock() noexcept;
+	bool try_lock() noexcept {
+		std::uint32_t expected = unlocked;
+		return state_.compare_exchange_strong(expected, locked, std::memory_order_acquire, std::memory_order_relaxed);
+	}
 
-	/**
-	 * \brief Posts the event to the front of irc IRC contexts event queue.
-	 */
-	void post_front() const;
+private:
+	enum: std::uint32_t {
+		unlocked = 0, ///< @brief The lock is not held
+		locked = 1, ///< @brief The lock is held and no thread is parked on it
+		locked_parked = 2 ///< @brief The lock is held and threads may be parked on it
+	};
 
-	/**
-	 * \brief Posts the event to the front of irc IRC contexts event queue.
-	 */
-	void post_back() const;
+	void lock_contended() noexcept;
 
-private:
-	std::atomic<bool> locked_;
+	std::atomic<std::uint32_t> state_;
 };
 
 }
@@ -0,0 +1,368 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+/// @author Simon Stienen
+/// @file
+
+#ifndef LIBSLIRC_TIMER_WHEEL_HPP
+#define LIBSLIRC_TIMER_WHEEL_HPP
+
+#include <cassert>
+#include <cstdint>
+
+#include <array>
+#include <chrono>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace slirc::util {
+
+/// \brief Identifies a timer in a \c timer_wheel.
+struct timer_handle {
+	std::uint32_t index = std::numeric_limits<std::uint32_t>::max(); ///< @brief Internal use only
+	std::uint32_t generation = 0; ///< @brief Internal use only
+
+	/**
+	 * \brief Checks whether the handle refers to a timer at all.
+	 * \return
+	 *     - \c false for default constructed handles,
+	 *     - \c true for handles returned by \c timer_wheel::insert()
+	 */
+	explicit operator bool() const noexcept {
+		return index != std::numeric_limits<std::uint32_t>::max();
+	}
+};
+
+/**
+ * \brief Converts a deadline into a millisecond tick, rounding up.
+ * \param epoch The point in time tick \c 0 refers to.
+ * \param deadline The point in time to convert.
+ * \return The first tick not before \c deadline.
+ */
+inline std::uint64_t timer_tick_until(std::chrono::steady_clock::time_point epoch, std::chrono::steady_clock::time_point deadline) {
+	return (deadline <= epoch)
+		? 0
+		: std::chrono::ceil<std::chrono::milliseconds>(deadline - epoch).count();
+}
+
+/**
+ * \brief Converts the current time into a millisecond tick, rounding down.
+ * \param epoch The point in time tick \c 0 refers to.
+ * \param now The point in time to convert.
+ * \return The last tick not after \c now.
+ */
+inline std::uint64_t timer_tick_at(std::chrono::steady_clock::time_point epoch, std::chrono::steady_clock::time_point now) {
+	return (now <= epoch)
+		? 0
+		: std::chrono::floor<std::chrono::milliseconds>(now - epoch).count();
+}
+
+/**
+ * \brief Converts a millisecond tick back into a point in time.
+ * \param epoch The point in time tick \c 0 refers to.
+ * \param tick The tick to convert.
+ * \return The point in time of \c tick, or
+ *         <tt>std::chrono::steady_clock::time_point::max()</tt> if it can not
+ *         be represented.
+ */
+inline std::chrono::steady_clock::time_point timer_tick_deadline(std::chrono::steady_clock::time_point epoch, std::uint64_t tick) {
+	const auto representable = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::time_point::max() - epoch
+	).count();
+	return (tick >= static_cast<std::uint64_t>(representable))
+		? std::chrono::steady_clock::time_point::max()
+		: epoch + std::chrono::milliseconds(tick);
+}
+
+/**
+ * \brief A hierarchical timing wheel.
+ *
+ * Stores values along with a deadline, measured in ticks, and hands them out
+ * once the wheel is advanced past their deadline. Inserting and cancelling
+ * timers takes constant time, regardless of the number of pending timers.
+ *
+ * The wheel consists of levels of 64 slots each, where each slot of level
+ * \c n spans <tt>64^n</tt> ticks. A timer is stored in the lowest level in
+ * which its deadline shares all higher digits with the current tick. Timers
+ * move down one or more levels when the wheel reaches the start of their slot
+ * and expire when they reach level 0. Advancing the wheel jumps directly from
+ * one occupied slot to the next, so idle stretches cost nothing.
+ *
+ * \note The wheel itself is not thread safe.
+ */
+template<typename T>
+class timer_wheel {
+public:
+	using value_type = T; ///< @brief Type of the stored values
+	using tick_type = std::uint64_t; ///< @brief Type of points in time
+	using size_type = std::size_t; ///< @brief Size type
+
+	/**
+	 * \brief Creates an empty timer wheel.
+	 * \param now The tick to start the wheel at.
+	 */
+	explicit timer_wheel(tick_type now = 0)
+	: now_(now)
+	, nodes_()
+	, free_(none)
+	, heads_()
+	, occupied_()
+	, size_(0) {
+		for(auto &level: heads_) {
+			level.fill(none);
+		}
+		occupied_.fill(0);
+	}
+
+	/**
+	 * \brief Adds a timer.
+	 * \param deadline The tick at which the timer expires. Deadlines in the
+	 *                 past expire on the next call to \c advance().
+	 * \param value The value to hand out once the timer expires.
+	 * \return A handle to cancel the timer with.
+	 */
+	timer_handle insert(tick_type deadline, T value) {
+		std::uint32_t index;
+		if (free_ != none) {
+			index = free_;
+			free_ = nodes_[index].next;
+			nodes_[index].value.emplace(std::move(value));
+		}
+		else {
+			assert(nodes_.size() < none && "too many timers");
+			index = static_cast<std::uint32_t>(nodes_.size());
+			nodes_.emplace_back();
+			nodes_.back().value.emplace(std::move(value));
+		}
+
+		nodes_[index].deadline = std::max(deadline, now_);
+		link(index);
+		++size_;
+		return timer_handle{ index, nodes_[index].generation };
+	}
+
+	/**
+	 * \brief Cancels a timer.
+	 * \param handle The handle returned by \c insert().
+	 * \return
+	 *     - \c false if the timer has already expired or been cancelled,
+	 *     - \c true if the timer was cancelled
+	 */
+	bool cancel(timer_handle handle) {
+		if (
+			handle.index >= nodes_.size()
+			|| nodes_[handle.index].generation != handle.generation
+			|| !nodes_[handle.index].value
+		) {
+			return false;
+		}
+
+		unlink(handle.index);
+		release(handle.index);
+		return true;
+	}
+
+	/**
+	 * \brief Advances the wheel and expires all timers due until then.
+	 * \tparam Func The type of the callback; must be callable as <tt>f(T &&)</tt>.
+	 * \param now The tick to advance to. Going back in time is ignored.
+	 * \param expired Called for each expired timer, in order of deadline.
+	 */
+	template<typename Func>
+	void advance(tick_type now, Func &&expired) {
+		while(size_ != 0) {
+			const auto [level, slot] = next_occupied_slot();
+			const tick_type slot_start = start_of(level, slot);
+			if (slot_start > now) {
+				break;
+			}
+			now_ = std::max(now_, slot_start);
+
+			std::uint32_t index = heads_[level][slot];
+			heads_[level][slot] = none;
+			occupied_[level] &= ~(std::uint64_t(1) << slot);
+
+			while(index != none) {
+				const std::uint32_t next = nodes_[index].next;
+				if (level == 0) {
+					T value = std::move(*nodes_[index].value);
+					release(index);
+					expired(std::move(value));
+				}
+				else {
+					// closer to the deadline now; move to a lower level
+					link(index);
+				}
+				index = next;
+			}
+		}
+		now_ = std::max(now_, now);
+	}
+
+	/**
+	 * \brief Checks when \c advance() needs to be called next.
+	 * \return An empty optional if no timers are pending, otherwise a tick
+	 *         not later than the earliest deadline. Advancing to this tick
+	 *         will either expire timers or allow a more precise answer.
+	 */
+	std::optional<tick_type> next_deadline() const noexcept {
+		if (size_ == 0) {
+			return std::nullopt;
+		}
+		const auto [level, slot] = next_occupied_slot();
+		return std::max(now_, start_of(level, slot));
+	}
+
+	/**
+	 * \brief Checks the current tick of the wheel.
+	 * \return The tick the wheel was last advanced to.
+	 */
+	tick_type now() const noexcept {
+		return now_;
+	}
+
+	/**
+	 * \brief Checks whether any timers are pending.
+	 * \return
+	 *     - \c false if any timers are pending,
+	 *     - \c true if no timers are pending
+	 */
+	bool empty() const noexcept {
+		return size_ == 0;
+	}
+
+	/**
+	 * \brief Checks the number of pending timers.
+	 * \return The number of pending timers.
+	 */
+	size_type size() const noexcept {
+		return size_;
+	}
+
+private:
+	static constexpr unsigned bits_per_level = 6;
+	static constexpr unsigned slots_per_level = 1u << bits_per_level;
+	static constexpr unsigned level_count = (64 + bits_per_level - 1) / bits_per_level;
+	static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+	struct node {
+		std::optional<T> value;
+		tick_type deadline = 0;
+		std::uint32_t prev = none;
+		std::uint32_t next = none;
+		std::uint32_t generation = 0;
+		std::uint8_t level = 0;
+		std::uint8_t slot = 0;
+	};
+
+	static unsigned highest_bit(std::uint64_t value) noexcept {
+		unsigned bit = 0;
+		while(value >>= 1) {
+			++bit;
+		}
+		return bit;
+	}
+
+	static unsigned lowest_bit(std::uint64_t value) noexcept {
+		unsigned bit = 0;
+		while(!(value & 1)) {
+			value >>= 1;
+			++bit;
+		}
+		return bit;
+	}
+
+	tick_type start_of(unsigned level, unsigned slot) const noexcept {
+		const unsigned shift = level * bits_per_level;
+		const unsigned upper_shift = shift + bits_per_level;
+		const tick_type upper = (upper_shift >= 64) ? 0 : ((now_ >> upper_shift) << upper_shift);
+		return upper | (tick_type(slot) << shift);
+	}
+
+	std::pair<unsigned, unsigned> next_occupied_slot() const noexcept {
+		// Lower levels always expire before higher ones, as timers on higher
+		// levels differ from the current tick in a higher digit.
+		for(unsigned level = 0; level != level_count; ++level) {
+			if (occupied_[level]) {
+				return { level, lowest_bit(occupied_[level]) };
+			}
+		}
+		assert(false && "no occupied slot in non-empty timer wheel");
+		return { 0, 0 };
+	}
+
+	void link(std::uint32_t index) noexcept {
+		node &n = nodes_[index];
+		const tick_type differing = n.deadline ^ now_;
+		const unsigned level = differing ? highest_bit(differing) / bits_per_level : 0;
+		const unsigned slot = (n.deadline >> (level * bits_per_level)) & (slots_per_level - 1);
+
+		n.level = static_cast<std::uint8_t>(level);
+		n.slot = static_cast<std::uint8_t>(slot);
+		n.prev = none;
+		n.next = heads_[level][slot];
+		if (n.next != none) {
+			nodes_[n.next].prev = index;
+		}
+		heads_[level][slot] = index;
+		occupied_[level] |= std::uint64_t(1) << slot;
+	}
+
+	void unlink(std::uint32_t index) noexcept {
+		node &n = nodes_[index];
+		if (n.prev != none) {
+			nodes_[n.prev].next = n.next;
+		}
+		else {
+			heads_[n.level][n.slot] = n.next;
+			if (n.next == none) {
+				occupied_[n.level] &= ~(std::uint64_t(1) << n.slot);
+			}
+		}
+		if (n.next != none) {
+			nodes_[n.next].prev = n.prev;
+		}
+	}
+
+	void release(std::uint32_t index) noexcept {
+		node &n = nodes_[index];
+		n.value.reset();
+		++n.generation;
+		n.next = free_;
+		free_ = index;
+		--size_;
+	}
+
+	tick_type now_;
+	std::vector<node> nodes_;
+	std::uint32_t free_;
+	std::array<std::array<std::uint32_t, slots_per_level>, level_count> heads_;
+	std::array<std::uint64_t, level_count> occupied_;
+	size_type size_;
+};
+
+}
+
+#endif //LIBSLIRC_TIMER_WHEEL_HPP
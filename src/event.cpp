@@ -24,133 +24,160 @@
 
 #include "../include/slirc/event.hpp"
 
-#include <iterator>
 #include <c++/7.2.0/cassert>
 
 #include "../include/slirc/irc.hpp"
 
-namespace {
-	using id_vector = std::vector<slirc::event_id>;
-	void normalize(id_vector &dst, id_vector::size_type &skipped_elements, id_vector &src) {
-		using reverse_iterator = std::reverse_iterator<id_vector::iterator>;
-		if (skipped_elements < src.size()) {
-			// need to move elements in dst to make space for src elements
-			const auto old_size = dst.size();
-			const auto required_additional_space = src.size() - skipped_elements;
-
-			dst.resize(old_size + required_additional_space);
-			std::copy(
-				reverse_iterator(dst.begin() + old_size),
-				reverse_iterator(dst.begin() + skipped_elements),
-				reverse_iterator(dst.end())
-			);
-
-			std::copy(
-				src.begin(),
-				src.end(),
-				reverse_iterator(dst.begin() + skipped_elements + required_additional_space)
-			);
-			skipped_elements = 0;
-		}
-		else {
-			std::copy(
-				src.begin(),
-				src.end(),
-				reverse_iterator(dst.begin() + skipped_elements)
-			);
-			skipped_elements -= src.size();
-		}
-		src.clear();
-	}
-}
-
 struct slirc::event::private_construction_tag {};
 
+slirc::event::event(
+	const slirc::event::private_construction_tag &tag,
+	slirc::irc &irc,
+	const slirc::event_id &original_id,
+	pointer origin,
+	slirc::event_pool &pool
+)
+: event(tag, irc, original_id, std::move(origin), pool, pool.acquire_containers()) {}
+
 slirc::event::event(
 	const slirc::event::private_construction_tag &,
 	slirc::irc &irc,
 	const slirc::event_id &original_id,
-	pointer origin
+	pointer origin,
+	slirc::event_pool &pool,
+	slirc::event_pool::containers &&containers
 )
 : std::enable_shared_from_this<event>()
 , irc(irc)
 , origin(origin)
 , original_id(original_id)
 , current_id(current_id_)
-, next_id_queue()
-, id_queue()
-, skipped(0)
-, current_id_(original_id) {}
+, data(std::move(containers.data))
+, pool_(pool)
+, id_queue(std::move(containers.id_queue))
+, current_id_(original_id)
+, current_connection_(nullptr)
+, trace_id_(irc.sample_event_trace(this->origin.get()))
+, queue_order_(0) {
+	if (this->origin) {
+		data.inherit(this->origin->data);
+	}
+	if (trace_id_) {
+		const auto timestamp = event_trace::now();
+		event_trace::add({
+			&irc, trace_id_, this->origin ? this->origin->trace_id_ : 0,
+			original_id.index(), event_trace::phase::created, timestamp, timestamp
+		});
+	}
+}
+
+slirc::event::~event() {
+	trace(event_trace::phase::destroyed);
+	pool_.release_containers({ std::move(id_queue), std::move(data) });
+}
 
 slirc::event::pointer slirc::event::create(slirc::irc &irc, const slirc::event_id &original_id) {
-	return std::make_shared<event>(private_construction_tag{}, irc, original_id, pointer{});
+	return create(irc, original_id, pointer{});
 }
 
 slirc::event::pointer slirc::event::create(slirc::irc &irc, const slirc::event_id &original_id, pointer origin) {
-	return std::make_shared<event>(private_construction_tag{}, irc, original_id, origin);
+	return std::allocate_shared<event>(
+		event_pool::allocator<event>(irc.event_pool_),
+		private_construction_tag{}, irc, original_id, std::move(origin), *irc.event_pool_
+	);
 }
 
 void slirc::event::post_front() {
 	irc.post_event_front(*this);
 }
 
+void slirc::event::post_front(std::size_t lane) {
+	irc.post_event_front(*this, lane);
+}
+
 void slirc::event::post_back() {
 	irc.post_event_back(*this);
 }
 
+void slirc::event::post_back(std::size_t lane) {
+	irc.post_event_back(*this, lane);
+}
+
+slirc::util::timer_handle slirc::event::post_at(std::chrono::steady_clock::time_point deadline) {
+	return irc.post_event_at(*this, deadline);
+}
+
+slirc::util::timer_handle slirc::event::post_at(std::chrono::steady_clock::time_point deadline, std::size_t lane) {
+	return irc.post_event_at(*this, deadline, lane);
+}
+
+const slirc::irc::connection_type &slirc::event::current_connection() const noexcept {
+	static const slirc::irc::connection_type no_connection;
+	return current_connection_ ? *current_connection_ : no_connection;
+}
+
 slirc::event::iterator slirc::event::begin() {
-	normalize(id_queue, skipped, next_id_queue);
-	return id_queue.begin() + skipped;
+	return id_queue.begin();
 }
 
 slirc::event::const_iterator slirc::event::cbegin() const {
-	normalize(id_queue, skipped, next_id_queue);
-	return id_queue.cbegin() + skipped;
+	return id_queue.cbegin();
 }
 
 slirc::event::iterator slirc::event::end() {
-	normalize(id_queue, skipped, next_id_queue);
 	return id_queue.end();
 }
 
 slirc::event::const_iterator slirc::event::cend() const {
-	normalize(id_queue, skipped, next_id_queue);
 	return id_queue.cend();
 }
 
 slirc::event::reverse_iterator slirc::event::rbegin() {
-	normalize(id_queue, skipped, next_id_queue);
-	return id_queue.rbegin() + skipped;
+	return id_queue.rbegin();
 }
 
 slirc::event::const_reverse_iterator slirc::event::crbegin() const {
-	normalize(id_queue, skipped, next_id_queue);
-	return id_queue.crbegin() + skipped;
+	return id_queue.crbegin();
 }
 
 slirc::event::reverse_iterator slirc::event::rend() {
-	normalize(id_queue, skipped, next_id_queue);
 	return id_queue.rend();
 }
 
 slirc::event::const_reverse_iterator slirc::event::crend() const {
-	normalize(id_queue, skipped, next_id_queue);
 	return id_queue.crend();
 }
 
 void slirc::event::emit() {
-	while((normalize(id_queue, skipped, next_id_queue), skipped < id_queue.size())) {
-		current_id_ = id_queue[skipped];
-		++skipped;
+	while(!id_queue.empty()) {
+		current_id_ = id_queue.front();
+		id_queue.pop_front();
+		emit_traced();
+	}
+}
+
+void slirc::event::emit_traced() {
+	if (!trace_id_) {
 		irc.emit_event(*this);
+		return;
 	}
+
+	const auto start = event_trace::now();
+	try {
+		irc.emit_event(*this);
+	}
+	catch(...) {
+		event_trace::add({ &irc, trace_id_, 0, current_id_.index(), event_trace::phase::emitted, start, event_trace::now() });
+		throw;
+	}
+	event_trace::add({ &irc, trace_id_, 0, current_id_.index(), event_trace::phase::emitted, start, event_trace::now() });
 }
 
 void slirc::event::emit_as(const slirc::event_id &id) {
 	const slirc::event_id old_id = current_id_;
 	current_id_ = id;
 	try {
-		irc.emit_event(*this);
+		emit_traced();
 		current_id_ = old_id;
 	}
 	catch(...) {
@@ -160,41 +187,19 @@ void slirc::event::emit_as(const slirc::event_id &id) {
 }
 
 void slirc::event::push_back(const slirc::event_id &id) {
-	if (
-		id_queue.size() == id_queue.capacity()
-		&& skipped != 0
-	) {
-		// move existing elements to front of vector rather than reallocating
-		id_queue.erase(
-			std::copy(
-				id_queue.begin() + skipped,
-				id_queue.end(),
-				id_queue.begin()
-			),
-			id_queue.end()
-		);
-	}
 	id_queue.push_back(id);
 }
 
 void slirc::event::push_front(const slirc::event_id &id) {
-	next_id_queue.push_back(id);
+	id_queue.push_front(id);
 }
 
 void slirc::event::pop_back() {
-	assert((skipped < id_queue.size() || !next_id_queue.empty()) && "needs to contain an element to pop");
-	if (id_queue.size() == skipped) {
-		normalize(id_queue, skipped, next_id_queue);
-	}
+	assert(!id_queue.empty() && "needs to contain an element to pop");
 	id_queue.pop_back();
 }
 
 void slirc::event::pop_front() {
-	if (!next_id_queue.empty()) {
-		next_id_queue.pop_back();
-	}
-	else {
-		assert(skipped < id_queue.size() && "needs to contain an element to pop");
-		++skipped;
-	}
+	assert(!id_queue.empty() && "needs to contain an element to pop");
+	id_queue.pop_front();
 }
@@ -23,3 +23,75 @@
 // THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "../include/slirc/event_id.hpp"
+
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+	using key_type = std::pair<std::type_index, slirc::event_id::enum_type>;
+
+	struct key_hash {
+		std::size_t operator()(const key_type &key) const noexcept {
+			// combine rather than xor, so equal values of distinct enums do not collide
+			std::size_t seed = std::hash<std::type_index>{}(key.first);
+			seed ^= std::hash<slirc::event_id::enum_type>{}(key.second) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			return seed;
+		}
+	};
+
+	struct registry {
+		std::mutex mutex;
+			std::unordered_map<key_type, slirc::event_id::index_type, key_hash> indices;
+			std::vector<key_type> keys; // by index, starting at 1
+		std::atomic<std::size_t> count{ 1 }; // index 0 is the default constructed event id
+	};
+
+	registry &get_registry() {
+		// function local static, so that event ids may be created during static initialization
+		static registry instance;
+		return instance;
+	}
+}
+
+slirc::event_id::index_type slirc::event_id::intern(std::type_index type, enum_type value) {
+	if (type == typeid(none_t)) {
+		return 0;
+	}
+
+	registry &reg = get_registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	const auto [it, inserted] = reg.indices.try_emplace(key_type(type, value), static_cast<index_type>(reg.count.load()));
+	if (inserted) {
+		if (reg.count == std::numeric_limits<index_type>::max()) {
+			reg.indices.erase(it);
+			throw std::length_error("slirc::event_id: Too many distinct event ids.");
+		}
+		reg.keys.push_back(it->first);
+		++reg.count;
+	}
+	return it->second;
+}
+
+std::size_t slirc::event_id::registered_count() noexcept {
+	return get_registry().count;
+}
+
+slirc::event_id slirc::event_id::from_index(index_type index) {
+	if (index == 0) {
+		return event_id();
+	}
+
+	registry &reg = get_registry();
+	key_type key(typeid(none_t), 0);
+	{ std::lock_guard<std::mutex> lock(reg.mutex);
+		if (index > reg.keys.size()) {
+			throw std::out_of_range("slirc::event_id::from_index(): No event id with this index.");
+		}
+		key = reg.keys[index - 1];
+	}
+	return event_id(key.first, key.second);
+}
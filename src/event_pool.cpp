@@ -0,0 +1,127 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../include/slirc/event_pool.hpp"
+
+#include <new>
+
+slirc::event_pool::event_pool(std::size_t capacity)
+: mutex_()
+, capacity_(capacity)
+, block_size_(0)
+, blocks_()
+, containers_()
+, statistics_{ 0, 0, 0 } {
+	// released blocks and containers are stored without allocating
+	blocks_.reserve(capacity_);
+	containers_.reserve(capacity_);
+}
+
+slirc::event_pool::~event_pool() {
+	for(void * const block: blocks_) {
+		::operator delete(block);
+	}
+}
+
+std::size_t slirc::event_pool::capacity() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return capacity_;
+}
+
+void slirc::event_pool::set_capacity(std::size_t capacity) {
+	std::vector<void *> released_blocks;
+	std::vector<containers> released_containers;
+	{ std::lock_guard<std::mutex> lock(mutex_);
+		if (capacity > capacity_) {
+			blocks_.reserve(capacity);
+			containers_.reserve(capacity);
+		}
+		capacity_ = capacity;
+		while(blocks_.size() > capacity_) {
+			released_blocks.push_back(blocks_.back());
+			blocks_.pop_back();
+		}
+		while(containers_.size() > capacity_) {
+			released_containers.push_back(std::move(containers_.back()));
+			containers_.pop_back();
+		}
+	}
+
+	for(void * const block: released_blocks) {
+		::operator delete(block);
+	}
+}
+
+slirc::event_pool::statistics slirc::event_pool::stats() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return statistics_;
+}
+
+slirc::event_pool::containers slirc::event_pool::acquire_containers() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	++statistics_.created;
+	if (containers_.empty()) {
+		return containers();
+	}
+	++statistics_.recycled_containers;
+	containers retval(std::move(containers_.back()));
+	containers_.pop_back();
+	return retval;
+}
+
+void slirc::event_pool::release_containers(containers &&released) noexcept {
+	// destroys the components, which may run arbitrary code, outside the lock
+	released.id_queue.clear();
+	released.data.clear();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (containers_.size() < capacity_) {
+		containers_.push_back(std::move(released));
+	}
+}
+
+void *slirc::event_pool::allocate(std::size_t size) {
+	{ std::lock_guard<std::mutex> lock(mutex_);
+		if (block_size_ == 0) {
+			block_size_ = size;
+		}
+		if (size == block_size_ && !blocks_.empty()) {
+			++statistics_.recycled_memory;
+			void * const block = blocks_.back();
+			blocks_.pop_back();
+			return block;
+		}
+	}
+	return ::operator new(size);
+}
+
+void slirc::event_pool::deallocate(void *block, std::size_t size) noexcept {
+	{ std::lock_guard<std::mutex> lock(mutex_);
+		if (size == block_size_ && blocks_.size() < capacity_) {
+			blocks_.push_back(block);
+			return;
+		}
+	}
+	::operator delete(block);
+}
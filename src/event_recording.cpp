@@ -0,0 +1,284 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../include/slirc/event_recording.hpp"
+
+#include <algorithm>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+
+#include "../include/slirc/apis/connection.hpp"
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	// Log layout, all integers little endian:
+	//   header:        "SLIRCREC", u32 version
+	//   id definition: u8 1, u32 type name length, type name, u32 enum value
+	//   posted event:  u8 2, u64 nanoseconds since start, u32 lane,
+	//                  u8 flags, u32 id count, u32 id numbers in definition
+	//                  order, [u32 line length, line]
+	const char log_magic[8] = { 'S', 'L', 'I', 'R', 'C', 'R', 'E', 'C' };
+	const std::uint32_t log_version = 1;
+
+	enum record_tag: std::uint8_t {
+		id_definition_tag = 1,
+		posted_event_tag = 2
+	};
+
+	enum posted_event_flags: std::uint8_t {
+		posted_front = 1,
+		has_raw_message = 2
+	};
+
+	void write_uint(std::ostream &out, std::uint64_t value, std::size_t bytes) {
+		char buffer[8];
+		for(std::size_t i = 0; i != bytes; ++i) {
+			buffer[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+		}
+		out.write(buffer, bytes);
+	}
+
+	void write_string(std::ostream &out, std::string_view value) {
+		write_uint(out, value.size(), 4);
+		out.write(value.data(), value.size());
+	}
+
+	std::uint64_t read_uint(std::istream &in, std::size_t bytes) {
+		unsigned char buffer[8];
+		if (!in.read(reinterpret_cast<char *>(buffer), bytes)) {
+			throw std::invalid_argument("slirc::event_replay::event_replay(): Recording is truncated.");
+		}
+		std::uint64_t value = 0;
+		for(std::size_t i = 0; i != bytes; ++i) {
+			value |= static_cast<std::uint64_t>(buffer[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	std::string read_string(std::istream &in) {
+		std::string value(read_uint(in, 4), '\0');
+		if (!in.read(value.data(), value.size())) {
+			throw std::invalid_argument("slirc::event_replay::event_replay(): Recording is truncated.");
+		}
+		return value;
+	}
+}
+
+struct slirc::event_recorder::state {
+	void record(const event &ev, std::size_t lane, bool front);
+
+	std::mutex mutex;
+		std::ostream *out;
+		std::chrono::steady_clock::time_point start;
+		std::unordered_map<event_id, std::uint32_t, event_id::hash> ids;
+		std::size_t recorded;
+};
+
+void slirc::event_recorder::state::record(const slirc::event &ev, std::size_t lane, bool front) {
+	if (ev.origin) {
+		return;
+	}
+	const auto time = std::chrono::steady_clock::now();
+	const auto raw_message = ev.data.find<apis::connection::raw_message>();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!out) {
+		return;
+	}
+
+	// the original id first, which the replay creates the event with
+	std::vector<std::uint32_t> id_numbers;
+	id_numbers.reserve(1 + ev.size());
+	const auto add_id = [&](const event_id &id) {
+		auto it = ids.find(id);
+		if (it == ids.end()) {
+			it = ids.emplace(id, static_cast<std::uint32_t>(ids.size())).first;
+			write_uint(*out, id_definition_tag, 1);
+			write_string(*out, std::get<0>(id).name());
+			write_uint(*out, std::get<1>(id), 4);
+		}
+		id_numbers.push_back(it->second);
+	};
+	add_id(ev.original_id);
+	for(const event_id &id: ev) {
+		add_id(id);
+	}
+
+	write_uint(*out, posted_event_tag, 1);
+	write_uint(*out, std::chrono::duration_cast<std::chrono::nanoseconds>(time - start).count(), 8);
+	write_uint(*out, lane, 4);
+	write_uint(*out, (front ? posted_front : 0) | (raw_message ? has_raw_message : 0), 1);
+	write_uint(*out, id_numbers.size(), 4);
+	for(const std::uint32_t id_number: id_numbers) {
+		write_uint(*out, id_number, 4);
+	}
+	if (raw_message) {
+		write_string(*out, raw_message->line);
+	}
+	++recorded;
+}
+
+slirc::event_recorder::event_recorder(slirc::irc &irc, std::ostream &out)
+: irc_(irc)
+, state_(std::make_shared<state>()) {
+	state_->out = &out;
+	state_->start = std::chrono::steady_clock::now();
+	state_->recorded = 0;
+
+	out.write(log_magic, sizeof(log_magic));
+	write_uint(out, log_version, 4);
+
+	auto previous = irc_.set_post_observer([state = state_](event &ev, std::size_t lane, bool front) {
+		state->record(ev, lane, front);
+	});
+	if (previous) {
+		irc_.set_post_observer(std::move(previous));
+		throw std::logic_error("slirc::event_recorder::event_recorder(): IRC context already has a post observer.");
+	}
+}
+
+slirc::event_recorder::~event_recorder() {
+	stop();
+}
+
+void slirc::event_recorder::stop() {
+	std::lock_guard<std::mutex> lock(state_->mutex);
+	if (state_->out) {
+		irc_.set_post_observer(nullptr);
+		state_->out->flush();
+		state_->out = nullptr;
+	}
+}
+
+std::size_t slirc::event_recorder::recorded() const {
+	std::lock_guard<std::mutex> lock(state_->mutex);
+	return state_->recorded;
+}
+
+slirc::event_replay::event_replay(std::istream &in) {
+	char magic[sizeof(log_magic)];
+	if (
+		!in.read(magic, sizeof(magic))
+		|| !std::equal(magic, magic + sizeof(magic), log_magic)
+		|| read_uint(in, 4) != log_version
+	) {
+		throw std::invalid_argument("slirc::event_replay::event_replay(): Not an event recording.");
+	}
+
+	for(int tag; (tag = in.get()) != std::istream::traits_type::eof(); ) {
+		if (tag == id_definition_tag) {
+			id_definition definition;
+			definition.type = read_string(in);
+			definition.value = static_cast<event_id::enum_type>(read_uint(in, 4));
+			ids_.push_back(std::move(definition));
+		}
+		else if (tag == posted_event_tag) {
+			record posted;
+			posted.time = std::chrono::nanoseconds(read_uint(in, 8));
+			posted.lane = read_uint(in, 4);
+			const auto flags = read_uint(in, 1);
+			posted.front = (flags & posted_front) != 0;
+			posted.has_line = (flags & has_raw_message) != 0;
+			posted.ids.resize(read_uint(in, 4));
+			for(std::uint32_t &id_number: posted.ids) {
+				id_number = static_cast<std::uint32_t>(read_uint(in, 4));
+				if (id_number >= ids_.size()) {
+					throw std::invalid_argument("slirc::event_replay::event_replay(): Recording refers to an undefined event id.");
+				}
+			}
+			if (posted.has_line) {
+				posted.line = read_string(in);
+			}
+			records_.push_back(std::move(posted));
+		}
+		else {
+			throw std::invalid_argument("slirc::event_replay::event_replay(): Recording is corrupt.");
+		}
+	}
+}
+
+std::chrono::nanoseconds slirc::event_replay::duration() const noexcept {
+	return records_.empty() ? std::chrono::nanoseconds(0) : records_.back().time;
+}
+
+slirc::event_replay::statistics slirc::event_replay::replay(slirc::irc &irc, double speed) const {
+	// resolve the recorded enum type names through the registered types and
+	// the event ids interned so far
+	std::unordered_map<std::string, std::type_index> types(types_);
+	for(std::size_t index = 0; index != event_id::registered_count(); ++index) {
+		const event_id id = event_id::from_index(static_cast<event_id::index_type>(index));
+		types.emplace(std::get<0>(id).name(), std::get<0>(id));
+	}
+
+	std::vector<std::unique_ptr<event_id>> ids;
+	ids.reserve(ids_.size());
+	for(const id_definition &definition: ids_) {
+		const auto type = types.find(definition.type);
+		ids.push_back((type != types.end()) ? std::make_unique<event_id>(type->second, definition.value) : nullptr);
+	}
+
+	statistics retval{ 0, 0, std::chrono::nanoseconds(0), std::chrono::nanoseconds(0) };
+	const auto start = std::chrono::steady_clock::now();
+	for(const record &posted: records_) {
+		if (
+			posted.ids.empty()
+			|| std::any_of(posted.ids.begin(), posted.ids.end(), [&](std::uint32_t id_number) { return !ids[id_number]; })
+		) {
+			++retval.skipped;
+			continue;
+		}
+
+		if (speed > 0) {
+			const auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(posted.time / speed);
+			const auto now = std::chrono::steady_clock::now();
+			if (now < due) {
+				std::this_thread::sleep_until(due);
+			}
+			else {
+				retval.max_lag = std::max(retval.max_lag, std::chrono::duration_cast<std::chrono::nanoseconds>(now - due));
+			}
+		}
+
+		const auto ev = irc.make_event(*ids[posted.ids.front()]);
+		for(auto id_number = posted.ids.begin() + 1; id_number != posted.ids.end(); ++id_number) {
+			ev->push_back(*ids[*id_number]);
+		}
+		if (posted.has_line) {
+			ev->data.insert(apis::connection::raw_message::copy(posted.line));
+		}
+		if (posted.front) {
+			ev->post_front(posted.lane);
+		}
+		else {
+			ev->post_back(posted.lane);
+		}
+		++retval.posted;
+	}
+	retval.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+	return retval;
+}
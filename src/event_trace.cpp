@@ -0,0 +1,176 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../include/slirc/event_trace.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/core/demangle.hpp>
+
+namespace {
+	// Written by the owning thread only. Each slot carries a sequence number
+	// which is odd while the slot is being written, so readers can detect
+	// torn records and skip them.
+	struct thread_buffer {
+		struct slot {
+			std::atomic<std::uint64_t> sequence{0};
+			slirc::event_trace::record value;
+		};
+
+		explicit thread_buffer(std::size_t tid)
+		: tid(tid)
+		, written(0)
+		, slots() {}
+
+		const std::size_t tid;
+		std::atomic<std::uint64_t> written;
+		std::array<slot, slirc::event_trace::records_per_thread> slots;
+	};
+
+	struct buffer_registry {
+		std::mutex mutex;
+			std::vector<std::shared_ptr<thread_buffer>> buffers;
+	};
+
+	buffer_registry &get_buffer_registry() {
+		static buffer_registry registry;
+		return registry;
+	}
+
+	thread_buffer &get_thread_buffer() {
+		thread_local const std::shared_ptr<thread_buffer> buffer = []{
+			buffer_registry &registry = get_buffer_registry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			registry.buffers.push_back(std::make_shared<thread_buffer>(registry.buffers.size() + 1));
+			return registry.buffers.back();
+		}();
+		return *buffer;
+	}
+
+	std::string event_name(slirc::event_id::index_type index) {
+		const slirc::event_id id = slirc::event_id::from_index(index);
+		return boost::core::demangle(std::get<0>(id).name()) + "::" + std::to_string(std::get<1>(id));
+	}
+
+	void write_timestamp(std::ostream &out, std::int64_t nanoseconds) {
+		// trace event timestamps are in microseconds
+		out << nanoseconds / 1000 << '.';
+		const auto fraction = std::to_string(nanoseconds % 1000 + 1000);
+		out << fraction.substr(1);
+	}
+}
+
+std::int64_t slirc::event_trace::now() noexcept {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count();
+}
+
+std::uint64_t slirc::event_trace::next_trace_id() noexcept {
+	static std::atomic<std::uint64_t> last_trace_id(0);
+	return ++last_trace_id;
+}
+
+void slirc::event_trace::add(const record &value) noexcept {
+	thread_buffer *buffer;
+	try {
+		buffer = &get_thread_buffer();
+	}
+	catch(...) {
+		return; // no buffer, no record
+	}
+
+	const std::uint64_t index = buffer->written.load(std::memory_order_relaxed);
+	auto &slot = buffer->slots[index % records_per_thread];
+	slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.value = value;
+	slot.sequence.store(2 * index + 2, std::memory_order_release);
+	buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void slirc::event_trace::write_chrome_json(std::ostream &out, const void *context) {
+	std::vector<std::shared_ptr<thread_buffer>> buffers;
+	{ buffer_registry &registry = get_buffer_registry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		buffers = registry.buffers;
+	}
+
+	const char *separator = "";
+	out << "{\"traceEvents\":[";
+	for(const auto &buffer: buffers) {
+		const std::uint64_t written = buffer->written.load(std::memory_order_acquire);
+		const std::uint64_t first = (written > records_per_thread) ? written - records_per_thread : 0;
+		for(std::uint64_t index = first; index != written; ++index) {
+			const auto &slot = buffer->slots[index % records_per_thread];
+			const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+			const record value = slot.value;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (sequence != 2 * index + 2 || slot.sequence.load(std::memory_order_relaxed) != sequence) {
+				continue; // overwritten meanwhile
+			}
+			if (value.context != context) {
+				continue;
+			}
+
+			out << separator << "{\"cat\":\"event\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":";
+			write_timestamp(out, value.start);
+			switch(value.what) {
+			case phase::created:
+				out << ",\"ph\":\"b\",\"id\":" << value.trace_id << ",\"name\":\"" << event_name(value.id) << '"';
+				if (value.origin_trace_id != 0) {
+					out << ",\"args\":{\"origin\":" << value.origin_trace_id << '}';
+				}
+				break;
+			case phase::destroyed:
+				out << ",\"ph\":\"e\",\"id\":" << value.trace_id << ",\"name\":\"" << event_name(value.id) << '"';
+				break;
+			case phase::posted_front:
+				out << ",\"ph\":\"n\",\"id\":" << value.trace_id << ",\"name\":\"post_front\"";
+				break;
+			case phase::posted_back:
+				out << ",\"ph\":\"n\",\"id\":" << value.trace_id << ",\"name\":\"post_back\"";
+				break;
+			case phase::fetched:
+				out << ",\"ph\":\"n\",\"id\":" << value.trace_id << ",\"name\":\"fetch\"";
+				break;
+			case phase::emitted:
+				out << ",\"ph\":\"X\",\"dur\":";
+				write_timestamp(out, value.end - value.start);
+				out << ",\"name\":\"" << event_name(value.id) << "\",\"args\":{\"event\":" << value.trace_id << '}';
+				break;
+			}
+			out << '}';
+			separator = ",";
+		}
+	}
+	out << "]}";
+}
@@ -24,112 +24,1619 @@
 
 #include "../include/slirc/irc.hpp"
 
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <boost/asio/steady_timer.hpp>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
 #include "../include/slirc/event.hpp"
 #include "../include/slirc/module.hpp"
+#include "../include/slirc/network.hpp"
+#include "../include/slirc/scheduler.hpp"
+#include "../include/slirc/util/cycle_clock.hpp"
+#include "../include/slirc/util/small_ring.hpp"
+
+struct slirc::irc::async_fetch_state {
+	std::mutex mutex;
+		async_handler handler;
+		boost::asio::io_service *io_service = nullptr;
+		std::unique_ptr<boost::asio::steady_timer> timer;
+};
+
+namespace {
+	using timer_tick = std::uint64_t;
+	constexpr timer_tick no_timer = std::numeric_limits<timer_tick>::max();
+
+	std::chrono::steady_clock::time_point deadline_after(std::chrono::milliseconds timeout) {
+		const auto now = std::chrono::steady_clock::now();
+		if (
+			timeout == std::chrono::milliseconds::max()
+			|| timeout >= std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::time_point::max() - now)
+		) {
+			return std::chrono::steady_clock::time_point::max();
+		}
+		return now + timeout;
+	}
+
+	unsigned dispatch_pool_threads() noexcept {
+		return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	}
+
+	// Runs concurrent event handlers. Threads are started on first use and
+	// live until the program exits.
+	class dispatch_pool {
+	public:
+		dispatch_pool()
+		: mutex_()
+		, condition_()
+		, jobs_()
+		, idle_threads_(0)
+		, stopping_(false)
+		, threads_() {
+			const unsigned thread_count = dispatch_pool_threads();
+			for(unsigned i = 0; i != thread_count; ++i) {
+				threads_.emplace_back([this]{ work(); });
+			}
+		}
+
+		~dispatch_pool() {
+			{ std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+			}
+			condition_.notify_all();
+			for(auto &thread: threads_) {
+				thread.join();
+			}
+		}
+
+		std::size_t thread_count() const noexcept {
+			return threads_.size();
+		}
+
+		/// \brief A job for the pool threads; queueing it does not allocate once the queue has grown.
+		struct job {
+			void (*run)(void *context);
+			void *context;
+		};
+
+		/**
+		 * \brief Queues copies of a job for pool threads that are idle.
+		 *
+		 * Copies are only queued for pool threads not already claimed by
+		 * another queued job, so the queue never holds more jobs than there
+		 * are pool threads.
+		 *
+		 * \param new_job The job to run.
+		 * \param copies The number of pool threads to run it on at most.
+		 * \return The number of copies queued.
+		 */
+		std::size_t submit(job new_job, std::size_t copies) {
+			{ std::lock_guard<std::mutex> lock(mutex_);
+				copies = std::min(copies, idle_threads_ - std::min(idle_threads_, jobs_.size()));
+				// all copies or none are queued
+				jobs_.reserve(jobs_.size() + copies);
+				for(std::size_t i = 0; i != copies; ++i) {
+					jobs_.emplace_back(new_job);
+				}
+			}
+			for(std::size_t i = 0; i != copies; ++i) {
+				condition_.notify_one();
+			}
+			return copies;
+		}
+
+	private:
+		void work() {
+			for(;;) {
+				job next_job;
+				{ std::unique_lock<std::mutex> lock(mutex_);
+					++idle_threads_;
+					condition_.wait(lock, [&]{ return stopping_ || !jobs_.empty(); });
+					--idle_threads_;
+					if (jobs_.empty()) {
+						return;
+					}
+					next_job = jobs_.front();
+					jobs_.pop_front();
+				}
+				next_job.run(next_job.context);
+			}
+		}
+
+		std::mutex mutex_;
+			std::condition_variable condition_;
+			slirc::util::small_ring<job, 64> jobs_;
+			std::size_t idle_threads_;
+			bool stopping_;
+		std::vector<std::thread> threads_;
+	};
+
+	dispatch_pool &get_dispatch_pool() {
+		static dispatch_pool instance;
+		return instance;
+	}
+
+	template<typename Predicate>
+	bool wait_for_event_queue(
+		std::condition_variable &condition,
+		std::unique_lock<std::mutex> &lock,
+		std::chrono::steady_clock::time_point until,
+		Predicate predicate
+	) {
+		if (until == std::chrono::steady_clock::time_point::max()) {
+			condition.wait(lock, predicate);
+			return true;
+		}
+		return condition.wait_until(lock, until, predicate);
+	}
+}
 
 slirc::irc::irc()
 : modules_()
-, signals_mutex_()
-, signals_()
+, event_pool_(std::make_shared<event_pool>())
+, handlers_(std::make_shared<handler_registry>())
+, static_handlers_()
+, event_latency_()
+, trace_sampling_(0)
+, trace_samples_(0)
+, post_observer_()
+, has_post_observer_(false)
 , event_queue_mutex_()
 , event_queue_condition_()
-, event_queue_front_()
-, event_queue_back_()
-, event_queue_back_skip_(0)
-, shutting_down_(false) {}
+, event_lanes_()
+, event_queue_order_(0)
+, event_queue_space_condition_()
+, event_lane_scheduling_(lane_scheduling::strict_priority)
+, default_event_lane_(0)
+, event_queue_producers_waiting_(0)
+, event_queue_depth_(0)
+, event_queue_capacity_(std::numeric_limits<std::size_t>::max())
+, event_queue_overflow_policy_(overflow_policy::block)
+, event_queue_high_watermark_(std::numeric_limits<std::size_t>::max())
+, event_queue_low_watermark_(0)
+, event_queue_above_high_watermark_(false)
+, event_queue_lock_free_(false)
+, event_queue_consumer_waiting_(false)
+, timer_epoch_(std::chrono::steady_clock::now())
+, timer_mutex_()
+, timers_()
+, next_timer_tick_(no_timer)
+, wait_handle_(-1)
+, wait_handle_signalled_(false)
+, async_fetch_(std::make_unique<async_fetch_state>())
+, async_fetch_waiting_(false)
+, scheduler_(nullptr)
+, scheduler_users_(0)
+, scheduler_state_(0)
+, scheduler_timer_()
+, scheduler_timer_deadline_(std::chrono::steady_clock::time_point::max())
+, shutting_down_(false) {
+	set_event_lanes({ 1 });
+}
 
 slirc::irc::~irc() {
+	if (scheduler * const attached_scheduler = scheduler_) {
+		attached_scheduler->detach(*this);
+	}
+
 	// TODO: Allow vetoing of dependencies for orderly shutdown
 	while(!modules_.empty()) {
-		detail::module_base *modptr = modules_.begin()->second;
+		const auto modptr = std::move(modules_.begin()->second);
 		modules_.erase(modules_.begin());
-		delete modptr;
+		remove_static_handlers(*modptr);
 	}
 
 	{ std::lock_guard<std::mutex> lock(event_queue_mutex_);
 		shutting_down_ = true;
 		event_queue_condition_.notify_all();
+		event_queue_space_condition_.notify_all();
+	}
+
+	disable_wait_handle();
+
+	{ std::lock_guard<std::mutex> lock(async_fetch_->mutex);
+		async_fetch_waiting_ = false;
+		async_fetch_->timer.reset();
+		if (async_fetch_->handler) {
+			async_fetch_->io_service->post([handler = std::move(async_fetch_->handler)]{
+				handler(nullptr);
+			});
+		}
 	}
 }
 
 void slirc::irc::emit_event(slirc::event &ev) {
-	signal_type *signal;
-	{ std::lock_guard<std::mutex> lock(signals_mutex_);
-		signal = &signals_[ev.current_id];
+	const auto index = ev.current_id.index();
+	{ const auto static_handlers = static_handlers_.read();
+		if (index < static_handlers->size()) {
+			for(const auto &dispatcher: (*static_handlers)[index]) {
+				dispatcher.dispatch(*dispatcher.module, ev);
+			}
+		}
+	}
+
+	const auto table = handlers_->table.read();
+	const auto routes = handlers_->routes.read();
+	const handler_list *handlers = (index < table->size()) ? (*table)[index].get() : nullptr;
+	const auto *route_indices = (index < routes->size() && !(*routes)[index].empty()) ? &(*routes)[index] : nullptr;
+	if (!handlers && !route_indices) {
+		return;
+	}
+
+	const event_scoped_connection esc(ev);
+#ifdef LIBSLIRC_DISPATCH_PROFILING
+	const auto dispatch_start = util::cycle_clock::now();
+#endif
+	if (handlers) {
+		call_handlers(*handlers, ev);
+	}
+	if (route_indices) {
+		for(const auto &route: *route_indices) {
+			if (const std::string * const key = route->key_of(ev.data)) {
+				const auto routed = route->handlers.find(*key);
+				if (routed != route->handlers.end()) {
+					call_handlers(*routed->second, ev);
+				}
+			}
+		}
+	}
+#ifdef LIBSLIRC_DISPATCH_PROFILING
+	const auto dispatch_end = util::cycle_clock::now();
+	{ const auto latencies = event_latency_.read();
+		if (index < latencies->size() && (*latencies)[index]) {
+			(*latencies)[index]->record(dispatch_end - dispatch_start);
+			return;
+		}
+	}
+	event_latency_.update([&](std::vector<std::shared_ptr<util::latency_histogram>> &latencies) {
+		if (latencies.size() <= index) {
+			latencies.resize(index + 1);
+		}
+		if (!latencies[index]) {
+			latencies[index] = std::make_shared<util::latency_histogram>();
+		}
+		latencies[index]->record(dispatch_end - dispatch_start);
+	});
+#endif
+}
+
+void slirc::irc::call_handlers(const handler_list &handlers, slirc::event &ev) {
+#ifdef LIBSLIRC_DISPATCH_PROFILING
+	// each handlers end is the next handlers start, so there is one clock read per handler
+	auto handler_start = util::cycle_clock::now();
+#endif
+	for(std::size_t first = 0; first != handlers.size(); ) {
+		if (handlers[first]->concurrent) {
+			std::size_t last = first + 1;
+			while(last != handlers.size() && handlers[last]->concurrent) {
+				++last;
+			}
+
+			ev.current_connection_ = nullptr;
+			emit_concurrently(handlers.data() + first, last - first, ev);
+			first = last;
+#ifdef LIBSLIRC_DISPATCH_PROFILING
+			handler_start = util::cycle_clock::now();
+#endif
+			continue;
+		}
+
+		const auto &handler = handlers[first++];
+		if (handler->connected) {
+			ev.current_connection_ = &handler->connection;
+			handler->callback(handler->connection, ev);
+#ifdef LIBSLIRC_DISPATCH_PROFILING
+			const auto handler_end = util::cycle_clock::now();
+			handler->latency->record(handler_end - handler_start);
+			handler_start = handler_end;
+#endif
+		}
+	}
+}
+
+// Handlers are claimed one by one by the emitting thread and by helper jobs on
+// the dispatch pool. The emitting thread always takes part, so the run
+// completes even if all pool threads are busy. Helpers starting after the run
+// is done only find it exhausted and touch neither the handlers nor the event
+// anymore, but keep the run alive, so runs are recycled by whoever is last.
+struct slirc::irc::concurrent_run {
+	const std::shared_ptr<handler_entry> *handlers;
+	std::size_t count;
+	event *ev;
+	std::atomic<std::size_t> next_handler;
+	std::atomic<std::size_t> finished_handlers;
+	std::atomic<std::size_t> references; // the emitting thread and each helper job
+	std::mutex mutex;
+		std::condition_variable finished_condition;
+		std::exception_ptr exception;
+
+	/// \brief Takes a recycled run, or a new one if there is none.
+	static concurrent_run &acquire() {
+		free_runs &runs = get_free_runs();
+		{ std::lock_guard<std::mutex> lock(runs.mutex);
+			if (!runs.runs.empty()) {
+				concurrent_run &recycled = *runs.runs.back().release();
+				runs.runs.pop_back();
+				return recycled;
+			}
+		}
+		return *new concurrent_run();
+	}
+
+	/// \brief Drops a reference, recycling the run if it was the last one.
+	void release() noexcept {
+		if (--references != 0) {
+			return;
+		}
+
+		exception = nullptr;
+		std::unique_ptr<concurrent_run> recycled(this);
+		free_runs &runs = get_free_runs();
+		std::lock_guard<std::mutex> lock(runs.mutex);
+		try {
+			runs.runs.push_back(std::move(recycled));
+		}
+		catch(...) {
+			// deleted by recycled instead
+		}
+	}
+
+	static void run_helper(void *context) {
+		concurrent_run &run = *static_cast<concurrent_run *>(context);
+		run.run();
+		run.release();
+	}
+
+	void run() {
+		for(std::size_t index; (index = next_handler++) < count; ) {
+			const auto &handler = handlers[index];
+			if (handler->connected) {
+#ifdef LIBSLIRC_DISPATCH_PROFILING
+				const auto start = util::cycle_clock::now();
+#endif
+				try {
+					handler->callback(handler->connection, *ev);
+				}
+				catch(...) {
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!exception) {
+						exception = std::current_exception();
+					}
+				}
+#ifdef LIBSLIRC_DISPATCH_PROFILING
+				handler->latency->record(util::cycle_clock::now() - start);
+#endif
+			}
+			if (++finished_handlers == count) {
+				std::lock_guard<std::mutex> lock(mutex);
+				finished_condition.notify_all();
+			}
+		}
+	}
+
+private:
+	struct free_runs {
+		// enough for one emitting thread and a helper on each pool thread
+		free_runs()
+		: mutex()
+		, runs(dispatch_pool_threads() + 1) {
+			for(auto &run: runs) {
+				run.reset(new concurrent_run());
+			}
+		}
+
+		std::mutex mutex;
+			std::vector<std::unique_ptr<concurrent_run>> runs;
+	};
+
+	static free_runs &get_free_runs() {
+		static free_runs instance;
+		return instance;
+	}
+};
+
+void slirc::irc::emit_concurrently(const std::shared_ptr<handler_entry> *handlers, std::size_t count, slirc::event &ev) {
+	// the free runs are set up first, so they outlive the pool threads releasing runs at exit
+	concurrent_run &run = concurrent_run::acquire();
+	dispatch_pool &pool = get_dispatch_pool();
+	const std::size_t helpers = std::min(count - 1, pool.thread_count());
+	run.handlers = handlers;
+	run.count = count;
+	run.ev = &ev;
+	run.next_handler = 0;
+	run.finished_handlers = 0;
+	run.references = 1 + helpers;
+	if (helpers != 0) {
+		std::size_t queued;
+		try {
+			queued = pool.submit({ &concurrent_run::run_helper, &run }, helpers);
+		}
+		catch(...) {
+			run.references = 1;
+			run.release();
+			throw;
+		}
+		// helpers not queued because the pool was busy are the emitting threads work
+		run.references -= helpers - queued;
+	}
+
+	run.run();
+
+	std::exception_ptr exception;
+	{ std::unique_lock<std::mutex> lock(run.mutex);
+		run.finished_condition.wait(lock, [&]{ return run.finished_handlers == count; });
+		exception = std::move(run.exception);
+	}
+	run.release();
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+}
+
+void slirc::irc::add_static_dispatchers(const std::shared_ptr<slirc::detail::module_base> &module, const std::vector<std::pair<event_id, static_dispatch_function>> &dispatchers) {
+	static_handlers_.update([&](std::vector<std::vector<static_dispatch>> &static_handlers) {
+		for(const auto &[id, dispatch]: dispatchers) {
+			if (static_handlers.size() <= id.index()) {
+				static_handlers.resize(id.index() + 1);
+			}
+			static_handlers[id.index()].push_back({ module, dispatch });
+		}
+	});
+}
+
+void slirc::irc::remove_static_handlers(slirc::detail::module_base &module) {
+	const bool registered = [&]{
+		const auto static_handlers = static_handlers_.read();
+		return std::any_of(static_handlers->begin(), static_handlers->end(), [&](const auto &dispatchers) {
+			return std::any_of(dispatchers.begin(), dispatchers.end(), [&](const auto &dispatcher) {
+				return dispatcher.module.get() == &module;
+			});
+		});
+	}();
+	if (!registered) {
+		return;
 	}
 
-	(*signal)(ev);
+	static_handlers_.update([&](std::vector<std::vector<static_dispatch>> &static_handlers) {
+		for(auto &dispatchers: static_handlers) {
+			dispatchers.erase(
+				std::remove_if(dispatchers.begin(), dispatchers.end(), [&](const auto &dispatcher) {
+					return dispatcher.module.get() == &module;
+				}),
+				dispatchers.end()
+			);
+		}
+	});
+}
+
+slirc::irc::dispatch_profile slirc::irc::dispatch_profile_snapshot() const {
+	dispatch_profile retval;
+#ifdef LIBSLIRC_DISPATCH_PROFILING
+	const double ticks_per_second = util::cycle_clock::ticks_per_second();
+
+	const auto add_handlers = [&](const handler_list &list) {
+		for(const auto &handler: list) {
+			if (handler->connected) {
+				retval.handlers.push_back({ handler->id, handler->connection, *handler->latency, ticks_per_second });
+			}
+		}
+	};
+	{ const auto table = handlers_->table.read();
+		for(const auto &list: *table) {
+			if (list) {
+				add_handlers(*list);
+			}
+		}
+	}
+	{ const auto routes = handlers_->routes.read();
+		for(const auto &route_indices: *routes) {
+			for(const auto &route: route_indices) {
+				for(const auto &routed: route->handlers) {
+					add_handlers(*routed.second);
+				}
+			}
+		}
+	}
+
+	{ const auto latencies = event_latency_.read();
+		for(std::size_t index = 0; index != latencies->size(); ++index) {
+			if ((*latencies)[index]) {
+				retval.events.push_back({
+					event_id::from_index(static_cast<event_id::index_type>(index)),
+					connection_type(),
+					*(*latencies)[index],
+					ticks_per_second
+				});
+			}
+		}
+	}
+#endif
+	return retval;
+}
+
+std::shared_ptr<slirc::irc::handler_entry> slirc::irc::make_handler_entry(const slirc::event_id &id, handler_entry::callback_type callback, slot_group group, bool concurrent) {
+	const auto entry = (group.index() == 0)
+		? std::make_shared<handler_entry>(id, std::move(callback), 1, std::get<0>(group), concurrent)
+		: std::make_shared<handler_entry>(id, std::move(callback), (std::get<1>(group) == at_front) ? 0 : 2, 0, concurrent);
+	entry->connection = connection_type(entry);
+	entry->registry = handlers_;
+#ifdef LIBSLIRC_DISPATCH_PROFILING
+	entry->latency = std::make_unique<util::latency_histogram>();
+#endif
+	return entry;
+}
+
+slirc::irc::connection_type slirc::irc::connect_handler(const slirc::event_id &id, handler_entry::callback_type callback, slot_group group, connect_position position, bool concurrent) {
+	const auto entry = make_handler_entry(id, std::move(callback), group, concurrent);
+	handlers_->add(entry, (group.index() == 0) ? position : std::get<1>(group));
+	return entry->connection;
+}
+
+slirc::irc::connection_type slirc::irc::connect_routed_handler(const slirc::event_id &id, std::type_index kind, route_key_function key_of, std::string key, handler_entry::callback_type callback, slot_group group, connect_position position) {
+	const auto entry = make_handler_entry(id, std::move(callback), group, false);
+	entry->route = std::make_unique<const handler_entry::route_type>(handler_entry::route_type{ kind, key_of, std::move(key) });
+	handlers_->add(entry, (group.index() == 0) ? position : std::get<1>(group));
+	return entry->connection;
 }
 
 std::shared_ptr<slirc::event> slirc::irc::make_event(const slirc::event_id &id) {
 	return event::create(*this, id);
 }
 
+slirc::event_pool::statistics slirc::irc::event_pool_statistics() const {
+	return event_pool_->stats();
+}
+
+std::size_t slirc::irc::event_pool_capacity() const {
+	return event_pool_->capacity();
+}
+
+void slirc::irc::set_event_pool_capacity(std::size_t capacity) {
+	event_pool_->set_capacity(capacity);
+}
+
+void slirc::irc::set_event_tracing(unsigned sample_every) noexcept {
+	trace_sampling_ = sample_every;
+}
+
+unsigned slirc::irc::event_tracing() const noexcept {
+	return trace_sampling_;
+}
+
+void slirc::irc::write_event_trace(std::ostream &out) const {
+	event_trace::write_chrome_json(out, this);
+}
+
+std::uint64_t slirc::irc::sample_event_trace(const slirc::event *origin) noexcept {
+	if (origin && origin->trace_id_) {
+		return event_trace::next_trace_id();
+	}
+	const unsigned sample_every = trace_sampling_.load(std::memory_order_relaxed);
+	if (sample_every == 0 || trace_samples_.fetch_add(1, std::memory_order_relaxed) % sample_every != 0) {
+		return 0;
+	}
+	return event_trace::next_trace_id();
+}
+
 std::shared_ptr<slirc::event> slirc::irc::fetch_event(std::chrono::milliseconds timeout) {
+	std::shared_ptr<slirc::event> retval;
+	fetch_events(&retval, 1, timeout);
+	return retval;
+}
 
-	std::unique_lock<std::mutex> lock(event_queue_mutex_);
-	if (
-		event_queue_condition_.wait_for(
+std::size_t slirc::irc::fetch_events_into(std::size_t max_events, std::chrono::milliseconds timeout, event_sink sink, void *sink_context) {
+	if (max_events == 0) {
+		return 0;
+	}
+
+	const auto give_up_at = deadline_after(timeout);
+	std::size_t fetched = 0;
+
+	if (event_queue_lock_free_) {
+		std::shared_ptr<slirc::event> ev;
+		for(;;) {
+			post_expired_timers();
+			if ((ev = pop_event_lock_free())) {
+				break;
+			}
+
+			{ std::unique_lock<std::mutex> lock(event_queue_mutex_);
+				if (shutting_down_ || std::chrono::steady_clock::now() >= give_up_at) {
+					lock.unlock();
+					reset_wait_handle();
+					return 0;
+				}
+
+				const auto wake_up_at = std::min(give_up_at, next_timer_deadline());
+				event_queue_consumer_waiting_ = true;
+				wait_for_event_queue(
+					event_queue_condition_,
+					lock,
+					wake_up_at,
+					[&]{
+						return
+							shutting_down_
+							|| next_timer_deadline() < wake_up_at
+							|| std::any_of(
+								event_lanes_.begin(),
+								event_lanes_.end(),
+								[](const auto &lane) { return lane->has_inbox_events(); }
+							);
+					}
+				);
+				event_queue_consumer_waiting_ = false;
+			}
+		}
+
+		do {
+			sink(sink_context, std::move(ev));
+			++fetched;
+		} while(fetched < max_events && (ev = pop_event_lock_free()));
+
+		reset_wait_handle();
+		event_queue_shrunk();
+		return fetched;
+	}
+
+	std::unique_lock<std::mutex> lock(event_queue_mutex_, std::defer_lock);
+	for(;;) {
+		post_expired_timers();
+		lock.lock();
+
+		for(std::shared_ptr<slirc::event> ev; fetched < max_events && (ev = pop_queued_event()); ++fetched) {
+			sink(sink_context, std::move(ev));
+		}
+		if (
+			fetched != 0
+			|| shutting_down_
+			|| std::chrono::steady_clock::now() >= give_up_at
+		) {
+			break;
+		}
+
+		// Wake up for the earliest timer as well; timers are only posted here.
+		const auto wake_up_at = std::min(give_up_at, next_timer_deadline());
+		wait_for_event_queue(
+			event_queue_condition_,
 			lock,
-			timeout,
+			wake_up_at,
 			[&]{
 				return
 					shutting_down_
-					|| !event_queue_front_.empty()
-					|| event_queue_back_skip_ < event_queue_back_.size();
+					|| next_timer_deadline() < wake_up_at
+					|| std::any_of(
+						event_lanes_.begin(),
+						event_lanes_.end(),
+						[](const auto &lane) { return lane->has_queued_events(); }
+					);
+			}
+		);
+		lock.unlock();
+	}
+	lock.unlock();
+
+	// also after fetching nothing, so a stale signal does not keep the
+	// wait handle readable
+	reset_wait_handle();
+	if (fetched != 0) {
+		event_queue_shrunk();
+	}
+	return fetched;
+}
+
+void slirc::irc::async_fetch_event(async_handler handler) {
+	boost::asio::io_service &io_service = get_io_service(*this);
+
+	if (auto ev = fetch_event(std::chrono::milliseconds(0))) {
+		io_service.post([handler = std::move(handler), ev = std::move(ev)]{
+			handler(ev);
+		});
+		return;
+	}
+
+	{ std::lock_guard<std::mutex> lock(async_fetch_->mutex);
+		if (async_fetch_->handler) {
+			throw std::logic_error("slirc::irc::async_fetch_event(): Another asynchronous fetch is pending.");
+		}
+		async_fetch_->handler = std::move(handler);
+		async_fetch_->io_service = &io_service;
+
+		if (
+			const auto deadline = next_timer_deadline();
+			deadline != std::chrono::steady_clock::time_point::max()
+		) {
+			async_fetch_->timer = std::make_unique<boost::asio::steady_timer>(io_service);
+			async_fetch_->timer->expires_at(deadline);
+			async_fetch_->timer->async_wait([this](const boost::system::error_code &error) {
+				if (!error) {
+					notify_async_fetch();
+				}
+			});
+		}
+		async_fetch_waiting_ = true;
+	}
+
+	// Producers count their events before checking for a pending fetch, so
+	// anything posted since the fetch above is seen here.
+	if (event_queue_depth_ != 0) {
+		notify_async_fetch();
+	}
+}
+
+slirc::irc::connection_type slirc::irc::async_wait_for(const slirc::event_id &id, async_handler handler) {
+	boost::asio::io_service &io_service = get_io_service(*this);
+
+	// Concurrent emits may run the handler below at once, before either
+	// disconnects it, so only the first one to set the flag posts.
+	auto fired = std::make_shared<std::atomic<bool>>(false);
+	return connect(id, [&io_service, handler = std::move(handler), fired = std::move(fired)](event &ev, connection_type connection) {
+		if (fired->exchange(true)) {
+			return;
+		}
+		connection.disconnect();
+		io_service.post([handler, ev = ev.shared_from_this()]{
+			handler(ev);
+		});
+	});
+}
+
+void slirc::irc::post_event_back(slirc::event &ev, std::size_t lane) {
+	assert(&(ev.irc) == this && "Must post event to correct IRC context!");
+
+	event_lane &target = *event_lanes_.at(lane);
+	if (has_post_observer_) {
+		observe_post(ev, lane, false);
+	}
+	enqueue_event_back(ev, target);
+}
+
+void slirc::irc::enqueue_event_back(slirc::event &ev, event_lane &target) {
+	if (event_queue_lock_free_) {
+		if (!reserve_event_queue_slot_lock_free()) {
+			return;
+		}
+
+		// count first, so depth never underflows when the consumer is faster
+		++target.depth;
+		target.back_inbox.push(ev.shared_from_this());
+		notify_event_queue_consumer();
+	}
+	else {
+		{ std::unique_lock<std::mutex> lock(event_queue_mutex_);
+			if (!reserve_event_queue_slot_locked(lock, target, ev)) {
+				return;
+			}
+
+			target.compact_back();
+			ev.queue_order_ = event_queue_order_++;
+			target.back.push_back(ev.shared_from_this());
+			++target.depth;
+		}
+		event_queue_condition_.notify_one();
+	}
+	ev.trace(event_trace::phase::posted_back);
+
+	notify_scheduler();
+	notify_wait_handle();
+	notify_async_fetch();
+	event_queue_grown();
+}
+
+void slirc::irc::post_event_front(slirc::event &ev, std::size_t lane) {
+	assert(&(ev.irc) == this && "Must post event to correct IRC context!");
+
+	event_lane &target = *event_lanes_.at(lane);
+	if (has_post_observer_) {
+		observe_post(ev, lane, true);
+	}
+
+	if (event_queue_lock_free_) {
+		if (!reserve_event_queue_slot_lock_free()) {
+			return;
+		}
+
+		++target.depth;
+		target.front_inbox.push(ev.shared_from_this());
+		notify_event_queue_consumer();
+	}
+	else {
+		{ std::unique_lock<std::mutex> lock(event_queue_mutex_);
+			if (!reserve_event_queue_slot_locked(lock, target, ev)) {
+				return;
+			}
+
+			ev.queue_order_ = event_queue_order_++;
+			target.front.push_back(ev.shared_from_this());
+			++target.depth;
+		}
+		event_queue_condition_.notify_one();
+	}
+	ev.trace(event_trace::phase::posted_front);
+
+	notify_scheduler();
+	notify_wait_handle();
+	notify_async_fetch();
+	event_queue_grown();
+}
+
+void slirc::irc::observe_post(slirc::event &ev, std::size_t lane, bool front) {
+	const auto observer = post_observer_.read();
+	if (*observer) {
+		(*observer)(ev, lane, front);
+	}
+}
+
+slirc::irc::post_observer slirc::irc::set_post_observer(post_observer observer) {
+	post_observer previous;
+	has_post_observer_ = static_cast<bool>(observer);
+	post_observer_.update([&](post_observer &current) {
+		previous = std::move(current);
+		current = std::move(observer);
+	});
+	return previous;
+}
+
+slirc::util::timer_handle slirc::irc::post_event_at(slirc::event &ev, std::chrono::steady_clock::time_point deadline, std::size_t lane) {
+	assert(&(ev.irc) == this && "Must post event to correct IRC context!");
+
+	if (lane >= event_lanes_.size()) {
+		throw std::out_of_range("slirc::irc::post_event_at(): Event lane does not exist.");
+	}
+
+	util::timer_handle retval;
+	bool earliest;
+	{ std::lock_guard<std::mutex> lock(timer_mutex_);
+		retval = timers_.insert(util::timer_tick_until(timer_epoch_, deadline), delayed_event{ ev.shared_from_this(), lane });
+		const timer_tick next_tick = timers_.next_deadline().value_or(no_timer);
+		earliest = next_tick < next_timer_tick_;
+		next_timer_tick_ = next_tick;
+	}
+
+	if (earliest) {
+		// consumers may be waiting for a later deadline
+		{ std::lock_guard<std::mutex> lock(event_queue_mutex_);
+			event_queue_condition_.notify_all();
+		}
+		notify_scheduler_at(next_timer_deadline());
+		notify_async_fetch();
+	}
+	return retval;
+}
+
+bool slirc::irc::cancel_timer(slirc::util::timer_handle timer) {
+	std::lock_guard<std::mutex> lock(timer_mutex_);
+	if (!timers_.cancel(timer)) {
+		return false;
+	}
+	next_timer_tick_ = timers_.next_deadline().value_or(no_timer);
+	return true;
+}
+
+std::size_t slirc::irc::pending_timers() const {
+	std::lock_guard<std::mutex> lock(timer_mutex_);
+	return timers_.size();
+}
+
+void slirc::irc::set_event_lanes(std::vector<unsigned> weights, lane_scheduling scheduling, std::size_t default_lane) {
+	if (weights.empty()) {
+		throw std::invalid_argument("slirc::irc::set_event_lanes(): At least one event lane is required.");
+	}
+	if (std::find(weights.begin(), weights.end(), 0) != weights.end()) {
+		throw std::invalid_argument("slirc::irc::set_event_lanes(): Event lane weights must not be 0.");
+	}
+	if (default_lane >= weights.size()) {
+		throw std::invalid_argument("slirc::irc::set_event_lanes(): Default event lane does not exist.");
+	}
+
+	std::lock_guard<std::mutex> lock(event_queue_mutex_);
+
+	std::vector<std::unique_ptr<event_lane>> removed_lanes;
+	if (event_lanes_.size() > weights.size()) {
+		removed_lanes.insert(
+			removed_lanes.end(),
+			std::make_move_iterator(event_lanes_.begin() + weights.size()),
+			std::make_move_iterator(event_lanes_.end())
+		);
+	}
+	event_lanes_.resize(weights.size());
+
+	for(std::size_t lane = 0; lane != weights.size(); ++lane) {
+		if (event_lanes_[lane]) {
+			event_lanes_[lane]->weight = event_lanes_[lane]->credit = weights[lane];
+		}
+		else {
+			event_lanes_[lane] = std::make_unique<event_lane>(weights[lane]);
+		}
+	}
+
+	event_lane &target = *event_lanes_[default_lane];
+	for(const auto &removed: removed_lanes) {
+		removed->collect_front_inbox();
+		removed->collect_back_inbox();
+		target.compact_back();
+		target.front.insert(
+			target.front.begin(),
+			std::make_move_iterator(removed->front.begin()),
+			std::make_move_iterator(removed->front.end())
+		);
+		target.back.insert(
+			target.back.end(),
+			std::make_move_iterator(removed->back.begin() + removed->back_skip),
+			std::make_move_iterator(removed->back.end())
+		);
+		target.depth += removed->depth;
+	}
+
+	event_lane_scheduling_ = scheduling;
+	default_event_lane_ = default_lane;
+}
+
+void slirc::irc::set_event_queue_capacity(std::size_t capacity, overflow_policy policy) {
+	if (capacity == 0) {
+		throw std::invalid_argument("slirc::irc::set_event_queue_capacity(): Capacity must not be 0.");
+	}
+
+	std::lock_guard<std::mutex> lock(event_queue_mutex_);
+	if (
+		event_queue_lock_free_
+		&& (policy == overflow_policy::drop_oldest || policy == overflow_policy::coalesce)
+	) {
+		throw std::logic_error(
+			"slirc::irc::set_event_queue_capacity(): The lock-free event queue "
+			"does not support dropping the oldest or coalescing events."
+		);
+	}
+
+	event_queue_capacity_ = capacity;
+	event_queue_overflow_policy_ = policy;
+	event_queue_space_condition_.notify_all();
+}
+
+void slirc::irc::unset_event_queue_capacity() {
+	std::lock_guard<std::mutex> lock(event_queue_mutex_);
+	event_queue_capacity_ = std::numeric_limits<std::size_t>::max();
+	event_queue_overflow_policy_ = overflow_policy::block;
+	event_queue_space_condition_.notify_all();
+}
+
+void slirc::irc::set_event_queue_watermarks(std::size_t high_watermark, std::size_t low_watermark) {
+	if (low_watermark >= high_watermark) {
+		throw std::invalid_argument("slirc::irc::set_event_queue_watermarks(): Low watermark must be below high watermark.");
+	}
+
+	std::lock_guard<std::mutex> lock(event_queue_mutex_);
+	event_queue_high_watermark_ = high_watermark;
+	event_queue_low_watermark_ = low_watermark;
+}
+
+void slirc::irc::use_locked_event_queue() {
+	std::lock_guard<std::mutex> lock(event_queue_mutex_);
+	if (event_queue_lock_free_) {
+		// carry over events that have not been picked up by the consumer yet
+		for(const auto &lane: event_lanes_) {
+			lane->collect_front_inbox();
+			lane->collect_back_inbox();
+		}
+		event_queue_lock_free_ = false;
+	}
+}
+
+void slirc::irc::use_lock_free_event_queue() {
+	std::lock_guard<std::mutex> lock(event_queue_mutex_);
+	if (
+		event_queue_overflow_policy_ == overflow_policy::drop_oldest
+		|| event_queue_overflow_policy_ == overflow_policy::coalesce
+	) {
+		throw std::logic_error(
+			"slirc::irc::use_lock_free_event_queue(): The lock-free event queue "
+			"does not support dropping the oldest or coalescing events."
+		);
+	}
+	event_queue_lock_free_ = true;
+}
+
+void slirc::irc::notify_event_queue_consumer() {
+	// Only needed for the lock-free event queue; the consumer publishes that
+	// it is about to block, so producers can skip the mutex otherwise.
+	if (event_queue_consumer_waiting_) {
+		std::lock_guard<std::mutex> lock(event_queue_mutex_);
+		event_queue_condition_.notify_one();
+	}
+}
+
+void slirc::irc::notify_scheduler() {
+	if (!scheduler_) {
+		return;
+	}
+
+	// Announce ourselves before looking at the scheduler again, so that
+	// scheduler::detach() can wait for us if it detached meanwhile.
+	++scheduler_users_;
+	if (scheduler * const attached_scheduler = scheduler_) {
+		attached_scheduler->schedule(*this);
+	}
+	--scheduler_users_;
+}
+
+void slirc::irc::notify_scheduler_at(std::chrono::steady_clock::time_point deadline) {
+	if (!scheduler_) {
+		return;
+	}
+
+	++scheduler_users_;
+	if (scheduler * const attached_scheduler = scheduler_) {
+		attached_scheduler->schedule_at(*this, deadline);
+	}
+	--scheduler_users_;
+}
+
+int slirc::irc::enable_wait_handle() {
+#ifdef __linux__
+	if (wait_handle_ == -1) {
+		wait_handle_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (wait_handle_ == -1) {
+			throw std::system_error(errno, std::system_category(), "slirc::irc::enable_wait_handle(): Could not create eventfd");
+		}
+		wait_handle_signalled_ = false;
+		if (event_queue_depth_ != 0) {
+			notify_wait_handle();
+		}
+	}
+	return wait_handle_;
+#else
+	throw std::logic_error("slirc::irc::enable_wait_handle(): Wait handles are not supported on this platform.");
+#endif
+}
+
+void slirc::irc::disable_wait_handle() {
+#ifdef __linux__
+	if (wait_handle_ != -1) {
+		::close(wait_handle_);
+		wait_handle_ = -1;
+	}
+#endif
+}
+
+void slirc::irc::notify_wait_handle() {
+#ifdef __linux__
+	// Only the transition to a non-empty queue writes to the eventfd, so a
+	// burst of posts results in a single wakeup.
+	if (wait_handle_ != -1 && !wait_handle_signalled_.exchange(true)) {
+		const eventfd_t one = 1;
+		[[maybe_unused]] const auto written = ::write(wait_handle_, &one, sizeof(one));
+	}
+#endif
+}
+
+void slirc::irc::notify_async_fetch() {
+	if (!async_fetch_waiting_) {
+		return;
+	}
+
+	async_handler handler;
+	boost::asio::io_service *io_service;
+	{ std::lock_guard<std::mutex> lock(async_fetch_->mutex);
+		if (!async_fetch_->handler) {
+			return;
+		}
+		async_fetch_waiting_ = false;
+		async_fetch_->timer.reset();
+		handler = std::move(async_fetch_->handler);
+		io_service = async_fetch_->io_service;
+	}
+
+	// Fetch on the io_service rather than on the posting thread. If the event
+	// is gone by then (or a timer had not expired yet), wait again.
+	io_service->post([this, handler = std::move(handler)]() mutable {
+		if (auto ev = fetch_event(std::chrono::milliseconds(0))) {
+			handler(std::move(ev));
+		}
+		else {
+			async_fetch_event(std::move(handler));
+		}
+	});
+}
+
+void slirc::irc::reset_wait_handle() {
+#ifdef __linux__
+	if (wait_handle_ == -1 || event_queue_depth_ != 0) {
+		return;
+	}
+
+	// Drain the eventfd before clearing the flag, so the read can not swallow
+	// the signal of a producer that saw the flag cleared. Producers count
+	// their event before looking at the flag, so either they see it cleared
+	// and signal again, or we see their event below.
+	eventfd_t value;
+	[[maybe_unused]] const auto read = ::read(wait_handle_, &value, sizeof(value));
+	wait_handle_signalled_ = false;
+	if (event_queue_depth_ != 0) {
+		notify_wait_handle();
+	}
+#endif
+}
+
+std::chrono::steady_clock::time_point slirc::irc::next_timer_deadline() const noexcept {
+	return util::timer_tick_deadline(timer_epoch_, next_timer_tick_);
+}
+
+void slirc::irc::post_expired_timers() {
+	const auto now = std::chrono::steady_clock::now();
+	if (now < next_timer_deadline()) {
+		return;
+	}
+
+	std::vector<delayed_event> expired;
+	{ std::lock_guard<std::mutex> lock(timer_mutex_);
+		timers_.advance(util::timer_tick_at(timer_epoch_, now), [&](delayed_event &&timer) {
+			expired.push_back(std::move(timer));
+		});
+		next_timer_tick_ = timers_.next_deadline().value_or(no_timer);
+	}
+
+	if (const auto next_deadline = next_timer_deadline(); next_deadline != std::chrono::steady_clock::time_point::max()) {
+		notify_scheduler_at(next_deadline);
+	}
+	if (expired.empty()) {
+		return;
+	}
+
+	// The events were accepted when their timers were added, so they are
+	// neither dropped nor blocked on here. Blocking would deadlock anyway, as
+	// this runs on the thread fetching events.
+	for(const auto &timer: expired) {
+		if (has_post_observer_) {
+			observe_post(*timer.ev, (timer.lane < event_lanes_.size()) ? timer.lane : default_event_lane_, false);
+		}
+		timer.ev->trace(event_trace::phase::posted_back);
+	}
+	event_queue_depth_ += expired.size();
+	if (event_queue_lock_free_) {
+		for(auto &timer: expired) {
+			event_lane &target = *event_lanes_[(timer.lane < event_lanes_.size()) ? timer.lane : default_event_lane_];
+			++target.depth;
+			target.back_inbox.push(std::move(timer.ev));
+		}
+	}
+	else {
+		{ std::lock_guard<std::mutex> lock(event_queue_mutex_);
+			for(auto &timer: expired) {
+				event_lane &target = *event_lanes_[(timer.lane < event_lanes_.size()) ? timer.lane : default_event_lane_];
+				target.compact_back();
+				timer.ev->queue_order_ = event_queue_order_++;
+				target.back.push_back(std::move(timer.ev));
+				++target.depth;
+			}
+		}
+		event_queue_condition_.notify_all();
+	}
+
+	notify_wait_handle();
+	event_queue_grown();
+}
+
+bool slirc::irc::try_reserve_event_queue_slots(std::size_t count) noexcept {
+	if (event_queue_capacity_ == std::numeric_limits<std::size_t>::max()) {
+		event_queue_depth_ += count;
+		return true;
+	}
+
+	std::size_t depth = event_queue_depth_;
+	do {
+		if (depth > event_queue_capacity_ || event_queue_capacity_ - depth < count) {
+			return false;
+		}
+	} while(!event_queue_depth_.compare_exchange_weak(depth, depth + count));
+	return true;
+}
+
+bool slirc::irc::reserve_event_queue_slot_locked(std::unique_lock<std::mutex> &lock, event_lane &target, slirc::event &ev) {
+	while(!try_reserve_event_queue_slots(1)) {
+		switch(event_queue_overflow_policy_) {
+			case overflow_policy::block:
+				++event_queue_producers_waiting_;
+				event_queue_space_condition_.wait(lock, [&]{
+					return shutting_down_ || event_queue_depth_ < event_queue_capacity_;
+				});
+				--event_queue_producers_waiting_;
+				if (shutting_down_) {
+					return false;
+				}
+				break;
+
+			case overflow_policy::drop_oldest:
+				if (!drop_oldest_event_locked()) {
+					return false;
+				}
+				break;
+
+			case overflow_policy::drop_newest:
+				return false;
+
+			case overflow_policy::coalesce: {
+				const auto same_id = [&](const std::shared_ptr<event> &queued) {
+					return queued->original_id == ev.original_id;
+				};
+				if (
+					const auto it = std::find_if(target.front.begin(), target.front.end(), same_id);
+					it != target.front.end()
+				) {
+					// takes over the place of the queued event
+					ev.queue_order_ = (*it)->queue_order_;
+					*it = ev.shared_from_this();
+				}
+				else if (
+					const auto it = std::find_if(target.back.begin() + target.back_skip, target.back.end(), same_id);
+					it != target.back.end()
+				) {
+					ev.queue_order_ = (*it)->queue_order_;
+					*it = ev.shared_from_this();
+				}
+				return false;
 			}
-		)
+		}
+	}
+	return true;
+}
+
+bool slirc::irc::reserve_event_queue_slot_lock_free() {
+	while(!try_reserve_event_queue_slots(1)) {
+		if (event_queue_overflow_policy_ != overflow_policy::block) {
+			// drop_newest; the other policies are rejected for the lock-free queue
+			return false;
+		}
+
+		std::unique_lock<std::mutex> lock(event_queue_mutex_);
+		++event_queue_producers_waiting_;
+		event_queue_space_condition_.wait(lock, [&]{
+			return shutting_down_ || event_queue_depth_ < event_queue_capacity_;
+		});
+		--event_queue_producers_waiting_;
+		if (shutting_down_) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool slirc::irc::drop_oldest_event_locked() {
+	for(auto lane = event_lanes_.rbegin(); lane != event_lanes_.rend(); ++lane) {
+		event_lane &victim = **lane;
+		const bool has_back = victim.back_skip < victim.back.size();
+		if (
+			!victim.front.empty()
+			// the front is fetched from its end, so its oldest event comes first
+			&& (!has_back || victim.front.front()->queue_order_ < victim.back[victim.back_skip]->queue_order_)
+		) {
+			victim.front.erase(victim.front.begin());
+		}
+		else if (has_back) {
+			victim.back[victim.back_skip].reset();
+			++victim.back_skip;
+		}
+		else {
+			continue;
+		}
+		--victim.depth;
+		--event_queue_depth_;
+		return true;
+	}
+	return false;
+}
+
+void slirc::irc::event_queue_grown() {
+	if (
+		event_queue_depth_ >= event_queue_high_watermark_
+		&& !event_queue_above_high_watermark_
+		&& !event_queue_above_high_watermark_.exchange(true)
 	) {
-		return {};
+		const auto ev = make_event(on_event_queue_high_watermark);
+		emit_event(*ev);
 	}
+}
 
+void slirc::irc::event_queue_shrunk() {
+	if (event_queue_producers_waiting_ != 0) {
+		std::lock_guard<std::mutex> lock(event_queue_mutex_);
+		event_queue_space_condition_.notify_all();
+	}
+
+	if (
+		event_queue_above_high_watermark_
+		&& event_queue_depth_ <= event_queue_low_watermark_
+		&& event_queue_above_high_watermark_.exchange(false)
+	) {
+		const auto ev = make_event(on_event_queue_low_watermark);
+		emit_event(*ev);
+	}
+}
+
+std::shared_ptr<slirc::event> slirc::irc::pop_queued_event() {
+	// Caller needs to own the lanes' front and back vectors, i.e. either hold
+	// the event queue mutex or be the consumer of the lock-free event queue.
 	std::shared_ptr<slirc::event> retval;
-	if (!event_queue_front_.empty()) {
-		retval = event_queue_front_.back();
-		event_queue_front_.pop_back();
+	if (event_lane_scheduling_ == lane_scheduling::strict_priority) {
+		for(const auto &lane: event_lanes_) {
+			if (lane->has_queued_events()) {
+				retval = lane->pop();
+				break;
+			}
+		}
 	}
-	else if (event_queue_back_skip_ < event_queue_back_.size()) {
-		retval = std::move(event_queue_back_[event_queue_back_skip_]);
-		++event_queue_back_skip_;
+	else {
+		// Weighted round robin: Every lane may deliver as many events per round
+		// as its weight allows. A new round starts once no lane with events
+		// left has any credit left.
+		for(int round = 0; !retval && round != 2; ++round) {
+			for(const auto &lane: event_lanes_) {
+				if (lane->credit != 0 && lane->has_queued_events()) {
+					--lane->credit;
+					retval = lane->pop();
+					break;
+				}
+			}
+			if (!retval) {
+				for(const auto &lane: event_lanes_) {
+					lane->credit = lane->weight;
+				}
+			}
+		}
+	}
+
+	if (retval) {
+		--event_queue_depth_;
+		retval->trace(event_trace::phase::fetched);
 	}
 	return retval;
 }
 
-void slirc::irc::post_event_back(slirc::event &ev) {
-	assert(&(ev.irc) == this && "Must post event to correct IRC context!");
+std::shared_ptr<slirc::event> slirc::irc::pop_event_lock_free() {
+	// The lanes' front and back vectors are owned by the (single) consumer
+	// while the lock-free event queue is in use. Producers only ever touch the
+	// inboxes.
+	for(const auto &lane: event_lanes_) {
+		// Everything in the front inbox is newer than what has already been
+		// moved to the front vector, so it always has to be picked up.
+		lane->collect_front_inbox();
 
-	std::lock_guard<std::mutex> lock(event_queue_mutex_);
+		// Everything in the back inbox is newer than what is left in the back
+		// vector, so it is sufficient to pick it up once the vector is drained.
+		// This also means the vector never needs to be compacted.
+		if (lane->back_skip == lane->back.size()) {
+			lane->collect_back_inbox();
+		}
+	}
+	return pop_queued_event();
+}
+
+slirc::irc::event_lane::event_lane(unsigned weight)
+: weight(weight)
+, credit(weight)
+, front()
+, back()
+, back_skip(0)
+, front_inbox()
+, back_inbox()
+, depth(0) {}
 
+bool slirc::irc::event_lane::has_queued_events() const noexcept {
+	return !front.empty() || back_skip < back.size();
+}
+
+bool slirc::irc::event_lane::has_inbox_events() const noexcept {
+	return !front_inbox.empty() || !back_inbox.empty();
+}
+
+void slirc::irc::event_lane::compact_back() {
 	if (
-		event_queue_back_.size()/2 < event_queue_back_skip_
-		&& event_queue_back_.size() == event_queue_back_.capacity()
+		back.size()/2 < back_skip
+		&& back.size() == back.capacity()
 	) {
-		event_queue_back_.erase(
+		// move pending events to front of vector rather than reallocating
+		back.erase(
 			std::copy(
-				event_queue_back_.begin() + event_queue_back_skip_,
-				event_queue_back_.end(),
-				event_queue_back_.begin()
+				std::make_move_iterator(back.begin() + back_skip),
+				std::make_move_iterator(back.end()),
+				back.begin()
 			),
-			event_queue_back_.end()
+			back.end()
 		);
-		event_queue_back_skip_ = 0;
+		back_skip = 0;
 	}
+}
 
-	event_queue_back_.push_back(ev.shared_from_this());
+void slirc::irc::event_lane::collect_front_inbox() {
+	front_inbox.consume_all([&](std::shared_ptr<event> &&ev) {
+		front.push_back(std::move(ev));
+	});
 }
 
-void slirc::irc::post_event_front(slirc::event &ev) {
-	assert(&(ev.irc) == this && "Must post event to correct IRC context!");
+void slirc::irc::event_lane::collect_back_inbox() {
+	if (back_skip == back.size()) {
+		back.clear();
+		back_skip = 0;
+	}
+	else {
+		compact_back();
+	}
+	back_inbox.consume_all([&](std::shared_ptr<event> &&ev) {
+		back.push_back(std::move(ev));
+	});
+}
 
-	std::lock_guard<std::mutex> lock(event_queue_mutex_);
-	event_queue_front_.push_back(ev.shared_from_this());
+std::shared_ptr<slirc::event> slirc::irc::event_lane::pop() {
+	std::shared_ptr<slirc::event> retval;
+	if (!front.empty()) {
+		retval = std::move(front.back());
+		front.pop_back();
+	}
+	else if (back_skip < back.size()) {
+		retval = std::move(back[back_skip]);
+		++back_skip;
+	}
+	else {
+		return retval;
+	}
+	--depth;
+	return retval;
 }
 
-slirc::irc::event_scoped_connection::event_scoped_connection(slirc::event &ev, slirc::irc::connection_type connection)
-: ev(ev) {
-	ev.data.insert(connection);
+slirc::irc::handler_entry::handler_entry(const slirc::event_id &id, callback_type callback, int category, group_type group, bool concurrent)
+: id(id)
+, callback(std::move(callback))
+, category(category)
+, group(group)
+, concurrent(concurrent)
+, connection()
+, connected(true)
+, registry() {}
+
+void slirc::irc::handler_registry::add(const std::shared_ptr<handler_entry> &entry, connect_position position) {
+	if (!entry->route) {
+		table.update([&](handler_table &handlers) {
+			if (handlers.size() <= entry->id.index()) {
+				handlers.resize(entry->id.index() + 1);
+			}
+			auto &list = handlers[entry->id.index()];
+			list = with(list.get(), entry, position);
+		});
+		return;
+	}
+
+	routes.update([&](route_table &route_indices) {
+		if (route_indices.size() <= entry->id.index()) {
+			route_indices.resize(entry->id.index() + 1);
+		}
+		auto &indices = route_indices[entry->id.index()];
+		auto index = std::find_if(indices.begin(), indices.end(), [&](const auto &route) {
+			return route->kind == entry->route->kind;
+		});
+		auto updated = (index != indices.end())
+			? std::make_shared<route_index>(**index)
+			: std::make_shared<route_index>(route_index{ entry->route->kind, entry->route->key_of, {} });
+
+		auto &list = updated->handlers[entry->route->key];
+		list = with(list.get(), entry, position);
+		if (index != indices.end()) {
+			*index = std::move(updated);
+		}
+		else {
+			indices.push_back(std::move(updated));
+		}
+	});
+}
+
+void slirc::irc::handler_registry::remove(const handler_entry &entry) {
+	if (!entry.route) {
+		table.update([&](handler_table &handlers) {
+			if (handlers.size() <= entry.id.index() || !handlers[entry.id.index()]) {
+				return;
+			}
+			auto &list = handlers[entry.id.index()];
+			list = without(*list, entry);
+		});
+		return;
+	}
+
+	routes.update([&](route_table &route_indices) {
+		if (route_indices.size() <= entry.id.index()) {
+			return;
+		}
+		auto &indices = route_indices[entry.id.index()];
+		const auto index = std::find_if(indices.begin(), indices.end(), [&](const auto &route) {
+			return route->kind == entry.route->kind;
+		});
+		if (index == indices.end()) {
+			return;
+		}
+		const auto routed = (*index)->handlers.find(entry.route->key);
+		if (routed == (*index)->handlers.end()) {
+			return;
+		}
+
+		auto updated = std::make_shared<route_index>(**index);
+		if (auto list = without(*routed->second, entry)) {
+			updated->handlers[entry.route->key] = std::move(list);
+		}
+		else {
+			updated->handlers.erase(entry.route->key);
+		}
+		if (updated->handlers.empty()) {
+			indices.erase(index);
+		}
+		else {
+			*index = std::move(updated);
+		}
+	});
+}
+
+std::shared_ptr<const slirc::irc::handler_list> slirc::irc::handler_registry::with(const handler_list *list, const std::shared_ptr<handler_entry> &entry, connect_position position) {
+	auto updated = list ? std::make_shared<handler_list>(*list) : std::make_shared<handler_list>();
+
+	// keep the list ordered by category, then group
+	const auto key = std::make_pair(entry->category, entry->group);
+	const auto insert_at = (position == at_front)
+		? std::find_if(updated->begin(), updated->end(), [&](const auto &handler) {
+			return std::make_pair(handler->category, handler->group) >= key;
+		})
+		: std::find_if(updated->begin(), updated->end(), [&](const auto &handler) {
+			return std::make_pair(handler->category, handler->group) > key;
+		});
+	updated->insert(insert_at, entry);
+	return updated;
+}
+
+std::shared_ptr<const slirc::irc::handler_list> slirc::irc::handler_registry::without(const handler_list &list, const handler_entry &entry) {
+	auto updated = std::make_shared<handler_list>();
+	updated->reserve(list.size());
+	std::copy_if(
+		list.begin(), list.end(),
+		std::back_inserter(*updated),
+		[&](const auto &handler) { return handler.get() != &entry; }
+	);
+	if (updated->empty()) {
+		return nullptr;
+	}
+	return updated;
+}
+
+bool slirc::irc::connection_type::connected() const noexcept {
+	const auto entry = entry_.lock();
+	return entry && entry->connected;
 }
 
+void slirc::irc::connection_type::disconnect() const {
+	const auto entry = entry_.lock();
+	if (!entry || !entry->connected.exchange(false)) {
+		return;
+	}
+	if (const auto registry = entry->registry.lock()) {
+		registry->remove(*entry);
+	}
+}
+
+slirc::irc::event_scoped_connection::event_scoped_connection(slirc::event &ev) noexcept
+: ev(ev)
+, previous(ev.current_connection_) {}
+
 slirc::irc::event_scoped_connection::~event_scoped_connection() {
-	ev.data.erase<connection_type>();
+	// restore the connection of the handler that emitted this event, if any
+	ev.current_connection_ = previous;
 }
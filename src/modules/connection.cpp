@@ -25,20 +25,51 @@
 #include "../../include/slirc/modules/connection.hpp"
 
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iterator>
 
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <boost/asio.hpp>
 
 #include "../../include/slirc/event.hpp"
 #include "../../include/slirc/irc.hpp"
+#include "../../include/slirc/util/mpsc_stack.hpp"
+
+namespace {
+	/// \brief Receive buffers no event refers to anymore, filled by the events releasing them
+	using receive_buffer_pool = slirc::util::mpsc_stack<std::unique_ptr<char[]>>;
+}
 
 struct slirc::modules::connection::impl: std::enable_shared_from_this<slirc::modules::connection::impl> {
+	static constexpr std::size_t receive_buffer_size = 65536; ///< @brief Size of each receive buffer
+	static constexpr std::size_t min_read_size = 4096; ///< @brief Space left in a receive buffer below which the next one is started
+	static constexpr std::chrono::milliseconds post_retry_interval{ 1 }; ///< @brief Time between attempts to post lines held back by a full event queue
+
 	impl(slirc::modules::connection &connection)
 	: connection_(connection)
+	, resolver_(connection.io_service_)
+	, socket_(connection.io_service_)
+	, buffer_pool_(std::make_shared<receive_buffer_pool>())
+	, free_buffers_()
+	, buffer_()
+	, line_begin_(0)
+	, received_end_(0)
+	, received_()
+	, post_retry_timer_(connection.io_service_)
+	, low_watermark_connection_()
 	, connection_state_(events::on_disconnected)
-	, asio_(std::make_shared<buffers>()) {
+	, read_stopped_(false)
+	, send_queue_()
+	, sending_()
+	, send_pending_(false)
+	, state_events_()
+	, posting_state_events_(false) {
 		try {
 			connection_.impl_alive_ = true;
 		}
@@ -55,53 +86,408 @@ struct slirc::modules::connection::impl: std::enable_shared_from_this<slirc::mod
 		connection_.impl_alive_ = false;
 	}
 
+	void connect(const std::string &host, unsigned port) {
+		// Reading stops while the event queue is above its high watermark and
+		// resumes with the low watermark event. That is emitted on the thread
+		// crossing the watermark, which may hold locks of its own, so reading
+		// is resumed on the io_service.
+		low_watermark_connection_ = connection_.irc.connect(slirc::irc::on_event_queue_low_watermark, [weak_self = weak_from_this()](slirc::event &) {
+			if (auto self = weak_self.lock()) {
+				self->connection_.io_service_.post([weak_self] {
+					if (auto self = weak_self.lock()) {
+						self->resume_reading();
+					}
+				});
+			}
+		});
+
+		{
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			change_connection_state(events::on_connecting);
+			resolver_.async_resolve(host, std::to_string(port), [weak_self = weak_from_this()](const boost::system::error_code &error, boost::asio::ip::tcp::resolver::results_type endpoints) {
+				if (auto self = weak_self.lock()) {
+					self->resolved(error, endpoints);
+				}
+			});
+		}
+		post_state_events();
+	}
+
 	void shut_down() {
+		{
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			shut_down_locked();
+		}
+		post_state_events();
+	}
+
+	void send(std::string_view data) {
+		std::lock_guard<std::mutex> lock(state_mutex_);
+		if (connection_state_ != events::on_connecting && connection_state_ != events::on_connected) {
+			return;
+		}
+		send_queue_.append(data);
+		if (connection_state_ == events::on_connected && !send_pending_) {
+			start_send();
+		}
+	}
+
+private:
+	void resolved(const boost::system::error_code &error, const boost::asio::ip::tcp::resolver::results_type &endpoints) {
+		if (error) {
+			connecting_failed();
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(state_mutex_);
+		if (connection_state_ != events::on_connecting) {
+			return;
+		}
+		boost::asio::async_connect(socket_, endpoints, [weak_self = weak_from_this()](const boost::system::error_code &error, const boost::asio::ip::tcp::endpoint &) {
+			if (auto self = weak_self.lock()) {
+				self->connected(error);
+			}
+		});
+	}
+
+	void connected(const boost::system::error_code &error) {
+		if (error) {
+			connecting_failed();
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			if (connection_state_ != events::on_connecting) {
+				return;
+			}
+			change_connection_state(events::on_connected);
+			buffer_ = take_buffer();
+			read();
+			if (!send_queue_.empty()) {
+				start_send();
+			}
+		}
+		post_state_events();
+	}
+
+	void connecting_failed() {
+		{
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			if (connection_state_ == events::on_connecting) {
+				change_connection_state(events::on_connecting_failed);
+				change_connection_state(events::on_disconnected);
+			}
+		}
+		post_state_events();
+	}
+
+	void read() {
+		char * const data = buffer_.get();
+		socket_.async_read_some(boost::asio::buffer(data + received_end_, receive_buffer_size - received_end_), [weak_self = weak_from_this()](const boost::system::error_code &error, std::size_t size) {
+			if (auto self = weak_self.lock()) {
+				self->received(error, size);
+			}
+		});
+	}
+
+	void received(const boost::system::error_code &error, std::size_t size) {
+		{
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			if (connection_state_ != events::on_connected) {
+				return;
+			}
+			if (error) {
+				shut_down_locked();
+			}
+			else {
+				const std::size_t scanned_end = received_end_;
+				received_end_ += size;
+				frame_lines(scanned_end);
+
+				if (receive_buffer_size - received_end_ < min_read_size) {
+					if (line_begin_ == 0) {
+						// the line does not fit into a buffer
+						shut_down_locked();
+					}
+					else {
+						// lines already framed keep the old buffer alive, only
+						// the incomplete line is moved to the next one
+						auto next_buffer = take_buffer();
+						std::memcpy(next_buffer.get(), buffer_.get() + line_begin_, received_end_ - line_begin_);
+						received_end_ -= line_begin_;
+						line_begin_ = 0;
+						buffer_ = std::move(next_buffer);
+					}
+				}
+			}
+		}
+
+		// No read is pending, so received_ is still ours.
+		const bool posted = post_received();
+		post_state_events();
+		continue_reading(posted);
+	}
+
+	/**
+	 * \brief Posts the lines framed by \c received().
+	 *
+	 * The io_service must not wait for the thread fetching events, which may
+	 * be tearing this connection down, so lines that do not fit into a full
+	 * event queue under the block overflow policy are held back instead.
+	 *
+	 * \return Whether all lines are posted.
+	 */
+	bool post_received() {
+		auto &context = connection_.irc;
+		if (!context.try_post_events_back(received_.begin(), received_.end())) {
+			// does not fit as a whole; post the lines that still fit
+			auto posted = received_.begin();
+			while(posted != received_.end() && context.try_post_events_back(posted, std::next(posted))) {
+				++posted;
+			}
+			received_.erase(received_.begin(), posted);
+			return false;
+		}
+		received_.clear();
+		return true;
+	}
+
+	/// \brief Starts the next read, unless lines are held back or the event queue is above its high watermark.
+	void continue_reading(bool posted) {
+		std::lock_guard<std::mutex> lock(state_mutex_);
+		if (connection_state_ != events::on_connected) {
+			return;
+		}
+		if (!posted) {
+			// let TCP push back on the server until the lines are posted
+			read_stopped_ = true;
+			post_retry_timer_.expires_after(post_retry_interval);
+			post_retry_timer_.async_wait([weak_self = weak_from_this()](const boost::system::error_code &error) {
+				if (auto self = weak_self.lock(); self && !error) {
+					self->continue_reading(self->post_received());
+				}
+			});
+			return;
+		}
+		if (connection_.irc.event_queue_above_high_watermark()) {
+			// the event queue is above its high watermark; let TCP push back
+			// on the server until it drained to the low watermark
+			read_stopped_ = true;
+			return;
+		}
+		read_stopped_ = false;
+		read();
+	}
+
+	void resume_reading() {
+		std::lock_guard<std::mutex> lock(state_mutex_);
+		if (
+			read_stopped_
+			&& received_.empty() // lines held back are posted by their retry, which reads on
+			&& !connection_.irc.event_queue_above_high_watermark()
+			&& connection_state_ == events::on_connected
+		) {
+			read_stopped_ = false;
+			read();
+		}
+	}
+
+	/// \brief Writes the data queued since the last write, which must have completed.
+	void start_send() {
+		sending_.clear();
+		sending_.swap(send_queue_);
+		send_pending_ = true;
+		boost::asio::async_write(socket_, boost::asio::buffer(sending_), [weak_self = weak_from_this()](const boost::system::error_code &error, std::size_t) {
+			if (auto self = weak_self.lock()) {
+				self->sent(error);
+			}
+		});
+	}
+
+	void sent(const boost::system::error_code &error) {
+		{
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			send_pending_ = false;
+			if (connection_state_ != events::on_connected) {
+				return;
+			}
+			if (error) {
+				shut_down_locked();
+			}
+			else if (!send_queue_.empty()) {
+				start_send();
+			}
+		}
+		post_state_events();
+	}
+
+	/**
+	 * \brief Adds an \c on_message_received event to \c received_ for each
+	 *        complete line received, carrying a view into the receive buffer.
+	 * \param scanned_end The end of the data already searched for line endings.
+	 */
+	void frame_lines(std::size_t scanned_end) {
+		const char * const data = buffer_.get();
+		for(const void *line_feed; (line_feed = std::memchr(data + scanned_end, '\n', received_end_ - scanned_end)); ) {
+			const std::size_t line_end = static_cast<const char*>(line_feed) - data;
+			std::string_view line(data + line_begin_, line_end - line_begin_);
+			if (!line.empty() && line.back() == '\r') {
+				line.remove_suffix(1);
+			}
+
+			auto ev = connection_.irc.make_event(events::on_message_received);
+			ev->push_back(events::on_message_received);
+			ev->data.insert(raw_message{ line, buffer_ });
+			received_.push_back(std::move(ev));
+			line_begin_ = scanned_end = line_end + 1;
+		}
+	}
+
+	/// \brief Gets an unused receive buffer, which goes back to the pool once no event refers to it anymore.
+	std::shared_ptr<char> take_buffer() {
+		if (free_buffers_.empty()) {
+			buffer_pool_->consume_all([this](std::unique_ptr<char[]> &&buffer) {
+				free_buffers_.push_back(std::move(buffer));
+			});
+		}
+
+		std::unique_ptr<char[]> buffer;
+		if (free_buffers_.empty()) {
+			buffer.reset(new char[receive_buffer_size]);
+		}
+		else {
+			buffer = std::move(free_buffers_.back());
+			free_buffers_.pop_back();
+		}
+
+		std::shared_ptr<char> shared_buffer(buffer.get(), [pool = buffer_pool_](char *data) {
+			try {
+				pool->push(std::unique_ptr<char[]>(data));
+			}
+			catch(...) {
+				// the pool failed to take it and freed it instead
+			}
+		});
+		buffer.release();
+		return shared_buffer;
+	}
+
+	void shut_down_locked() {
 		if (connection_state_ != events::on_disconnected) {
 			change_connection_state(events::on_disconnecting);
 		}
 		change_connection_state(events::on_disconnected);
-	}
-
-	struct shared_asio {
-		buffers()
-		: recv_stream_(&recv_buffer_)
-		, send_stream_(&send_buffer_) {}
 
-		boost::asio::basic_streambuf<> recv_buffer_;
-		std::ostream recv_stream_;
-		boost::asio::basic_streambuf<> send_buffer_;
-		std::istream send_stream_;
-	};
-	std::shared_ptr<shared_asio> asio_;
+		// pending operations complete with an error and find the connection down
+		boost::system::error_code ignored;
+		resolver_.cancel();
+		socket_.close(ignored);
+	}
 
-private:
+	/// \brief Changes the connection state; the caller posts the state event by \c post_state_events() after unlocking.
 	void change_connection_state(events new_status) {
 		if (new_status != connection_state_) {
+			connection_state_ = new_status;
 			auto event = connection_.irc.make_event(new_status);
 			event->push_back(events::on_connection_status_changed);
-			event->post_back();
+			state_events_.push_back(std::move(event));
+		}
+	}
+
+	/**
+	 * \brief Posts the state events queued by \c change_connection_state().
+	 *
+	 * State events are posted by one thread at a time, in order; if another
+	 * thread is already posting them, it posts ours as well. They are posted
+	 * past the capacity of a full event queue under the block overflow
+	 * policy, as the thread fetching events may be the one shutting the
+	 * connection down. Must be called without holding \c state_mutex_, as
+	 * posting may call event handlers.
+	 */
+	void post_state_events() {
+		std::unique_lock<std::mutex> lock(state_mutex_);
+		if (posting_state_events_ || state_events_.empty()) {
+			return;
+		}
+
+		posting_state_events_ = true;
+		std::vector<std::shared_ptr<slirc::event>> posting;
+		try {
+			do {
+				posting.swap(state_events_);
+				lock.unlock();
+				if (!connection_.irc.try_post_events_back(posting.begin(), posting.end())) {
+					connection_.irc.force_post_events_back(posting.begin(), posting.end());
+				}
+				posting.clear();
+				lock.lock();
+			} while(!state_events_.empty());
+		}
+		catch(...) {
+			if (!lock.owns_lock()) {
+				lock.lock();
+			}
+			posting_state_events_ = false;
+			throw;
 		}
+		posting_state_events_ = false;
 	}
 
 	slirc::modules::connection &connection_;
-	events connection_state_;
+	boost::asio::ip::tcp::resolver resolver_;
+	boost::asio::ip::tcp::socket socket_;
+
+	// used by the io_service only
+	std::shared_ptr<receive_buffer_pool> buffer_pool_;
+	std::vector<std::unique_ptr<char[]>> free_buffers_;
+	std::shared_ptr<char> buffer_;
+	std::size_t line_begin_; // begin of the incomplete line in buffer_
+	std::size_t received_end_;
+	std::vector<std::shared_ptr<slirc::event>> received_; // lines framed, but not posted yet
+	boost::asio::steady_timer post_retry_timer_;
+
+	slirc::irc::scoped_connection low_watermark_connection_;
+
+	std::mutex state_mutex_;
+		events connection_state_;
+		bool read_stopped_; // no read is pending while the event queue is above its high watermark
+		std::string send_queue_; // data to write once the pending write completed
+		std::string sending_;
+		bool send_pending_;
+		std::vector<std::shared_ptr<slirc::event>> state_events_; // to be posted by post_state_events()
+		bool posting_state_events_;
 };
 
+slirc::modules::connection::connection(slirc::irc &irc, std::string_view host, unsigned port)
+: apis::connection(irc)
+, host_(host)
+, port_(port)
+, io_service_(acquire_io_service())
+, assigned_io_service_(true)
+, impl_()
+, impl_alive_(false) {}
+
 slirc::modules::connection::connection(slirc::irc &irc, std::string_view host, unsigned port, boost::asio::io_service &io_service)
 : apis::connection(irc)
 , host_(host)
 , port_(port)
 , io_service_(io_service)
+, assigned_io_service_(false)
 , impl_()
 , impl_alive_(false) {}
 
 slirc::modules::connection::~connection() {
 	disconnect();
+	if (assigned_io_service_) {
+		release_io_service(io_service_);
+	}
 }
 
 void slirc::modules::connection::connect() {
 	disconnect();
 	impl_ = std::make_shared<impl>(*this);
+	impl_->connect(host_, port_);
 }
 
 void slirc::modules::connection::disconnect() {
@@ -127,5 +513,6 @@ void slirc::modules::connection::disconnect() {
 
 void slirc::modules::connection::send(std::string_view data) {
 	if (impl_) {
+		impl_->send(data);
 	}
 }
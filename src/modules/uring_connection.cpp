@@ -0,0 +1,912 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../include/slirc/modules/uring_connection.hpp"
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../../include/slirc/event.hpp"
+#include "../../include/slirc/irc.hpp"
+
+namespace {
+	int io_uring_setup(unsigned entries, io_uring_params *params) noexcept {
+		return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+	}
+
+	int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) noexcept {
+		return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+	}
+
+	template<typename T>
+	T load_acquire(const T *value) noexcept {
+		return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+	}
+
+	template<typename T>
+	void store_release(T *value, T new_value) noexcept {
+		__atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+	}
+
+	constexpr std::uint64_t no_request = 0; ///< @brief user_data of requests without completion handling
+	constexpr std::uint64_t wake_up_request = 1; ///< @brief user_data of the request waking the completion thread
+	constexpr std::uint16_t receive_buffer_group = 0;
+	constexpr __kernel_timespec post_retry_interval = { 0, 1000000 }; ///< @brief Time between attempts to post lines held back by a full event queue
+
+	/// \brief A request submitted to the io_uring instance, deleted after its last completion
+	struct uring_request {
+		virtual ~uring_request() = default;
+		virtual void complete(const io_uring_cqe &cqe) = 0;
+	};
+
+	/// \brief The io_uring instance, its receive buffers and its completion thread
+	class uring_ring {
+	public:
+		uring_ring(unsigned entries, unsigned buffers, std::size_t buffer_size);
+		~uring_ring();
+
+		/**
+		 * \brief Submits a request.
+		 * \param request The request to complete, or \c nullptr if its completion is ignored.
+		 * \param prepare Fills in the submission queue entry.
+		 */
+		template<typename Prepare>
+		void submit(std::unique_ptr<uring_request> request, Prepare &&prepare) {
+			submit(request ? reinterpret_cast<std::uint64_t>(request.get()) : no_request, std::forward<Prepare>(prepare));
+			if (request) {
+				request.release();
+			}
+		}
+
+		const char *buffer(std::uint16_t id) const noexcept {
+			return buffer_memory_.get() + id * buffer_size_;
+		}
+
+		/// \brief Hands a receive buffer back to the kernel with the next submission.
+		void recycle_buffer(std::uint16_t id) {
+			std::lock_guard<std::mutex> lock(submit_mutex_);
+			recycled_buffers_.push_back(id);
+		}
+
+	private:
+		template<typename Prepare>
+		void submit(std::uint64_t user_data, Prepare &&prepare) {
+			std::lock_guard<std::mutex> lock(submit_mutex_);
+			provide_recycled_buffers();
+			io_uring_sqe &sqe = next_sqe();
+			prepare(sqe);
+			sqe.user_data = user_data;
+			if (user_data > wake_up_request) {
+				++outstanding_;
+			}
+			enter();
+		}
+
+		// all of these require submit_mutex_ to be held
+		io_uring_sqe &next_sqe();
+		void provide_buffers(std::uint16_t first_id, unsigned count);
+		void provide_recycled_buffers();
+		int enter() noexcept;
+
+		bool wake_up() noexcept;
+		void run();
+		void flush_recycled_buffers();
+		void flush_overflow() noexcept;
+		void release() noexcept;
+
+		int fd_;
+		void *sq_ring_;
+		std::size_t sq_ring_size_;
+		void *cq_ring_;
+		std::size_t cq_ring_size_;
+		io_uring_sqe *sqes_;
+		std::size_t sqes_size_;
+
+		unsigned *sq_head_;
+		unsigned *sq_tail_;
+		unsigned *sq_mask_;
+		unsigned *sq_array_;
+		unsigned *sq_flags_;
+		unsigned *cq_head_;
+		unsigned *cq_tail_;
+		unsigned *cq_mask_;
+		io_uring_cqe *cqes_;
+
+		const unsigned buffers_;
+		const std::size_t buffer_size_;
+		std::unique_ptr<char[]> buffer_memory_;
+
+		std::mutex submit_mutex_;
+			unsigned pending_tail_;
+			std::vector<std::uint16_t> recycled_buffers_;
+		std::atomic<std::size_t> outstanding_;
+		std::atomic<bool> stopping_;
+		std::thread thread_;
+	};
+
+	uring_ring::uring_ring(unsigned entries, unsigned buffers, std::size_t buffer_size)
+	: fd_(-1)
+	, sq_ring_(MAP_FAILED)
+	, sq_ring_size_(0)
+	, cq_ring_(MAP_FAILED)
+	, cq_ring_size_(0)
+	, sqes_(static_cast<io_uring_sqe*>(MAP_FAILED))
+	, sqes_size_(0)
+	, buffers_(buffers)
+	, buffer_size_(buffer_size)
+	, buffer_memory_()
+	, pending_tail_(0)
+	, recycled_buffers_()
+	, outstanding_(0)
+	, stopping_(false) {
+		if (buffers == 0 || buffers > 65536) {
+			throw std::invalid_argument("slirc::modules::uring_service: Number of buffers must be between 1 and 65536.");
+		}
+		if (buffer_size == 0 || buffer_size > UINT32_MAX) {
+			throw std::invalid_argument("slirc::modules::uring_service: Invalid buffer size.");
+		}
+
+		try {
+			io_uring_params params;
+			std::memset(&params, 0, sizeof(params));
+			fd_ = io_uring_setup(entries, &params);
+			if (fd_ < 0) {
+				throw std::system_error(errno, std::system_category(), "slirc::modules::uring_service: io_uring_setup() failed");
+			}
+
+			sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+			if (single_mmap) {
+				sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+			}
+
+			sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+			if (sq_ring_ == MAP_FAILED) {
+				throw std::system_error(errno, std::system_category(), "slirc::modules::uring_service: Mapping the submission queue failed");
+			}
+			if (!single_mmap) {
+				cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+				if (cq_ring_ == MAP_FAILED) {
+					throw std::system_error(errno, std::system_category(), "slirc::modules::uring_service: Mapping the completion queue failed");
+				}
+			}
+			sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+			sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+			if (sqes_ == MAP_FAILED) {
+				throw std::system_error(errno, std::system_category(), "slirc::modules::uring_service: Mapping the submission queue entries failed");
+			}
+
+			char * const sq_ring = static_cast<char*>(sq_ring_);
+			char * const cq_ring = static_cast<char*>(single_mmap ? sq_ring_ : cq_ring_);
+			sq_head_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.head);
+			sq_tail_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.tail);
+			sq_mask_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_mask);
+			sq_array_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.array);
+			sq_flags_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.flags);
+			cq_head_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.head);
+			cq_tail_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.tail);
+			cq_mask_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.ring_mask);
+			cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+
+			pending_tail_ = *sq_tail_;
+
+			// receive buffers, picked by the kernel for each multishot receive completion
+			buffer_memory_.reset(new char[buffers_ * buffer_size_]);
+			recycled_buffers_.reserve(buffers_);
+			{
+				std::lock_guard<std::mutex> lock(submit_mutex_);
+				provide_buffers(0, buffers_);
+				if (enter() < 0) {
+					throw std::system_error(errno, std::system_category(), "slirc::modules::uring_service: Providing the receive buffers failed");
+				}
+			}
+
+			thread_ = std::thread([this]() {
+				run();
+			});
+		}
+		catch(...) {
+			release();
+			throw;
+		}
+	}
+
+	uring_ring::~uring_ring() {
+		// the completion thread exits once every request has completed
+		stopping_ = true;
+		// a full submission queue drains as the kernel catches up with the completion thread
+		while(!wake_up()) {
+			std::this_thread::yield();
+		}
+		thread_.join();
+		release();
+	}
+
+	bool uring_ring::wake_up() noexcept {
+		std::lock_guard<std::mutex> lock(submit_mutex_);
+		if (pending_tail_ - load_acquire(sq_head_) > *sq_mask_ && enter() < 0) {
+			return false;
+		}
+
+		io_uring_sqe &sqe = sqes_[pending_tail_ & *sq_mask_];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = IORING_OP_NOP;
+		sqe.user_data = wake_up_request;
+		sq_array_[pending_tail_ & *sq_mask_] = pending_tail_ & *sq_mask_;
+		++pending_tail_;
+		return enter() >= 0;
+	}
+
+	void uring_ring::run() {
+		unsigned head = *cq_head_;
+		while(!stopping_ || outstanding_ != 0) {
+			const unsigned tail = load_acquire(cq_tail_);
+			if (head == tail) {
+				io_uring_enter(fd_, 0, 1, IORING_ENTER_GETEVENTS);
+				continue;
+			}
+
+			for(; head != tail; ++head) {
+				const io_uring_cqe cqe = cqes_[head & *cq_mask_];
+				store_release(cq_head_, head + 1);
+
+				if (cqe.user_data > wake_up_request) {
+					uring_request * const request = reinterpret_cast<uring_request*>(cqe.user_data);
+					const bool last_completion = !(cqe.flags & IORING_CQE_F_MORE);
+					request->complete(cqe);
+					if (last_completion) {
+						delete request;
+						--outstanding_;
+					}
+				}
+			}
+			flush_recycled_buffers();
+			flush_overflow();
+		}
+	}
+
+	void uring_ring::flush_overflow() noexcept {
+		// completions that did not fit the completion queue wait in the kernel until they are asked for
+		if (load_acquire(sq_flags_) & IORING_SQ_CQ_OVERFLOW) {
+			io_uring_enter(fd_, 0, 0, IORING_ENTER_GETEVENTS);
+		}
+	}
+
+	void uring_ring::flush_recycled_buffers() {
+		std::lock_guard<std::mutex> lock(submit_mutex_);
+		if (!recycled_buffers_.empty()) {
+			provide_recycled_buffers();
+			enter();
+		}
+	}
+
+	io_uring_sqe &uring_ring::next_sqe() {
+		if (pending_tail_ - load_acquire(sq_head_) > *sq_mask_ && enter() < 0) {
+			throw std::system_error(errno, std::system_category(), "slirc::modules::uring_service: Submission queue is full");
+		}
+
+		io_uring_sqe &sqe = sqes_[pending_tail_ & *sq_mask_];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sq_array_[pending_tail_ & *sq_mask_] = pending_tail_ & *sq_mask_;
+		++pending_tail_;
+		return sqe;
+	}
+
+	void uring_ring::provide_buffers(std::uint16_t first_id, unsigned count) {
+		io_uring_sqe &sqe = next_sqe();
+		sqe.opcode = IORING_OP_PROVIDE_BUFFERS;
+		sqe.fd = static_cast<std::int32_t>(count);
+		sqe.addr = reinterpret_cast<std::uint64_t>(buffer(first_id));
+		sqe.len = static_cast<std::uint32_t>(buffer_size_);
+		sqe.off = first_id;
+		sqe.buf_group = receive_buffer_group;
+		sqe.user_data = no_request;
+	}
+
+	void uring_ring::provide_recycled_buffers() {
+		// consecutive buffers are provided by a single request
+		std::sort(recycled_buffers_.begin(), recycled_buffers_.end());
+		for(auto first = recycled_buffers_.begin(); first != recycled_buffers_.end();) {
+			auto last = first + 1;
+			while(last != recycled_buffers_.end() && *last == *(last - 1) + 1) {
+				++last;
+			}
+			provide_buffers(*first, static_cast<unsigned>(last - first));
+			first = last;
+		}
+		recycled_buffers_.clear();
+	}
+
+	int uring_ring::enter() noexcept {
+		store_release(sq_tail_, pending_tail_);
+
+		// also submits entries left over by a failed submission
+		int result;
+		while((result = io_uring_enter(fd_, pending_tail_ - load_acquire(sq_head_), 0, 0)) < 0 && errno == EINTR);
+		return result;
+	}
+
+	void uring_ring::release() noexcept {
+		if (sqes_ != MAP_FAILED) {
+			munmap(sqes_, sqes_size_);
+		}
+		if (cq_ring_ != MAP_FAILED) {
+			munmap(cq_ring_, cq_ring_size_);
+		}
+		if (sq_ring_ != MAP_FAILED) {
+			munmap(sq_ring_, sq_ring_size_);
+		}
+		if (fd_ >= 0) {
+			::close(fd_);
+		}
+	}
+
+	/// \brief A socket driven by a \c uring_ring, kept alive by its pending requests
+	class uring_socket: public std::enable_shared_from_this<uring_socket> {
+	public:
+		using events = slirc::apis::connection::events;
+
+		uring_socket(uring_ring &ring, slirc::apis::connection &owner)
+		: ring_(ring)
+		, fd_(-1)
+		, address_()
+		, address_length_(0)
+		, owner_(&owner)
+		, state_(events::on_disconnected)
+		, sending_offset_(0)
+		, send_pending_(false)
+		, receive_request_(no_request)
+		, receive_cancelled_(false)
+		, receive_stopped_(false)
+		, retry_pending_(false)
+		, received_()
+		, state_events_()
+		, posting_(false) {}
+
+		~uring_socket() {
+			if (fd_ >= 0) {
+				::close(fd_);
+			}
+		}
+
+		void connect(const std::string &host, unsigned port);
+		void send(std::string_view data);
+		void close();
+
+	private:
+		template<void (uring_socket::*Completion)(const io_uring_cqe &)>
+		struct request: uring_request {
+			request(std::shared_ptr<uring_socket> socket)
+			: socket(std::move(socket)) {}
+
+			void complete(const io_uring_cqe &cqe) override {
+				(socket.get()->*Completion)(cqe);
+			}
+
+			std::shared_ptr<uring_socket> socket;
+		};
+
+		template<void (uring_socket::*Completion)(const io_uring_cqe &)>
+		std::unique_ptr<uring_request> make_request() {
+			return std::make_unique<request<Completion>>(shared_from_this());
+		}
+
+		void connect_completed(const io_uring_cqe &cqe);
+		void receive_completed(const io_uring_cqe &cqe);
+		void send_completed(const io_uring_cqe &cqe);
+		void resume_completed(const io_uring_cqe &cqe);
+		void retry_completed(const io_uring_cqe &cqe);
+
+		// all of these require mutex_ to be held
+		void start_connect(const std::string &host, unsigned port);
+		void change_state(events new_state);
+		void connecting_failed();
+		void shut_down();
+		void start_receive();
+		void stop_receive();
+		void start_send();
+		void frame_lines(const char *data, std::size_t size);
+		void retry_posting();
+		void post_events(std::unique_lock<std::mutex> &lock);
+
+		uring_ring &ring_;
+		int fd_;
+		sockaddr_storage address_;
+		socklen_t address_length_;
+
+		std::mutex mutex_;
+			slirc::apis::connection *owner_; // nullptr once disconnected
+			events state_;
+			std::string partial_line_;
+			std::string send_queue_;
+			std::string sending_;
+			std::size_t sending_offset_;
+			bool send_pending_;
+			std::uint64_t receive_request_; // no_request if no receive is pending
+			bool receive_cancelled_;
+			bool receive_stopped_; // while the event queue is above its high watermark or lines are held back
+			bool retry_pending_; // a timeout retries posting the lines held back
+			slirc::irc::scoped_connection low_watermark_connection_;
+			std::vector<std::shared_ptr<slirc::event>> received_; // lines framed, but not posted yet
+			std::vector<std::shared_ptr<slirc::event>> state_events_; // state changes, not posted yet
+			bool posting_; // events are being posted by post_events() without holding mutex_
+			std::condition_variable posted_;
+
+		// used by the thread posting only
+		std::vector<std::shared_ptr<slirc::event>> posting_lines_;
+		std::vector<std::shared_ptr<slirc::event>> posting_states_;
+	};
+
+	void uring_socket::connect(const std::string &host, unsigned port) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		start_connect(host, port);
+		post_events(lock);
+	}
+
+	void uring_socket::start_connect(const std::string &host, unsigned port) {
+		change_state(events::on_connecting);
+
+		// Receiving stops while the event queue is above its high watermark
+		// and resumes with the low watermark event. That is emitted on the
+		// thread crossing the watermark, which may be the completion thread
+		// holding mutex_, so receiving is resumed by a request completing.
+		low_watermark_connection_ = owner_->irc.connect(slirc::irc::on_event_queue_low_watermark, [weak_self = weak_from_this()](slirc::event &) {
+			if (auto self = weak_self.lock()) {
+				self->ring_.submit(self->make_request<&uring_socket::resume_completed>(), [](io_uring_sqe &sqe) {
+					sqe.opcode = IORING_OP_NOP;
+				});
+			}
+		});
+
+		addrinfo hints;
+		std::memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo *results = nullptr;
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &results) != 0) {
+			connecting_failed();
+			return;
+		}
+		std::memcpy(&address_, results->ai_addr, results->ai_addrlen);
+		address_length_ = results->ai_addrlen;
+		fd_ = ::socket(results->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		freeaddrinfo(results);
+		if (fd_ < 0) {
+			connecting_failed();
+			return;
+		}
+
+		ring_.submit(make_request<&uring_socket::connect_completed>(), [this](io_uring_sqe &sqe) {
+			sqe.opcode = IORING_OP_CONNECT;
+			sqe.fd = fd_;
+			sqe.addr = reinterpret_cast<std::uint64_t>(&address_);
+			sqe.off = address_length_;
+		});
+	}
+
+	void uring_socket::send(std::string_view data) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!owner_) {
+			return;
+		}
+		send_queue_.append(data);
+		if (state_ == events::on_connected && !send_pending_) {
+			start_send();
+		}
+	}
+
+	void uring_socket::close() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (owner_) {
+			shut_down();
+		}
+		post_events(lock);
+
+		// The irc context may go away once the connection is closed, so wait
+		// for the completion thread to finish posting. That never waits for
+		// the thread fetching events, which may be this one.
+		posted_.wait(lock, [this] {
+			return !posting_;
+		});
+	}
+
+	void uring_socket::connect_completed(const io_uring_cqe &cqe) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (!owner_) {
+			return;
+		}
+		if (cqe.res < 0) {
+			connecting_failed();
+		}
+		else {
+			change_state(events::on_connected);
+			start_receive();
+			if (!send_queue_.empty()) {
+				start_send();
+			}
+		}
+		post_events(lock);
+	}
+
+	void uring_socket::receive_completed(const io_uring_cqe &cqe) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (cqe.flags & IORING_CQE_F_BUFFER) {
+			const auto id = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+			if (owner_ && cqe.res > 0) {
+				frame_lines(ring_.buffer(id), static_cast<std::size_t>(cqe.res));
+			}
+			ring_.recycle_buffer(id);
+		}
+
+		const bool last_completion = !(cqe.flags & IORING_CQE_F_MORE);
+		if (last_completion) {
+			receive_request_ = no_request;
+		}
+		if (!owner_) {
+			return;
+		}
+
+		if (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS && !(cqe.res == -ECANCELED && receive_cancelled_))) {
+			// closed by the peer or failed
+			shut_down();
+		}
+		post_events(lock);
+		if (!owner_) {
+			return;
+		}
+
+		if (!received_.empty() || owner_->irc.event_queue_above_high_watermark()) {
+			// lines are held back by a full event queue or the event queue is
+			// above its high watermark; let TCP push back on the server until
+			// the lines are posted or it drained to the low watermark
+			receive_stopped_ = true;
+			stop_receive();
+			if (!received_.empty()) {
+				retry_posting();
+			}
+		}
+		else if (last_completion) {
+			// the kernel ended the multishot receive, e.g. when running out of
+			// buffers, or it was stopped and the event queue drained meanwhile
+			receive_stopped_ = false;
+			start_receive();
+		}
+	}
+
+	void uring_socket::send_completed(const io_uring_cqe &cqe) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		send_pending_ = false;
+		if (!owner_) {
+			return;
+		}
+		if (cqe.res < 0) {
+			shut_down();
+			post_events(lock);
+			return;
+		}
+
+		sending_offset_ += static_cast<std::size_t>(cqe.res);
+		if (sending_offset_ != sending_.size() || !send_queue_.empty()) {
+			start_send();
+		}
+	}
+
+	void uring_socket::resume_completed(const io_uring_cqe &) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (owner_ && receive_stopped_ && received_.empty() && !owner_->irc.event_queue_above_high_watermark()) {
+			receive_stopped_ = false;
+			if (receive_request_ == no_request) {
+				start_receive();
+			}
+		}
+	}
+
+	void uring_socket::retry_completed(const io_uring_cqe &) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		retry_pending_ = false;
+		if (!owner_) {
+			return;
+		}
+		post_events(lock);
+		if (!owner_) {
+			return;
+		}
+
+		if (!received_.empty()) {
+			retry_posting();
+		}
+		else if (receive_stopped_ && !owner_->irc.event_queue_above_high_watermark()) {
+			receive_stopped_ = false;
+			if (receive_request_ == no_request) {
+				start_receive();
+			}
+		}
+	}
+
+	void uring_socket::change_state(events new_state) {
+		if (new_state != state_) {
+			state_ = new_state;
+			auto event = owner_->irc.make_event(new_state);
+			event->push_back(events::on_connection_status_changed);
+			state_events_.push_back(std::move(event));
+		}
+	}
+
+	void uring_socket::connecting_failed() {
+		change_state(events::on_connecting_failed);
+		change_state(events::on_disconnected);
+		owner_ = nullptr;
+		low_watermark_connection_.disconnect();
+	}
+
+	void uring_socket::shut_down() {
+		if (state_ != events::on_disconnected) {
+			change_state(events::on_disconnecting);
+		}
+		change_state(events::on_disconnected);
+		owner_ = nullptr;
+		low_watermark_connection_.disconnect();
+
+		if (fd_ >= 0) {
+			// completes pending requests; the socket is closed when the last one is done
+			::shutdown(fd_, SHUT_RDWR);
+			ring_.submit(nullptr, [this](io_uring_sqe &sqe) {
+				sqe.opcode = IORING_OP_ASYNC_CANCEL;
+				sqe.fd = fd_;
+				sqe.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+			});
+		}
+	}
+
+	void uring_socket::start_receive() {
+		auto request = make_request<&uring_socket::receive_completed>();
+		const auto user_data = reinterpret_cast<std::uint64_t>(request.get());
+		ring_.submit(std::move(request), [this](io_uring_sqe &sqe) {
+			sqe.opcode = IORING_OP_RECV;
+			sqe.fd = fd_;
+			sqe.flags = IOSQE_BUFFER_SELECT;
+			sqe.buf_group = receive_buffer_group;
+			sqe.ioprio = IORING_RECV_MULTISHOT;
+		});
+		receive_request_ = user_data;
+		receive_cancelled_ = false;
+	}
+
+	void uring_socket::stop_receive() {
+		if (receive_request_ != no_request && !receive_cancelled_) {
+			receive_cancelled_ = true;
+			ring_.submit(nullptr, [this](io_uring_sqe &sqe) {
+				sqe.opcode = IORING_OP_ASYNC_CANCEL;
+				sqe.addr = receive_request_;
+			});
+		}
+	}
+
+	void uring_socket::start_send() {
+		if (sending_offset_ == sending_.size()) {
+			sending_.clear();
+			sending_.swap(send_queue_);
+			sending_offset_ = 0;
+		}
+
+		ring_.submit(make_request<&uring_socket::send_completed>(), [this](io_uring_sqe &sqe) {
+			sqe.opcode = IORING_OP_SEND;
+			sqe.fd = fd_;
+			sqe.addr = reinterpret_cast<std::uint64_t>(sending_.data() + sending_offset_);
+			sqe.len = static_cast<std::uint32_t>(std::min<std::size_t>(sending_.size() - sending_offset_, UINT32_MAX));
+			sqe.msg_flags = MSG_NOSIGNAL;
+		});
+		send_pending_ = true;
+	}
+
+	void uring_socket::frame_lines(const char *data, std::size_t size) {
+		const auto add_line = [this](slirc::apis::connection::raw_message message) {
+			if (!message.line.empty() && message.line.back() == '\r') {
+				message.line.remove_suffix(1);
+			}
+			auto ev = owner_->irc.make_event(events::on_message_received);
+			ev->push_back(events::on_message_received);
+			ev->data.insert(std::move(message));
+			received_.push_back(std::move(ev));
+		};
+
+		// the receive buffer goes back to the kernel right away, so the chunk
+		// is copied once and its lines are views into the copy
+		const auto storage = std::make_shared<const std::string>(data, size);
+		std::string_view chunk(*storage);
+		for(auto end = chunk.find('\n'); end != std::string_view::npos; end = chunk.find('\n')) {
+			if (partial_line_.empty()) {
+				add_line({ chunk.substr(0, end), storage });
+			}
+			else {
+				partial_line_.append(chunk.substr(0, end));
+				add_line(slirc::apis::connection::raw_message::copy(partial_line_));
+				partial_line_.clear();
+			}
+			chunk.remove_prefix(end + 1);
+		}
+		partial_line_.append(chunk);
+	}
+
+	/// \brief Retries posting the lines held back by a full event queue after \c post_retry_interval.
+	void uring_socket::retry_posting() {
+		if (!retry_pending_) {
+			retry_pending_ = true;
+			ring_.submit(make_request<&uring_socket::retry_completed>(), [](io_uring_sqe &sqe) {
+				sqe.opcode = IORING_OP_TIMEOUT;
+				sqe.addr = reinterpret_cast<std::uint64_t>(&post_retry_interval);
+				sqe.len = 1;
+			});
+		}
+	}
+
+	/**
+	 * \brief Posts the lines framed and the state changes made so far, in that order.
+	 *
+	 * Posting must not hold mutex_, which the thread fetching events needs
+	 * to send and disconnect, and must never wait for that thread, which
+	 * close() waits for. So lines that do not fit into a full event queue
+	 * under the block overflow policy are held back in received_, and state
+	 * changes are posted even to a full event queue. Lines held back when
+	 * the state changes are dropped, as they must not follow it. If another
+	 * thread is posting already, it picks up the events before it is done.
+	 *
+	 * \param lock The lock on mutex_, which is released while posting.
+	 */
+	void uring_socket::post_events(std::unique_lock<std::mutex> &lock) {
+		if (posting_) {
+			return;
+		}
+
+		posting_ = true;
+		try {
+			for(bool held_back = false; !state_events_.empty() || (!received_.empty() && !held_back); ) {
+				posting_lines_.swap(received_);
+				posting_states_.swap(state_events_);
+				lock.unlock();
+
+				auto posted = posting_lines_.begin();
+				if (!posting_lines_.empty()) {
+					slirc::irc &irc = posting_lines_.front()->irc;
+					if (irc.try_post_events_back(posting_lines_.begin(), posting_lines_.end())) {
+						posted = posting_lines_.end();
+					}
+					else {
+						// does not fit as a whole; post the lines that still fit
+						while(posted != posting_lines_.end() && irc.try_post_events_back(posted, std::next(posted))) {
+							++posted;
+						}
+					}
+				}
+				if (!posting_states_.empty()) {
+					slirc::irc &irc = posting_states_.front()->irc;
+					if (!irc.try_post_events_back(posting_states_.begin(), posting_states_.end())) {
+						irc.force_post_events_back(posting_states_.begin(), posting_states_.end());
+					}
+				}
+
+				lock.lock();
+				if (posting_states_.empty()) {
+					// lines framed meanwhile follow the ones held back
+					held_back = posted != posting_lines_.end();
+					received_.insert(received_.begin(), std::make_move_iterator(posted), std::make_move_iterator(posting_lines_.end()));
+				}
+				posting_lines_.clear();
+				posting_states_.clear();
+			}
+		}
+		catch(...) {
+			if (!lock.owns_lock()) {
+				lock.lock();
+			}
+			posting_ = false;
+			posted_.notify_all();
+			throw;
+		}
+		posting_ = false;
+		posted_.notify_all();
+	}
+}
+
+struct slirc::modules::uring_service::impl: uring_ring {
+	using uring_ring::uring_ring;
+};
+
+struct slirc::modules::uring_connection::socket: uring_socket {
+	using uring_socket::uring_socket;
+};
+
+slirc::modules::uring_service::uring_service(unsigned entries, unsigned buffers, std::size_t buffer_size)
+: impl_(std::make_unique<impl>(entries, buffers, buffer_size)) {}
+
+slirc::modules::uring_service::~uring_service() = default;
+
+std::shared_ptr<slirc::modules::uring_service> slirc::modules::uring_service::get_default() {
+	static std::mutex default_mutex;
+	static std::weak_ptr<uring_service> default_service;
+
+	std::lock_guard<std::mutex> lock(default_mutex);
+	auto service = default_service.lock();
+	if (!service) {
+		service = std::make_shared<uring_service>();
+		default_service = service;
+	}
+	return service;
+}
+
+slirc::modules::uring_connection::uring_connection(slirc::irc &irc, std::string_view host, unsigned port)
+: uring_connection(irc, host, port, uring_service::get_default()) {}
+
+slirc::modules::uring_connection::uring_connection(slirc::irc &irc, std::string_view host, unsigned port, std::shared_ptr<uring_service> service)
+: apis::connection(irc)
+, host_(host)
+, port_(port)
+, service_(std::move(service))
+, socket_() {}
+
+slirc::modules::uring_connection::~uring_connection() {
+	disconnect();
+}
+
+void slirc::modules::uring_connection::connect() {
+	disconnect();
+	socket_ = std::make_shared<socket>(*service_->impl_, *this);
+	socket_->connect(host_, port_);
+}
+
+void slirc::modules::uring_connection::disconnect() {
+	if (auto socket = std::move(socket_)) {
+		socket->close();
+	}
+}
+
+void slirc::modules::uring_connection::send(std::string_view data) {
+	if (socket_) {
+		socket_->send(data);
+	}
+}
+
+#endif // __linux__
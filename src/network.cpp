@@ -24,19 +24,86 @@
 
 #include "../include/slirc/network.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <stdexcept>
-#include <thread>
+#include <string>
+
+#ifdef __linux__
+#	include <pthread.h>
+#	include <sched.h>
+#endif
 
 namespace {
-	boost::asio::io_service *internal_io_service_ = nullptr;
-	std::atomic<boost::asio::io_service *> active_io_service_ = nullptr;
-	std::thread network_thread_;
+	// guards the internal network_thread against destruction while assigning its io_services
+	std::mutex network_mutex_;
+		slirc::network_thread *internal_network_thread_ = nullptr;
+		boost::asio::io_service *external_io_service_ = nullptr;
+		bool internal_io_service_active_ = false;
+
+	// published on every change of the above, so get_io_service() neither locks nor assigns
+	std::atomic<const slirc::network_thread *> active_network_thread_{ nullptr };
+	std::atomic<boost::asio::io_service *> active_io_service_{ nullptr };
+
+	// the event loop run by the calling thread, if any
+	thread_local const slirc::network_thread *thread_network_thread_ = nullptr;
+	thread_local boost::asio::io_service *thread_io_service_ = nullptr;
+
+	bool has_active_io_service() {
+		return internal_io_service_active_
+			? internal_network_thread_ != nullptr
+			: external_io_service_ != nullptr;
+	}
+
+	// requires network_mutex_ to be held
+	void publish_active_io_service() {
+		if (!has_active_io_service()) {
+			active_network_thread_ = nullptr;
+			active_io_service_ = nullptr;
+		}
+		else if (internal_io_service_active_) {
+			active_network_thread_ = internal_network_thread_;
+			active_io_service_ = &internal_network_thread_->get_io_service(0);
+		}
+		else {
+			active_network_thread_ = nullptr;
+			active_io_service_ = external_io_service_;
+		}
+	}
+
+	// spreads keys over the shards, always assigning a key to the same one
+	std::size_t shard_of(const void *key, std::size_t shards) noexcept {
+		const auto address = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(key));
+		return static_cast<std::size_t>((address * 0x9e3779b97f4a7c15ull) >> 32) % shards;
+	}
+
+	[[noreturn]] void throw_no_active_io_service(const char *function) {
+		throw std::logic_error(
+			std::string(function) + ": No active io_service found!\n"
+			"Either instantiate an slirc::network_thread or call "
+			"slirc::use_external_io_service() to specify an external one."
+		);
+	}
+
+	void pin_thread([[maybe_unused]] std::thread &thread, [[maybe_unused]] std::size_t cpu) {
+#ifdef __linux__
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu % CPU_SETSIZE, &cpus);
+		// best effort; the thread keeps running unpinned if the CPU is not available
+		pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#endif
+	}
 }
 
-slirc::network_thread::network_thread()
-: io_service_() {
-	if (network_thread_.joinable()) {
+slirc::network_thread::network_thread(std::size_t threads, assignment_policy policy, bool pin_threads)
+: policy_(policy)
+, shards_()
+, next_shard_(0) {
+	std::lock_guard<std::mutex> lock(network_mutex_);
+	if (internal_network_thread_) {
 		throw std::logic_error(
 			"slirc::network_thread: Trying to set up internal io_service, "
 			"but an internal io_service exists already.\n"
@@ -44,47 +111,162 @@ slirc::network_thread::network_thread()
 			"given time."
 		);
 	}
-	network_thread_
-		= std::thread([&](){
 
-		});
-	internal_io_service_ = &io_service_;
+	const std::size_t hardware_threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+	if (threads == 0) {
+		threads = hardware_threads;
+	}
 
-	{ boost::asio::io_service *expected = nullptr;
-		// try to set active io_service to internal io_service, but only if
-		// currently no active io_service exists (current == nullptr)
-		active_io_service_.compare_exchange_strong(expected, internal_io_service_);
+	shards_.reserve(threads);
+	try {
+		for(std::size_t index = 0; index != threads; ++index) {
+			shards_.push_back(std::make_unique<shard>());
+			shard &current = *shards_.back();
+			current.work.emplace(current.io_service);
+			current.thread = std::thread([this, &current]() {
+				thread_network_thread_ = this;
+				thread_io_service_ = &current.io_service;
+				current.io_service.run();
+			});
+			if (pin_threads) {
+				pin_thread(current.thread, index % hardware_threads);
+			}
+		}
+	}
+	catch(...) {
+		for(auto &started : shards_) {
+			started->work.reset();
+			started->io_service.stop();
+			if (started->thread.joinable()) {
+				started->thread.join();
+			}
+		}
+		throw;
 	}
+
+	const bool was_active = has_active_io_service();
+	internal_network_thread_ = this;
+	if (!was_active) {
+		// use the internal io_service, but only if currently no active
+		// io_service exists
+		internal_io_service_active_ = true;
+	}
+	publish_active_io_service();
 }
 
 slirc::network_thread::~network_thread() {
-	internal_io_service_ = nullptr;
-	{ boost::asio::io_service *expected = &io_service_;
-		// try to unset active io_service, but only if the internal io_service
-		// is the currently active one (current == &io_service_)
-		active_io_service_.compare_exchange_strong(expected, nullptr);
+	{ std::lock_guard<std::mutex> lock(network_mutex_);
+		internal_network_thread_ = nullptr;
+		publish_active_io_service();
+	}
+
+	for(auto &current : shards_) {
+		current->work.reset();
+		current->io_service.stop();
+	}
+	for(auto &current : shards_) {
+		current->thread.join();
 	}
+}
 
-	io_service_.stop();
-	network_thread_.join();
+boost::asio::io_service &slirc::network_thread::get_io_service() const noexcept {
+	if (thread_network_thread_ == this) {
+		return *thread_io_service_;
+	}
+	return shards_.front()->io_service;
+}
+
+boost::asio::io_service &slirc::network_thread::get_io_service(const irc &context) const noexcept {
+	if (thread_network_thread_ == this) {
+		return *thread_io_service_;
+	}
+	return shards_[shard_of(&context, shards_.size())]->io_service;
+}
+
+boost::asio::io_service &slirc::network_thread::get_io_service(std::size_t shard) const {
+	return shards_.at(shard)->io_service;
+}
+
+boost::asio::io_service &slirc::network_thread::acquire_io_service() {
+	shard &assigned = next_shard();
+	++assigned.load;
+	return assigned.io_service;
+}
+
+void slirc::network_thread::release_io_service(boost::asio::io_service &io_service) noexcept {
+	for(auto &current : shards_) {
+		if (&current->io_service == &io_service) {
+			--current->load;
+			return;
+		}
+	}
+}
+
+std::size_t slirc::network_thread::load(std::size_t shard) const {
+	return shards_.at(shard)->load;
+}
+
+slirc::network_thread::shard &slirc::network_thread::next_shard() const noexcept {
+	const std::size_t first = next_shard_++ % shards_.size();
+	if (policy_ == assignment_policy::round_robin) {
+		return *shards_[first];
+	}
+
+	// start at a different shard every time, so ties are assigned in turn
+	shard *least_loaded = shards_[first].get();
+	for(std::size_t offset = 1; offset != shards_.size(); ++offset) {
+		shard &current = *shards_[(first + offset) % shards_.size()];
+		if (current.load < least_loaded->load) {
+			least_loaded = &current;
+		}
+	}
+	return *least_loaded;
 }
 
 boost::asio::io_service &slirc::get_io_service() {
-	auto * const active_io_service = active_io_service_.load();
+	if (thread_network_thread_ && thread_network_thread_ == active_network_thread_.load()) {
+		return *thread_io_service_;
+	}
+	boost::asio::io_service * const active_io_service = active_io_service_.load();
 	if (!active_io_service) {
-		throw std::logic_error(
-			"slirc::get_io_service(): No active io_service found!\n"
-			"Either instantiate an slirc::network_thread or call "
-			"slirc::use_external_io_service() to specify an external one."
-		);
+		throw_no_active_io_service("slirc::get_io_service()");
 	}
 	return *active_io_service;
 }
 
+boost::asio::io_service &slirc::get_io_service(const irc &context) {
+	if (const network_thread * const active_network_thread = active_network_thread_.load()) {
+		return active_network_thread->get_io_service(context);
+	}
+	return get_io_service();
+}
+
+boost::asio::io_service &slirc::acquire_io_service() {
+	std::lock_guard<std::mutex> lock(network_mutex_);
+	if (!has_active_io_service()) {
+		throw_no_active_io_service("slirc::acquire_io_service()");
+	}
+	return internal_io_service_active_
+		? internal_network_thread_->acquire_io_service()
+		: *external_io_service_;
+}
+
+void slirc::release_io_service(boost::asio::io_service &io_service) noexcept {
+	std::lock_guard<std::mutex> lock(network_mutex_);
+	if (internal_network_thread_) {
+		internal_network_thread_->release_io_service(io_service);
+	}
+}
+
 void slirc::use_external_io_service(boost::asio::io_service &io_service) {
-	active_io_service_ = &io_service;
+	std::lock_guard<std::mutex> lock(network_mutex_);
+	external_io_service_ = &io_service;
+	internal_io_service_active_ = false;
+	publish_active_io_service();
 }
 
 void slirc::use_internal_io_service() {
-	active_io_service_ = internal_io_service_;
+	std::lock_guard<std::mutex> lock(network_mutex_);
+	internal_io_service_active_ = true;
+	publish_active_io_service();
 }
@@ -0,0 +1,364 @@
+// Copyright 2018 Simon Stienen
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../include/slirc/scheduler.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#include "../include/slirc/event.hpp"
+#include "../include/slirc/irc.hpp"
+
+namespace {
+	enum scheduler_state: unsigned {
+		idle,             // not queued, not running
+		scheduled,        // sitting in a run queue
+		running,          // being handled by a worker thread
+		running_notified  // being handled, and new events arrived meanwhile
+	};
+
+	struct worker_identity {
+		const slirc::scheduler *owner;
+		std::size_t index;
+	};
+	thread_local worker_identity current_worker{ nullptr, 0 };
+}
+
+slirc::scheduler::scheduler(std::size_t thread_count, std::size_t events_per_run)
+: events_per_run_(std::max<std::size_t>(events_per_run, 1))
+, workers_()
+, next_worker_(0)
+, runnable_(0)
+, idle_mutex_()
+, idle_condition_()
+, sleeping_(0)
+, stopping_(false)
+, contexts_mutex_()
+, contexts_()
+, timer_epoch_(std::chrono::steady_clock::now())
+, timers_mutex_()
+, timers_()
+, next_timer_tick_(std::numeric_limits<util::timer_wheel<irc *>::tick_type>::max()) {
+	thread_count = std::max<std::size_t>(thread_count, 1);
+
+	workers_.reserve(thread_count);
+	for(std::size_t index = 0; index != thread_count; ++index) {
+		workers_.push_back(std::make_unique<worker>());
+	}
+
+	try {
+		for(std::size_t index = 0; index != thread_count; ++index) {
+			workers_[index]->thread = std::thread([this, index]{ work(index); });
+		}
+	}
+	catch(...) {
+		{ std::lock_guard<std::mutex> lock(idle_mutex_);
+			stopping_ = true;
+			idle_condition_.notify_all();
+		}
+		for(const auto &w: workers_) {
+			if (w->thread.joinable()) {
+				w->thread.join();
+			}
+		}
+		throw;
+	}
+}
+
+slirc::scheduler::~scheduler() {
+	{ std::lock_guard<std::mutex> lock(idle_mutex_);
+		stopping_ = true;
+		idle_condition_.notify_all();
+	}
+	for(const auto &w: workers_) {
+		w->thread.join();
+	}
+
+	std::vector<irc *> contexts;
+	{ std::lock_guard<std::mutex> lock(contexts_mutex_);
+		contexts.assign(contexts_.begin(), contexts_.end());
+	}
+	for(irc *context: contexts) {
+		detach(*context);
+	}
+}
+
+void slirc::scheduler::attach(slirc::irc &context) {
+	{ std::lock_guard<std::mutex> lock(contexts_mutex_);
+		scheduler *expected = nullptr;
+		if (!context.scheduler_.compare_exchange_strong(expected, this)) {
+			if (expected == this) {
+				return;
+			}
+			throw std::logic_error(
+				"slirc::scheduler::attach(): IRC context is already attached "
+				"to another scheduler."
+			);
+		}
+		contexts_.insert(&context);
+	}
+
+	if (context.event_queue_depth() != 0) {
+		schedule(context);
+	}
+	if (
+		const auto deadline = context.next_timer_deadline();
+		deadline != std::chrono::steady_clock::time_point::max()
+	) {
+		schedule_at(context, deadline);
+	}
+}
+
+void slirc::scheduler::detach(slirc::irc &context) {
+	{ std::lock_guard<std::mutex> lock(contexts_mutex_);
+		if (contexts_.erase(&context) == 0) {
+			return;
+		}
+		context.scheduler_ = nullptr;
+	}
+
+	// Wait for posting threads that may not have seen the detachment yet.
+	while(context.scheduler_users_ != 0) {
+		std::this_thread::yield();
+	}
+
+	{ std::lock_guard<std::mutex> lock(timers_mutex_);
+		timers_.cancel(context.scheduler_timer_);
+		context.scheduler_timer_ = util::timer_handle();
+		context.scheduler_timer_deadline_ = std::chrono::steady_clock::time_point::max();
+	}
+
+	// No new scheduling will happen from now on, but the context may still be
+	// queued or running. Worker threads put detached contexts back to idle
+	// rather than queueing them again once they are done with them.
+	while(context.scheduler_state_ != idle) {
+		for(const auto &w: workers_) {
+			std::lock_guard<std::mutex> lock(w->run_queue_mutex);
+			if (
+				const auto it = std::find(w->run_queue.begin(), w->run_queue.end(), &context);
+				it != w->run_queue.end()
+			) {
+				w->run_queue.erase(it);
+				--runnable_;
+				context.scheduler_state_ = idle;
+			}
+		}
+		std::this_thread::yield();
+	}
+}
+
+void slirc::scheduler::schedule(slirc::irc &context) {
+	unsigned state = context.scheduler_state_;
+	for(;;) {
+		switch(state) {
+			case idle:
+				if (context.scheduler_state_.compare_exchange_weak(state, scheduled)) {
+					enqueue(context);
+					return;
+				}
+				break;
+
+			case running:
+				if (context.scheduler_state_.compare_exchange_weak(state, running_notified)) {
+					return;
+				}
+				break;
+
+			default:
+				// already queued or already notified
+				return;
+		}
+	}
+}
+
+void slirc::scheduler::schedule_at(slirc::irc &context, std::chrono::steady_clock::time_point deadline) {
+	// Only the earliest deadline of each context is tracked. The context
+	// tells us about its next one whenever it ran its expired timers.
+	bool earliest;
+	{ std::lock_guard<std::mutex> lock(timers_mutex_);
+		if (context.scheduler_timer_ && context.scheduler_timer_deadline_ <= deadline) {
+			return;
+		}
+		timers_.cancel(context.scheduler_timer_);
+		context.scheduler_timer_ = timers_.insert(util::timer_tick_until(timer_epoch_, deadline), &context);
+		context.scheduler_timer_deadline_ = deadline;
+
+		const auto next_tick = *timers_.next_deadline();
+		earliest = next_tick < next_timer_tick_;
+		next_timer_tick_ = next_tick;
+	}
+
+	if (earliest && sleeping_ != 0) {
+		// sleeping worker threads may be waiting for a later deadline
+		std::lock_guard<std::mutex> lock(idle_mutex_);
+		idle_condition_.notify_one();
+	}
+}
+
+void slirc::scheduler::schedule_expired_timers() {
+	const auto now = util::timer_tick_at(timer_epoch_, std::chrono::steady_clock::now());
+	if (now < next_timer_tick_) {
+		return;
+	}
+
+	std::vector<irc *> expired;
+	{ std::lock_guard<std::mutex> lock(timers_mutex_);
+		timers_.advance(now, [&](irc *context) {
+			context->scheduler_timer_ = util::timer_handle();
+			context->scheduler_timer_deadline_ = std::chrono::steady_clock::time_point::max();
+			expired.push_back(context);
+		});
+		next_timer_tick_ = timers_.next_deadline().value_or(std::numeric_limits<util::timer_wheel<irc *>::tick_type>::max());
+	}
+
+	if (!expired.empty()) {
+		// detach() removes contexts from the set before cancelling their timers
+		std::lock_guard<std::mutex> lock(contexts_mutex_);
+		for(irc *context: expired) {
+			if (contexts_.count(context) != 0) {
+				schedule(*context);
+			}
+		}
+	}
+}
+
+void slirc::scheduler::enqueue(slirc::irc &context) {
+	// Keep contexts scheduled by event handlers on the same worker thread, and
+	// spread contexts scheduled by other threads.
+	const std::size_t index = (current_worker.owner == this)
+		? current_worker.index
+		: next_worker_++ % workers_.size();
+
+	// count first, so the counter never underflows when a worker is faster
+	++runnable_;
+	{ std::lock_guard<std::mutex> lock(workers_[index]->run_queue_mutex);
+		workers_[index]->run_queue.push_back(&context);
+	}
+
+	if (sleeping_ != 0) {
+		std::lock_guard<std::mutex> lock(idle_mutex_);
+		idle_condition_.notify_one();
+	}
+}
+
+slirc::irc *slirc::scheduler::next_context(std::size_t index) {
+	for(;;) {
+		// Contexts that keep posting events never let the run queues run
+		// dry, so stop before taking another one.
+		if (stopping_) {
+			return nullptr;
+		}
+
+		schedule_expired_timers();
+
+		// own run queue first ...
+		{ worker &self = *workers_[index];
+			std::lock_guard<std::mutex> lock(self.run_queue_mutex);
+			if (!self.run_queue.empty()) {
+				irc * const context = self.run_queue.front();
+				self.run_queue.pop_front();
+				--runnable_;
+				return context;
+			}
+		}
+
+		// ... then try to steal from the others ...
+		for(std::size_t offset = 1; offset != workers_.size(); ++offset) {
+			worker &victim = *workers_[(index + offset) % workers_.size()];
+			std::lock_guard<std::mutex> lock(victim.run_queue_mutex);
+			if (!victim.run_queue.empty()) {
+				irc * const context = victim.run_queue.back();
+				victim.run_queue.pop_back();
+				--runnable_;
+				return context;
+			}
+		}
+
+		// ... and go to sleep if there is nothing to do.
+		std::unique_lock<std::mutex> lock(idle_mutex_);
+		++sleeping_;
+		const auto next_tick = next_timer_tick_.load();
+		const auto wake_up = [&]{ return stopping_ || runnable_ != 0 || next_timer_tick_ < next_tick; };
+		if (next_tick == std::numeric_limits<util::timer_wheel<irc *>::tick_type>::max()) {
+			idle_condition_.wait(lock, wake_up);
+		}
+		else {
+			idle_condition_.wait_until(lock, util::timer_tick_deadline(timer_epoch_, next_tick), wake_up);
+		}
+		--sleeping_;
+		if (stopping_) {
+			return nullptr;
+		}
+	}
+}
+
+void slirc::scheduler::run(slirc::irc &context, std::vector<std::shared_ptr<event>> &events) {
+	context.scheduler_state_ = running;
+
+	const std::size_t fetched = context.fetch_events(
+		std::back_inserter(events),
+		events_per_run_,
+		std::chrono::milliseconds(0)
+	);
+	for(const auto &ev: events) {
+		ev->emit();
+	}
+	events.clear();
+
+	unsigned state = running;
+	if (
+		fetched != events_per_run_
+		&& context.scheduler_state_.compare_exchange_strong(state, idle)
+	) {
+		return;
+	}
+
+	// There are events left or new events were posted while running.
+	if (!context.scheduler_) {
+		// detached meanwhile; detach() waits for us to go idle
+		context.scheduler_state_ = idle;
+		return;
+	}
+
+	context.scheduler_state_ = scheduled;
+	enqueue(context);
+}
+
+void slirc::scheduler::work(std::size_t index) {
+	current_worker = worker_identity{ this, index };
+
+	std::vector<std::shared_ptr<event>> events;
+	events.reserve(events_per_run_);
+
+	while(irc * const context = next_context(index)) {
+		if (stopping_) {
+			// not run; its events are picked up when it is attached again
+			context->scheduler_state_ = idle;
+			return;
+		}
+		run(*context, events);
+	}
+}
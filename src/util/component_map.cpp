@@ -23,3 +23,231 @@
 // THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "../../include/slirc/util/component_map.hpp"
+
+slirc::util::component_map::component_map(const component_map &other)
+: parent_(other.parent_) {
+	try {
+		for(size_type index = 0; index != inline_slots; ++index) {
+			if (other.types_[index]) {
+				const slot &source = other.slots_[index];
+				if (source.object) {
+					source.ops->copy(slots_[index], source.object);
+					++size_;
+				}
+				else {
+					slots_[index] = slot{ nullptr, nullptr, {} };
+					++masked_;
+				}
+				types_[index] = other.types_[index];
+			}
+		}
+
+		overflow_.reserve(other.overflow_.size());
+		spare_slots_.reserve(other.overflow_.size());
+		for(const overflow_slot &entry : other.overflow_) {
+			std::unique_ptr<slot> content(new slot{ nullptr, nullptr, {} });
+			if (entry.content->object) {
+				entry.content->ops->copy(*content, entry.content->object);
+				++size_;
+			}
+			else {
+				++masked_;
+			}
+			overflow_.push_back(overflow_slot{ entry.type, std::move(content) });
+		}
+	}
+	catch(...) {
+		clear();
+		throw;
+	}
+}
+
+slirc::util::component_map::component_map(component_map &&other) noexcept {
+	move_from(other);
+}
+
+slirc::util::component_map &slirc::util::component_map::operator=(const component_map &other) {
+	if (this != &other) {
+		component_map copy(other);
+		clear();
+		move_from(copy);
+	}
+	return *this;
+}
+
+slirc::util::component_map &slirc::util::component_map::operator=(component_map &&other) noexcept {
+	if (this != &other) {
+		clear();
+		move_from(other);
+	}
+	return *this;
+}
+
+void slirc::util::component_map::clear() noexcept {
+	parent_ = nullptr;
+	if (size_ + masked_ == 0) {
+		return;
+	}
+
+	for(size_type index = 0; index != inline_slots; ++index) {
+		if (types_[index]) {
+			if (slots_[index].object) {
+				slots_[index].ops->destroy(slots_[index].object);
+			}
+			types_[index] = nullptr;
+		}
+	}
+	for(overflow_slot &entry : overflow_) {
+		if (entry.content->object) {
+			entry.content->ops->destroy(entry.content->object);
+		}
+		// spare_slots_ has room for it, so this does not allocate
+		spare_slots_.push_back(std::move(entry.content));
+	}
+	// keeps the capacity, so recycled maps don't reallocate it
+	overflow_.clear();
+	size_ = 0;
+	masked_ = 0;
+}
+
+slirc::util::component_map::size_type slirc::util::component_map::index_of_equivalent(const std::type_info &type) const noexcept {
+	for(size_type index = 0; index != inline_slots; ++index) {
+		if (types_[index] && *types_[index] == type) {
+			return index;
+		}
+	}
+	for(size_type index = 0; index != overflow_.size(); ++index) {
+		if (*overflow_[index].type == type) {
+			return inline_slots + index;
+		}
+	}
+	return npos;
+}
+
+bool slirc::util::component_map::erase_type(const std::type_info &type, bool inherited) {
+	const size_type index = index_of(type);
+	if (index != npos) {
+		slot &existing = slot_at(index);
+		if (!existing.object) {
+			// already masked
+			return false;
+		}
+		if (inherited) {
+			existing.ops->destroy(existing.object);
+			existing = slot{ nullptr, nullptr, {} };
+			--size_;
+			++masked_;
+		}
+		else {
+			release_at(index);
+		}
+		return true;
+	}
+	if (!inherited) {
+		return false;
+	}
+
+	// mask the inherited object with an empty slot
+	for(size_type index = 0; index != inline_slots; ++index) {
+		if (!types_[index]) {
+			slots_[index] = slot{ nullptr, nullptr, {} };
+			types_[index] = &type;
+			++masked_;
+			return true;
+		}
+	}
+	std::unique_ptr<slot> content = take_slot();
+	overflow_.push_back(overflow_slot{ &type, std::move(content) });
+	++masked_;
+	return true;
+}
+
+void slirc::util::component_map::release_at(size_type index) noexcept {
+	slot &existing = slot_at(index);
+	if (existing.object) {
+		existing.ops->destroy(existing.object);
+		--size_;
+	}
+	else {
+		--masked_;
+	}
+
+	if (index < inline_slots) {
+		types_[index] = nullptr;
+	}
+	else {
+		auto entry = overflow_.begin() + (index - inline_slots);
+		spare_slots_.push_back(std::move(entry->content));
+		// overflow objects live in their own slot, so reordering doesn't move them
+		if (entry != overflow_.end() - 1) {
+			*entry = std::move(overflow_.back());
+		}
+		overflow_.pop_back();
+	}
+}
+
+slirc::util::component_map::size_type slirc::util::component_map::inherited_size() const noexcept {
+	// counts the objects of every ancestor not shadowed by a map between it and this one
+	const auto shadowed = [this](const component_map *ancestor, const std::type_info &type) {
+		for(const component_map *map = this; map != ancestor; map = map->parent_) {
+			if (map->index_of(type) != npos) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	size_type result = 0;
+	for(const component_map *ancestor = parent_; ancestor; ancestor = ancestor->parent_) {
+		for(size_type index = 0; index != inline_slots; ++index) {
+			if (ancestor->types_[index] && ancestor->slots_[index].object && !shadowed(ancestor, *ancestor->types_[index])) {
+				++result;
+			}
+		}
+		for(const overflow_slot &entry : ancestor->overflow_) {
+			if (entry.content->object && !shadowed(ancestor, *entry.type)) {
+				++result;
+			}
+		}
+	}
+	return result;
+}
+
+std::unique_ptr<slirc::util::component_map::slot> slirc::util::component_map::take_slot() {
+	if (spare_slots_.empty()) {
+		// room for every slot, so clear() and release_at() keep them without allocating
+		spare_slots_.reserve(overflow_.size() + 1);
+		return std::unique_ptr<slot>(new slot{ nullptr, nullptr, {} });
+	}
+
+	std::unique_ptr<slot> content = std::move(spare_slots_.back());
+	spare_slots_.pop_back();
+	content->ops = nullptr;
+	content->object = nullptr;
+	return content;
+}
+
+void slirc::util::component_map::move_from(component_map &other) noexcept {
+	for(size_type index = 0; index != inline_slots; ++index) {
+		if (other.types_[index]) {
+			slot &source = other.slots_[index];
+			if (source.object) {
+				source.ops->move(slots_[index], source);
+			}
+			else {
+				slots_[index] = slot{ nullptr, nullptr, {} };
+			}
+			types_[index] = other.types_[index];
+			other.types_[index] = nullptr;
+		}
+	}
+	// both keep the room for all of their slots in spare_slots_
+	overflow_.swap(other.overflow_);
+	spare_slots_.swap(other.spare_slots_);
+	size_ = other.size_;
+	masked_ = other.masked_;
+	parent_ = other.parent_;
+	other.size_ = 0;
+	other.masked_ = 0;
+	other.parent_ = nullptr;
+}
@@ -26,28 +26,115 @@
 
 #include <cassert>
 
-#include <thread>
+#if defined(__cpp_lib_atomic_wait)
+#elif defined(__linux__)
+#	include <climits>
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#else
+#	include <condition_variable>
+#	include <mutex>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#	include <intrin.h>
+#endif
 
 namespace slirc::util {
 
-spin_lock::spin_lock()
-: locked_(false) {}
+namespace {
+	/// \brief Hints the CPU that the thread is spinning.
+	inline void cpu_pause() noexcept {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+		_mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+#if defined(__cpp_lib_atomic_wait)
+	void park(std::atomic<std::uint32_t> &state, std::uint32_t value) noexcept {
+		state.wait(value, std::memory_order_relaxed);
+	}
+
+	void wake_one(std::atomic<std::uint32_t> &state) noexcept {
+		state.notify_one();
+	}
+#elif defined(__linux__)
+	static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "futex requires a plain 32 bit lock state");
+
+	void park(std::atomic<std::uint32_t> &state, std::uint32_t value) noexcept {
+		// returns immediately if state no longer holds value
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&state), FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+	}
+
+	void wake_one(std::atomic<std::uint32_t> &state) noexcept {
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+	}
+#else
+	// parked threads share a small table of condition variables, keyed by lock address
+	struct parking_bucket {
+		std::mutex mutex;
+		std::condition_variable parked;
+	};
+
+	parking_bucket &bucket_of(const std::atomic<std::uint32_t> &state) noexcept {
+		static parking_bucket buckets[64];
+		return buckets[(reinterpret_cast<std::uintptr_t>(&state) / sizeof(state)) % 64];
+	}
+
+	void park(std::atomic<std::uint32_t> &state, std::uint32_t value) noexcept {
+		parking_bucket &bucket = bucket_of(state);
+		std::unique_lock<std::mutex> lock(bucket.mutex);
+		while(state.load(std::memory_order_relaxed) == value) {
+			bucket.parked.wait(lock);
+		}
+	}
 
-void spin_lock::lock() noexcept {
-	bool current_locked_flag;
-	while(!locked_.compare_exchange_weak(current_locked_flag = false, true)) {
-		std::this_thread::yield();
+	void wake_one(std::atomic<std::uint32_t> &state) noexcept {
+		parking_bucket &bucket = bucket_of(state);
+		// other locks may share the bucket, so a single notification might wake the wrong thread
+		{ std::lock_guard<std::mutex> lock(bucket.mutex); }
+		bucket.parked.notify_all();
 	}
+#endif
 }
 
-void spin_lock::unlock() noexcept {
-	assert(locked_ && "cannot unlock already unlocked spin_lock");
-	locked_ = false;
+spin_lock::spin_lock() noexcept
+: state_(unlocked) {}
+
+void spin_lock::lock_contended() noexcept {
+	// spin on plain loads, so waiting threads share the cache line until it is released
+	for(unsigned pauses = 1; pauses <= spin_limit; pauses *= 2) {
+		for(unsigned i = 0; i != pauses; ++i) {
+			cpu_pause();
+		}
+
+		std::uint32_t current = state_.load(std::memory_order_relaxed);
+		if (current == locked_parked) {
+			// threads are already parked; don't overtake them for longer
+			break;
+		}
+		if (current == unlocked && state_.compare_exchange_weak(current, locked, std::memory_order_acquire, std::memory_order_relaxed)) {
+			return;
+		}
+	}
+
+	// announce the parked thread, so the owner wakes it on unlock
+	while(state_.exchange(locked_parked, std::memory_order_acquire) != unlocked) {
+		park(state_, locked_parked);
+	}
 }
 
-bool spin_lock::try_lock() noexcept {
-	bool current_locked_flag = false;
-	return locked_.compare_exchange_strong(current_locked_flag, true);
+void spin_lock::unlock() noexcept {
+	const std::uint32_t previous = state_.exchange(unlocked, std::memory_order_release);
+	assert(previous != unlocked && "cannot unlock already unlocked spin_lock");
+	if (previous == locked_parked) {
+		wake_one(state_);
+	}
 }
 
 }